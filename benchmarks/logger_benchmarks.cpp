@@ -0,0 +1,417 @@
+/*
+* Copyright (c) 2024 Stephen O Driscoll
+*
+* Distributed under the MIT License (See accompanying file LICENSE)
+* Official repository: https://github.com/Stephen-ODriscoll/PlutoUtils
+*/
+
+#include <pluto/logger.hpp>
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#define BENCHMARK_DIR "benchmark_logs"
+
+// Measures how many logs per second pluto::logger writes, and how long each logging call takes to return.
+// Every combination of the options below is run, and one result per run is written as CSV or JSON.
+// Usage: logger_benchmarks [--format csv|json] [--output <file>] [--logs <n>] [--functions <list>] [--threads <list>]
+//                          [--message-sizes <list>] [--flush-sizes <list>] [--files <list>]
+// Lists are separated by commas, like --threads 1,2,4,8
+
+struct benchmark_options
+{
+    std::string                 format      { "csv" };
+    std::string                 output      {};         // Written to stdout if empty
+    std::size_t                 numLogs     { 20000 };  // Per thread
+    std::vector<std::string>    functions   {
+        "write",
+        "writef",
+#if PLUTO_UTILS_HAS_FORMAT
+        "format",
+#endif
+        "write_kv",
+        "stream"
+    };
+    std::vector<std::size_t>    threads     { 1, 2, 4, 8 };
+    std::vector<std::size_t>    messageSizes{ 16, 256, 4096 };
+    std::vector<std::size_t>    flushSizes  { 1, 64, 1024 };
+    std::vector<std::size_t>    files       { 1, 4 };
+};
+
+struct benchmark_result
+{
+    std::string function;
+    std::size_t threads;
+    std::size_t messageSize;
+    std::size_t flushSize;
+    std::size_t files;
+    std::size_t records;
+    std::size_t discarded;
+    double      enqueueSeconds;     // Until every thread has made its logging calls
+    double      totalSeconds;       // Until every log is written and the logger is destroyed
+    double      recordsPerSecond;   // Records written over the total seconds
+    long long   p50Nanoseconds;     // Latency of the logging calls
+    long long   p99Nanoseconds;
+    long long   p999Nanoseconds;
+    long long   maxNanoseconds;
+};
+
+template<class Value>
+bool parse_list(const std::string& text, std::vector<Value>& values, Value(*parse)(const std::string&))
+{
+    values.clear();
+
+    std::size_t begin{ 0 };
+    while (begin <= text.size())
+    {
+        auto end{ text.find(',', begin) };
+        if (end == std::string::npos)
+        {
+            end = text.size();
+        }
+
+        if (end == begin)
+        {
+            return false;
+        }
+
+        values.push_back(parse(text.substr(begin, (end - begin))));
+        begin = (end + 1);
+    }
+
+    return !values.empty();
+}
+
+std::size_t parse_size(const std::string& text)
+{
+    return static_cast<std::size_t>(std::stoull(text));
+}
+
+std::string parse_string(const std::string& text)
+{
+    return text;
+}
+
+bool parse_options(const int argc, char* argv[], benchmark_options& options)
+{
+    for (int i{ 1 }; i < argc; i += 2)
+    {
+        if (argc <= i + 1)
+        {
+            return false;
+        }
+
+        const std::string option{ argv[i] };
+        const std::string value { argv[i + 1] };
+
+        try
+        {
+            if (option == "--format" && (value == "csv" || value == "json"))
+            {
+                options.format = value;
+            }
+            else if (option == "--output")
+            {
+                options.output = value;
+            }
+            else if (option == "--logs")
+            {
+                options.numLogs = parse_size(value);
+            }
+            else if (option == "--functions")
+            {
+                if (!parse_list(value, options.functions, &parse_string))
+                {
+                    return false;
+                }
+
+                for (const auto& function : options.functions)
+                {
+                    if (function != "write" && function != "writef" && function != "write_kv" && function != "stream" &&
+                        (!PLUTO_UTILS_HAS_FORMAT || function != "format"))
+                    {
+                        return false;
+                    }
+                }
+            }
+            else if (!((option == "--threads" && parse_list(value, options.threads, &parse_size)) ||
+                (option == "--message-sizes" && parse_list(value, options.messageSizes, &parse_size)) ||
+                (option == "--flush-sizes" && parse_list(value, options.flushSizes, &parse_size)) ||
+                (option == "--files" && parse_list(value, options.files, &parse_size))))
+            {
+                return false;
+            }
+        }
+        catch (const std::exception&)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Returns the latency that this fraction of calls took no longer than
+long long percentile(const std::vector<long long>& sortedLatencies, const double fraction)
+{
+    if (sortedLatencies.empty())
+    {
+        return 0;
+    }
+
+    const auto index{ static_cast<std::size_t>(fraction * static_cast<double>(sortedLatencies.size() - 1)) };
+    return sortedLatencies[index];
+}
+
+void log_once(
+    pluto::logger&      logger,
+    const std::string&  function,
+    const std::string&  fileName,
+    const std::string&  message,
+    const std::size_t   i)
+{
+    if (function == "write")
+    {
+        PLUTO_LOG_WRITE_WITH(logger, fileName, info, message);
+    }
+    else if (function == "writef")
+    {
+        PLUTO_LOG_WRITEF_WITH(logger, fileName, info, "%s %zu", message.c_str(), i);
+    }
+#if PLUTO_UTILS_HAS_FORMAT
+    else if (function == "format")
+    {
+        PLUTO_LOG_FORMAT_WITH(logger, fileName, info, "{} {}", message, i);
+    }
+#endif
+    else if (function == "write_kv")
+    {
+        PLUTO_LOG_WRITE_KV_WITH(logger, fileName, info, message.c_str(), pluto::kv("i", i));
+    }
+    else
+    {
+        PLUTO_LOG_STREAM_WITH(logger, fileName, info, message << ' ' << i);
+    }
+}
+
+benchmark_result run_benchmark(
+    const benchmark_options&    options,
+    const std::string&          function,
+    const std::size_t           numThreads,
+    const std::size_t           messageSize,
+    const std::size_t           flushSize,
+    const std::size_t           numFiles)
+{
+    typedef std::chrono::steady_clock clock;
+
+    const std::string message(messageSize, 'x');
+
+    std::vector<std::vector<long long>> threadLatencies(numThreads);
+    std::vector<std::thread> threads{};
+
+    std::size_t numDiscarded{ 0 };
+    clock::time_point start{};
+    clock::time_point enqueueEnd{};
+
+    {
+        pluto::logger logger{};
+        logger.buffer_flush_size(flushSize);
+
+        std::atomic_size_t numReady{ 0 };
+        std::atomic_bool isStarted{ false };
+
+        for (std::size_t t{ 0 }; t < numThreads; ++t)
+        {
+            threads.emplace_back([&, t]()
+                {
+                    const auto fileName{ std::string{ BENCHMARK_DIR "/benchmark_" } + std::to_string(t % numFiles) + ".log" };
+
+                    auto& latencies{ threadLatencies[t] };
+                    latencies.reserve(options.numLogs);
+
+                    // Threads start logging together, so they contend like they would in an application
+                    ++numReady;
+                    while (!isStarted.load())
+                    {
+                        std::this_thread::yield();
+                    }
+
+                    for (std::size_t i{ 0 }; i < options.numLogs; ++i)
+                    {
+                        const auto callStart{ clock::now() };
+                        log_once(logger, function, fileName, message, i);
+                        latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - callStart).count());
+                    }
+                });
+        }
+
+        while (numReady.load() != numThreads)
+        {
+            std::this_thread::yield();
+        }
+
+        start = clock::now();
+        isStarted.store(true);
+
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        enqueueEnd = clock::now();
+        numDiscarded = logger.num_discarded_logs();
+    }
+
+    const auto end{ clock::now() };
+
+    std::vector<long long> latencies{};
+    latencies.reserve(numThreads * options.numLogs);
+    for (const auto& thisLatencies : threadLatencies)
+    {
+        latencies.insert(latencies.end(), thisLatencies.begin(), thisLatencies.end());
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+
+    const auto numRecords   { numThreads * options.numLogs };
+    const auto totalSeconds { std::chrono::duration<double>(end - start).count() };
+
+    std::error_code error{};
+    pluto::filesystem::remove_all(BENCHMARK_DIR, error);
+
+    return {
+        function,
+        numThreads,
+        messageSize,
+        flushSize,
+        numFiles,
+        numRecords,
+        numDiscarded,
+        std::chrono::duration<double>(enqueueEnd - start).count(),
+        totalSeconds,
+        ((totalSeconds == 0) ? 0 : (static_cast<double>(numRecords - numDiscarded) / totalSeconds)),
+        percentile(latencies, 0.5),
+        percentile(latencies, 0.99),
+        percentile(latencies, 0.999),
+        (latencies.empty() ? 0 : latencies.back())
+    };
+}
+
+void write_csv(std::ostream& stream, const std::vector<benchmark_result>& results)
+{
+    stream << "function,threads,message_size,buffer_flush_size,files,records,discarded,"
+        "enqueue_seconds,total_seconds,records_per_sec,p50_ns,p99_ns,p999_ns,max_ns\n";
+
+    for (const auto& result : results)
+    {
+        stream
+            << result.function          << ','
+            << result.threads           << ','
+            << result.messageSize       << ','
+            << result.flushSize         << ','
+            << result.files             << ','
+            << result.records           << ','
+            << result.discarded         << ','
+            << result.enqueueSeconds    << ','
+            << result.totalSeconds      << ','
+            << result.recordsPerSecond  << ','
+            << result.p50Nanoseconds    << ','
+            << result.p99Nanoseconds    << ','
+            << result.p999Nanoseconds   << ','
+            << result.maxNanoseconds    << '\n';
+    }
+}
+
+void write_json(std::ostream& stream, const std::vector<benchmark_result>& results)
+{
+    stream << "[\n";
+
+    for (std::size_t i{ 0 }; i < results.size(); ++i)
+    {
+        const auto& result{ results[i] };
+
+        stream
+            << "  {"
+            << "\"function\": \""           << result.function          << "\", "
+            << "\"threads\": "              << result.threads           << ", "
+            << "\"message_size\": "         << result.messageSize       << ", "
+            << "\"buffer_flush_size\": "    << result.flushSize         << ", "
+            << "\"files\": "                << result.files             << ", "
+            << "\"records\": "              << result.records           << ", "
+            << "\"discarded\": "            << result.discarded         << ", "
+            << "\"enqueue_seconds\": "      << result.enqueueSeconds    << ", "
+            << "\"total_seconds\": "        << result.totalSeconds      << ", "
+            << "\"records_per_sec\": "      << result.recordsPerSecond  << ", "
+            << "\"p50_ns\": "               << result.p50Nanoseconds    << ", "
+            << "\"p99_ns\": "               << result.p99Nanoseconds    << ", "
+            << "\"p999_ns\": "              << result.p999Nanoseconds   << ", "
+            << "\"max_ns\": "               << result.maxNanoseconds
+            << ((i + 1 == results.size()) ? "}\n" : "},\n");
+    }
+
+    stream << "]\n";
+}
+
+int main(int argc, char* argv[])
+{
+    benchmark_options options{};
+    if (!parse_options(argc, argv, options))
+    {
+        std::cerr << "Usage: " << argv[0] << " [--format csv|json] [--output <file>] [--logs <n>] [--functions <list>] "
+            "[--threads <list>] [--message-sizes <list>] [--flush-sizes <list>] [--files <list>]\n";
+        return 2;
+    }
+
+    std::vector<benchmark_result> results{};
+
+    for (const auto& function : options.functions)
+    {
+        for (const auto numThreads : options.threads)
+        {
+            for (const auto messageSize : options.messageSizes)
+            {
+                for (const auto flushSize : options.flushSizes)
+                {
+                    for (const auto numFiles : options.files)
+                    {
+                        if (numThreads == 0 || numFiles == 0)
+                        {
+                            continue;
+                        }
+
+                        results.push_back(run_benchmark(options, function, numThreads, messageSize, flushSize, numFiles));
+
+                        const auto& result{ results.back() };
+                        std::cerr << function << ", " << numThreads << " threads, " << messageSize << " bytes, flush size "
+                            << flushSize << ", " << numFiles << " files: " << static_cast<std::size_t>(result.recordsPerSecond)
+                            << " records/sec, p99 " << result.p99Nanoseconds << "ns\n";
+                    }
+                }
+            }
+        }
+    }
+
+    std::ofstream outputFile{};
+    if (!options.output.empty())
+    {
+        outputFile.open(options.output);
+        if (!outputFile.is_open())
+        {
+            std::cerr << options.output << ": failed to open file\n";
+            return 1;
+        }
+    }
+
+    auto& stream{ options.output.empty() ? std::cout : outputFile };
+    if (options.format == "json")
+    {
+        write_json(stream, results);
+    }
+    else
+    {
+        write_csv(stream, results);
+    }
+
+    return 0;
+}
@@ -0,0 +1,64 @@
+/*
+* Copyright (c) 2024 Stephen O Driscoll
+*
+* Distributed under the MIT License (See accompanying file LICENSE)
+* Official repository: https://github.com/Stephen-ODriscoll/PlutoUtils
+*/
+
+// Logs below info are removed at compile time, and their arguments are never evaluated
+#define PLUTO_LOGGER_COMPILE_TIME_LEVEL info
+
+#include <pluto/logger.hpp>
+
+#define LOG_FILE "logs/log_compile_time_level.log"
+
+#define LOG_WRITE(level, ...)   PLUTO_LOG_WRITE(LOG_FILE, level, __VA_ARGS__)
+
+#define LOG_WRITEF(level, ...)  PLUTO_LOG_WRITEF(LOG_FILE, level, __VA_ARGS__)
+
+#if PLUTO_UTILS_HAS_FORMAT
+#define LOG_FORMAT(level, ...)  PLUTO_LOG_FORMAT(LOG_FILE, level, __VA_ARGS__)
+#endif
+
+#define LOG_STREAM(level, ...)  PLUTO_LOG_STREAM(LOG_FILE, level, __VA_ARGS__)
+
+std::size_t expensive_value(const std::size_t i)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    return i;
+}
+
+int main(int argc, char* argv[])
+{
+    std::size_t numLogs{ 100 };
+    for (std::size_t i{ 0 }; i < numLogs; ++i)
+    {
+        LOG_WRITEF(fatal, "Log writef %zu of %zu", i, numLogs);
+        LOG_WRITEF(error, "Log writef %zu of %zu", i, numLogs);
+        LOG_WRITEF(info, "Log writef %zu of %zu", i, numLogs);
+        LOG_WRITEF(debug, "Log writef %zu of %zu", expensive_value(i), numLogs);
+        LOG_WRITEF(verbose, "Log writef %zu of %zu", expensive_value(i), numLogs);
+    }
+
+#if PLUTO_UTILS_HAS_FORMAT
+    for (std::size_t i{ 0 }; i < numLogs; ++i)
+    {
+        LOG_FORMAT(fatal, "Log format {} of {}", i, numLogs);
+        LOG_FORMAT(error, "Log format {} of {}", i, numLogs);
+        LOG_FORMAT(info, "Log format {} of {}", i, numLogs);
+        LOG_FORMAT(debug, "Log format {} of {}", expensive_value(i), numLogs);
+        LOG_FORMAT(verbose, "Log format {} of {}", expensive_value(i), numLogs);
+    }
+#endif
+
+    for (std::size_t i{ 0 }; i < numLogs; ++i)
+    {
+        LOG_STREAM(fatal, "Log stream " << i << " of " << numLogs);
+        LOG_STREAM(error, "Log stream " << i << " of " << numLogs);
+        LOG_STREAM(info, "Log stream " << i << " of " << numLogs);
+        LOG_STREAM(debug, "Log stream " << expensive_value(i) << " of " << numLogs);
+        LOG_STREAM(verbose, "Log stream " << expensive_value(i) << " of " << numLogs);
+    }
+
+    return 0;
+}
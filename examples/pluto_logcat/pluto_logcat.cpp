@@ -0,0 +1,70 @@
+/*
+* Copyright (c) 2024 Stephen O Driscoll
+*
+* Distributed under the MIT License (See accompanying file LICENSE)
+* Official repository: https://github.com/Stephen-ODriscoll/PlutoUtils
+*/
+
+#include <pluto/logger.hpp>
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+// Decodes log files written by pluto::logger in binary mode, and writes them to stdout in the default text layout.
+// Usage: pluto_logcat [--no-header] <file>...
+int main(int argc, char* argv[])
+{
+    bool writeHeader{ true };
+    int firstFile{ 1 };
+
+    if (firstFile < argc && std::strcmp(argv[firstFile], "--no-header") == 0)
+    {
+        writeHeader = false;
+        ++firstFile;
+    }
+
+    if (argc <= firstFile)
+    {
+        std::cerr << "Usage: " << argv[0] << " [--no-header] <file>...\n";
+        return 2;
+    }
+
+    std::string output{};
+
+    if (writeHeader)
+    {
+        pluto::logger::default_header_appender(output);
+        output.push_back('\n');
+        std::cout.write(output.data(), static_cast<std::streamsize>(output.size()));
+    }
+
+    int result{ 0 };
+    for (int i{ firstFile }; i < argc; ++i)
+    {
+        std::ifstream fileStream{ argv[i], std::ios_base::binary };
+        if (!fileStream.is_open())
+        {
+            std::cerr << argv[i] << ": failed to open file\n";
+            result = 1;
+            continue;
+        }
+
+        const auto isValid{ pluto::logger::read_binary_log(fileStream, [&output](const pluto::log_entry& log)
+            {
+                output.clear();
+                pluto::logger::default_log_appender(output, log);
+                output.push_back('\n');
+                std::cout.write(output.data(), static_cast<std::streamsize>(output.size()));
+            }
+        ) };
+
+        if (!isValid)
+        {
+            std::cerr << argv[i] << ": not a binary log file, or ends partway through a log\n";
+            result = 1;
+        }
+    }
+
+    return result;
+}
@@ -9,21 +9,51 @@
 #define PLUTO_UTILS_LOGGER_HPP
 
 #include <map>
-#include <list>
+#include <set>
 #include <mutex>
+#include <tuple>
+#include <ctime>
+#include <cmath>
 #include <atomic>
+#include <cctype>
 #include <chrono>
+#include <cstdio>
+#include <memory>
 #include <string>
 #include <thread>
+#include <vector>
+#include <utility>
 #include <cstdarg>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <iomanip>
 #include <sstream>
+#include <algorithm>
 #include <functional>
+#include <type_traits>
+#include <unordered_map>
 #include <condition_variable>
 
 #include "filesystem.hpp"
 #include "platform.hpp"
+#include "thread_pool.hpp"
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#if PLUTO_UTILS_HAS_CXX_17
+#include <string_view>
+#endif
+
+#if PLUTO_UTILS_HAS_TO_CHARS
+#include <charconv>
+#endif
 
 #if PLUTO_UTILS_HAS_FORMAT
 #include <format>
@@ -42,6 +72,18 @@
 #define PLUTO_LOGGER_HIDE_SOURCE_INFO 0 // Define as 1 or 0
 #endif
 
+#ifndef PLUTO_LOGGER_BUFFER_BLOCK_SIZE
+#define PLUTO_LOGGER_BUFFER_BLOCK_SIZE 65536 // In bytes
+#endif
+
+#ifndef PLUTO_LOGGER_THREAD_BUFFER_MESSAGE_RESERVE
+#define PLUTO_LOGGER_THREAD_BUFFER_MESSAGE_RESERVE 256
+#endif
+
+#ifndef PLUTO_LOGGER_STREAMER_INLINE_SIZE
+#define PLUTO_LOGGER_STREAMER_INLINE_SIZE 256 // Longer messages are moved to the heap
+#endif
+
 #if PLUTO_LOGGER_HIDE_SOURCE_INFO
 #ifndef PLUTO_LOGGER_SOURCE_INFO_ARGS
 #define PLUTO_LOGGER_SOURCE_INFO_ARGS "", 0, ""
@@ -52,6 +94,109 @@
 #endif
 #endif
 
+// Declares the call site's source info, which is built the first time the call site logs
+#define PLUTO_LOGGER_SOURCE_SITE static const pluto::log_site plutoLogSite{ PLUTO_LOGGER_SOURCE_INFO_ARGS }
+
+// Logging macros below this level expand to nothing. Define as a pluto::log_level without the namespace.
+#ifndef PLUTO_LOGGER_COMPILE_TIME_LEVEL
+#define PLUTO_LOGGER_COMPILE_TIME_LEVEL verbose
+#endif
+
+// Level values for the preprocessor, matching pluto::log_level. Header is grouped with verbose.
+#define PLUTO_LOGGER_LEVEL_off      9
+#define PLUTO_LOGGER_LEVEL_fatal    8
+#define PLUTO_LOGGER_LEVEL_critical 7
+#define PLUTO_LOGGER_LEVEL_error    6
+#define PLUTO_LOGGER_LEVEL_warning  5
+#define PLUTO_LOGGER_LEVEL_notice   4
+#define PLUTO_LOGGER_LEVEL_info     3
+#define PLUTO_LOGGER_LEVEL_debug    2
+#define PLUTO_LOGGER_LEVEL_trace    1
+#define PLUTO_LOGGER_LEVEL_verbose  0
+#define PLUTO_LOGGER_LEVEL_header   0
+#define PLUTO_LOGGER_LEVEL_crit     7
+#define PLUTO_LOGGER_LEVEL_warn     5
+#define PLUTO_LOGGER_LEVEL_note     4
+#define PLUTO_LOGGER_LEVEL_verb     0
+#define PLUTO_LOGGER_LEVEL_ftl      8
+#define PLUTO_LOGGER_LEVEL_crt      7
+#define PLUTO_LOGGER_LEVEL_err      6
+#define PLUTO_LOGGER_LEVEL_wrn      5
+#define PLUTO_LOGGER_LEVEL_ntc      4
+#define PLUTO_LOGGER_LEVEL_inf      3
+#define PLUTO_LOGGER_LEVEL_dbg      2
+#define PLUTO_LOGGER_LEVEL_trc      1
+#define PLUTO_LOGGER_LEVEL_vrb      0
+
+#define PLUTO_LOGGER_LEVEL_VALUE(level) PLUTO_LOGGER_LEVEL_VALUE_IMPL(level)
+#define PLUTO_LOGGER_LEVEL_VALUE_IMPL(level) PLUTO_LOGGER_LEVEL_##level
+
+// Expands to the code if the level is at or above the compile time level, otherwise to nothing
+#define PLUTO_LOGGER_IF_COMPILED(level, ...) PLUTO_LOGGER_IF_COMPILED_VALUE(PLUTO_LOGGER_LEVEL_VALUE(level), __VA_ARGS__)
+#define PLUTO_LOGGER_IF_COMPILED_VALUE(value, ...) PLUTO_LOGGER_IF_COMPILED_VALUE_IMPL(value, __VA_ARGS__)
+#define PLUTO_LOGGER_IF_COMPILED_VALUE_IMPL(value, ...) PLUTO_LOGGER_IF_COMPILED_##value(__VA_ARGS__)
+
+#if PLUTO_LOGGER_LEVEL_VALUE(PLUTO_LOGGER_COMPILE_TIME_LEVEL) <= 0
+#define PLUTO_LOGGER_IF_COMPILED_0(...) __VA_ARGS__
+#else
+#define PLUTO_LOGGER_IF_COMPILED_0(...)
+#endif
+
+#if PLUTO_LOGGER_LEVEL_VALUE(PLUTO_LOGGER_COMPILE_TIME_LEVEL) <= 1
+#define PLUTO_LOGGER_IF_COMPILED_1(...) __VA_ARGS__
+#else
+#define PLUTO_LOGGER_IF_COMPILED_1(...)
+#endif
+
+#if PLUTO_LOGGER_LEVEL_VALUE(PLUTO_LOGGER_COMPILE_TIME_LEVEL) <= 2
+#define PLUTO_LOGGER_IF_COMPILED_2(...) __VA_ARGS__
+#else
+#define PLUTO_LOGGER_IF_COMPILED_2(...)
+#endif
+
+#if PLUTO_LOGGER_LEVEL_VALUE(PLUTO_LOGGER_COMPILE_TIME_LEVEL) <= 3
+#define PLUTO_LOGGER_IF_COMPILED_3(...) __VA_ARGS__
+#else
+#define PLUTO_LOGGER_IF_COMPILED_3(...)
+#endif
+
+#if PLUTO_LOGGER_LEVEL_VALUE(PLUTO_LOGGER_COMPILE_TIME_LEVEL) <= 4
+#define PLUTO_LOGGER_IF_COMPILED_4(...) __VA_ARGS__
+#else
+#define PLUTO_LOGGER_IF_COMPILED_4(...)
+#endif
+
+#if PLUTO_LOGGER_LEVEL_VALUE(PLUTO_LOGGER_COMPILE_TIME_LEVEL) <= 5
+#define PLUTO_LOGGER_IF_COMPILED_5(...) __VA_ARGS__
+#else
+#define PLUTO_LOGGER_IF_COMPILED_5(...)
+#endif
+
+#if PLUTO_LOGGER_LEVEL_VALUE(PLUTO_LOGGER_COMPILE_TIME_LEVEL) <= 6
+#define PLUTO_LOGGER_IF_COMPILED_6(...) __VA_ARGS__
+#else
+#define PLUTO_LOGGER_IF_COMPILED_6(...)
+#endif
+
+#if PLUTO_LOGGER_LEVEL_VALUE(PLUTO_LOGGER_COMPILE_TIME_LEVEL) <= 7
+#define PLUTO_LOGGER_IF_COMPILED_7(...) __VA_ARGS__
+#else
+#define PLUTO_LOGGER_IF_COMPILED_7(...)
+#endif
+
+#if PLUTO_LOGGER_LEVEL_VALUE(PLUTO_LOGGER_COMPILE_TIME_LEVEL) <= 8
+#define PLUTO_LOGGER_IF_COMPILED_8(...) __VA_ARGS__
+#else
+#define PLUTO_LOGGER_IF_COMPILED_8(...)
+#endif
+
+// A compile time level of off removes all logging
+#if PLUTO_LOGGER_LEVEL_VALUE(PLUTO_LOGGER_COMPILE_TIME_LEVEL) <= 8
+#define PLUTO_LOGGER_IF_COMPILED_9(...) __VA_ARGS__
+#else
+#define PLUTO_LOGGER_IF_COMPILED_9(...)
+#endif
+
 // Configurable with macros or setters
 #ifndef PLUTO_LOGGER_INITIAL_LEVEL
 #define PLUTO_LOGGER_INITIAL_LEVEL verbose
@@ -73,6 +218,66 @@
 #define PLUTO_LOGGER_INITIAL_BUFFER_FLUSH_SIZE 1
 #endif
 
+#ifndef PLUTO_LOGGER_INITIAL_OVERFLOW_POLICY
+#define PLUTO_LOGGER_INITIAL_OVERFLOW_POLICY discard
+#endif
+
+#ifndef PLUTO_LOGGER_INITIAL_OVERFLOW_TIMEOUT
+#define PLUTO_LOGGER_INITIAL_OVERFLOW_TIMEOUT 100 // In milliseconds
+#endif
+
+#ifndef PLUTO_LOGGER_INITIAL_OVERFLOW_LEVEL
+#define PLUTO_LOGGER_INITIAL_OVERFLOW_LEVEL error
+#endif
+
+#ifndef PLUTO_LOGGER_INITIAL_OVERFLOW_FILE
+#define PLUTO_LOGGER_INITIAL_OVERFLOW_FILE "" // Empty means the log file with ".overflow" appended
+#endif
+
+#ifndef PLUTO_LOGGER_INITIAL_FLUSH_INTERVAL
+#define PLUTO_LOGGER_INITIAL_FLUSH_INTERVAL 0 // 0 means no interval (in milliseconds)
+#endif
+
+#ifndef PLUTO_LOGGER_INITIAL_DEFERRED_FORMATTING
+#define PLUTO_LOGGER_INITIAL_DEFERRED_FORMATTING false
+#endif
+
+#ifndef PLUTO_LOGGER_INITIAL_BINARY_MODE
+#define PLUTO_LOGGER_INITIAL_BINARY_MODE false
+#endif
+
+#ifndef PLUTO_LOGGER_INITIAL_FIELD_FORMAT
+#define PLUTO_LOGGER_INITIAL_FIELD_FORMAT logfmt
+#endif
+
+#ifndef PLUTO_LOGGER_INITIAL_THREAD_BUFFER_SIZE
+#define PLUTO_LOGGER_INITIAL_THREAD_BUFFER_SIZE 0 // 0 means thread buffers are disabled
+#endif
+
+#ifndef PLUTO_LOGGER_INITIAL_WRITER_THREADS
+#define PLUTO_LOGGER_INITIAL_WRITER_THREADS 0 // 0 means the logging thread writes all files
+#endif
+
+#ifndef PLUTO_LOGGER_INITIAL_SYNC_POLICY
+#define PLUTO_LOGGER_INITIAL_SYNC_POLICY never
+#endif
+
+#ifndef PLUTO_LOGGER_INITIAL_SYNC_INTERVAL
+#define PLUTO_LOGGER_INITIAL_SYNC_INTERVAL 1000 // In milliseconds
+#endif
+
+#ifndef PLUTO_LOGGER_INITIAL_FILE_CHECK_INTERVAL
+#define PLUTO_LOGGER_INITIAL_FILE_CHECK_INTERVAL 1000 // 0 means every write (in milliseconds)
+#endif
+
+#ifndef PLUTO_LOGGER_INITIAL_STAGING_SIZE
+#define PLUTO_LOGGER_INITIAL_STAGING_SIZE 0 // 0 means logs aren't staged (in bytes)
+#endif
+
+#ifndef PLUTO_LOGGER_INITIAL_FILE_MAPPING_SIZE
+#define PLUTO_LOGGER_INITIAL_FILE_MAPPING_SIZE 0 // 0 means files are written with system calls (in bytes)
+#endif
+
 #ifndef PLUTO_LOGGER_INITIAL_FILE_ROTATION_SIZE
 #define PLUTO_LOGGER_INITIAL_FILE_ROTATION_SIZE 0 // 0 means no rotation (in bytes)
 #endif
@@ -81,6 +286,35 @@
 #define PLUTO_LOGGER_INITIAL_FILE_ROTATION_LIMIT 0
 #endif
 
+#ifndef PLUTO_LOGGER_INITIAL_FILE_ROTATION_PERIOD
+#define PLUTO_LOGGER_INITIAL_FILE_ROTATION_PERIOD none
+#endif
+
+#ifndef PLUTO_LOGGER_INITIAL_FILE_ROTATION_NAMING
+#define PLUTO_LOGGER_INITIAL_FILE_ROTATION_NAMING index
+#endif
+
+#ifndef PLUTO_LOGGER_INITIAL_FILE_ROTATION_COMPRESS
+#define PLUTO_LOGGER_INITIAL_FILE_ROTATION_COMPRESS false
+#endif
+
+// A custom writer set with a macro is used instead of the default appender
+#ifndef PLUTO_LOGGER_INITIAL_LOG_APPENDER
+#ifdef PLUTO_LOGGER_INITIAL_LOG_WRITER
+#define PLUTO_LOGGER_INITIAL_LOG_APPENDER nullptr
+#else
+#define PLUTO_LOGGER_INITIAL_LOG_APPENDER pluto::logger::default_log_appender
+#endif
+#endif
+
+#ifndef PLUTO_LOGGER_INITIAL_HEADER_APPENDER
+#ifdef PLUTO_LOGGER_INITIAL_HEADER_WRITER
+#define PLUTO_LOGGER_INITIAL_HEADER_APPENDER nullptr
+#else
+#define PLUTO_LOGGER_INITIAL_HEADER_APPENDER pluto::logger::default_header_appender
+#endif
+#endif
+
 #ifndef PLUTO_LOGGER_INITIAL_LOG_WRITER
 #define PLUTO_LOGGER_INITIAL_LOG_WRITER pluto::logger::default_log_writer
 #endif
@@ -92,10 +326,12 @@
 #define PLUTO_LOG_WRITE_WITH(logger, file, level, ...) \
     do \
     { \
+        PLUTO_LOGGER_IF_COMPILED(level, \
         if (logger.should_log(pluto::log_level::level)) \
         { \
-            logger.write(file, pluto::log_level::level, { PLUTO_LOGGER_SOURCE_INFO_ARGS }, __VA_ARGS__); \
-        } \
+            PLUTO_LOGGER_SOURCE_SITE; \
+            logger.write(file, pluto::log_level::level, plutoLogSite.source(), __VA_ARGS__); \
+        }) \
     } \
     while(false)
 
@@ -104,10 +340,12 @@
 #define PLUTO_LOG_WRITEF_WITH(logger, file, level, ...) \
     do \
     { \
+        PLUTO_LOGGER_IF_COMPILED(level, \
         if (logger.should_log(pluto::log_level::level)) \
         { \
-            logger.writef(file, pluto::log_level::level, { PLUTO_LOGGER_SOURCE_INFO_ARGS }, __VA_ARGS__); \
-        } \
+            PLUTO_LOGGER_SOURCE_SITE; \
+            logger.writef(file, pluto::log_level::level, plutoLogSite.source(), __VA_ARGS__); \
+        }) \
     } \
     while(false)
 
@@ -117,23 +355,101 @@
 #define PLUTO_LOG_FORMAT_WITH(logger, file, level, ...) \
     do \
     { \
+        PLUTO_LOGGER_IF_COMPILED(level, \
         if (logger.should_log(pluto::log_level::level)) \
         { \
-            logger.format(file, pluto::log_level::level, { PLUTO_LOGGER_SOURCE_INFO_ARGS }, __VA_ARGS__); \
-        } \
+            PLUTO_LOGGER_SOURCE_SITE; \
+            logger.format(file, pluto::log_level::level, plutoLogSite.source(), __VA_ARGS__); \
+        }) \
     } \
     while(false)
 
 #define PLUTO_LOG_FORMAT(file, level, ...) PLUTO_LOG_FORMAT_WITH(pluto::logger::instance(), file, level, __VA_ARGS__)
 #endif
 
+// Logs through a limiter that's static to the call site, if the check passes. A log that passes first logs how many were suppressed.
+#define PLUTO_LOGGER_IF_ALLOWED(logger, file, level, check, ...) \
+    do \
+    { \
+        PLUTO_LOGGER_IF_COMPILED(level, \
+        if (logger.should_log(pluto::log_level::level)) \
+        { \
+            static pluto::log_limiter plutoLogLimiter{}; \
+            PLUTO_LOGGER_SOURCE_SITE; \
+            if (plutoLogLimiter.check) \
+            { \
+                plutoLogLimiter.write_suppressed(logger, file, pluto::log_level::level, plutoLogSite.source()); \
+                __VA_ARGS__; \
+            } \
+        }) \
+    } \
+    while(false)
+
+#define PLUTO_LOG_WRITE_PER_SECOND_WITH(logger, file, level, limit, ...) \
+    PLUTO_LOGGER_IF_ALLOWED(logger, file, level, per_second(limit), \
+        logger.write(file, pluto::log_level::level, plutoLogSite.source(), __VA_ARGS__))
+
+#define PLUTO_LOG_WRITE_PER_SECOND(file, level, limit, ...) \
+    PLUTO_LOG_WRITE_PER_SECOND_WITH(pluto::logger::instance(), file, level, limit, __VA_ARGS__)
+
+#define PLUTO_LOG_WRITE_EVERY_N_WITH(logger, file, level, n, ...) \
+    PLUTO_LOGGER_IF_ALLOWED(logger, file, level, every_n(n), \
+        logger.write(file, pluto::log_level::level, plutoLogSite.source(), __VA_ARGS__))
+
+#define PLUTO_LOG_WRITE_EVERY_N(file, level, n, ...) \
+    PLUTO_LOG_WRITE_EVERY_N_WITH(pluto::logger::instance(), file, level, n, __VA_ARGS__)
+
+#define PLUTO_LOG_WRITE_FIRST_N_WITH(logger, file, level, first, every, ...) \
+    PLUTO_LOGGER_IF_ALLOWED(logger, file, level, first_n(first, every), \
+        logger.write(file, pluto::log_level::level, plutoLogSite.source(), __VA_ARGS__))
+
+#define PLUTO_LOG_WRITE_FIRST_N(file, level, first, every, ...) \
+    PLUTO_LOG_WRITE_FIRST_N_WITH(pluto::logger::instance(), file, level, first, every, __VA_ARGS__)
+
+#define PLUTO_LOG_WRITEF_PER_SECOND_WITH(logger, file, level, limit, ...) \
+    PLUTO_LOGGER_IF_ALLOWED(logger, file, level, per_second(limit), \
+        logger.writef(file, pluto::log_level::level, plutoLogSite.source(), __VA_ARGS__))
+
+#define PLUTO_LOG_WRITEF_PER_SECOND(file, level, limit, ...) \
+    PLUTO_LOG_WRITEF_PER_SECOND_WITH(pluto::logger::instance(), file, level, limit, __VA_ARGS__)
+
+#define PLUTO_LOG_WRITEF_EVERY_N_WITH(logger, file, level, n, ...) \
+    PLUTO_LOGGER_IF_ALLOWED(logger, file, level, every_n(n), \
+        logger.writef(file, pluto::log_level::level, plutoLogSite.source(), __VA_ARGS__))
+
+#define PLUTO_LOG_WRITEF_EVERY_N(file, level, n, ...) \
+    PLUTO_LOG_WRITEF_EVERY_N_WITH(pluto::logger::instance(), file, level, n, __VA_ARGS__)
+
+#define PLUTO_LOG_WRITEF_FIRST_N_WITH(logger, file, level, first, every, ...) \
+    PLUTO_LOGGER_IF_ALLOWED(logger, file, level, first_n(first, every), \
+        logger.writef(file, pluto::log_level::level, plutoLogSite.source(), __VA_ARGS__))
+
+#define PLUTO_LOG_WRITEF_FIRST_N(file, level, first, every, ...) \
+    PLUTO_LOG_WRITEF_FIRST_N_WITH(pluto::logger::instance(), file, level, first, every, __VA_ARGS__)
+
+#define PLUTO_LOG_WRITE_KV_WITH(logger, file, level, ...) \
+    do \
+    { \
+        PLUTO_LOGGER_IF_COMPILED(level, \
+        if (logger.should_log(pluto::log_level::level)) \
+        { \
+            PLUTO_LOGGER_SOURCE_SITE; \
+            logger.write_kv(file, pluto::log_level::level, plutoLogSite.source(), __VA_ARGS__); \
+        }) \
+    } \
+    while(false)
+
+#define PLUTO_LOG_WRITE_KV(file, level, ...) PLUTO_LOG_WRITE_KV_WITH(pluto::logger::instance(), file, level, __VA_ARGS__)
+
 #define PLUTO_LOG_STREAM_WITH(logger, file, level, ...) \
     do \
     { \
+        PLUTO_LOGGER_IF_COMPILED(level, \
         if (logger.should_log(pluto::log_level::level)) \
         { \
-            (logger.stream(file, pluto::log_level::level, { PLUTO_LOGGER_SOURCE_INFO_ARGS }) << __VA_ARGS__).end(); \
-        } \
+            PLUTO_LOGGER_SOURCE_SITE; \
+            (logger.stream(file, pluto::log_level::level, plutoLogSite.source()) << __VA_ARGS__).end(); \
+        }) \
     } \
     while (false)
 
@@ -171,28 +487,100 @@ namespace pluto
         vrb = verbose
     };
 
+    enum class log_overflow : unsigned char
+    {
+        discard,            // Discard new logs.
+        block,              // Block the calling thread until there's room, or until the overflow timeout, then discard.
+        discard_oldest,     // Discard the oldest log in the buffer to make room.
+        discard_by_level,   // Discard new logs below the overflow level, and keep the rest even though the buffer is full.
+        spill               // Write new logs straight to the overflow file from the calling thread.
+    };
+
+    enum class log_sync : unsigned char
+    {
+        never,      // Leave writing to disk to the operating system.
+        per_batch,  // Sync after each batch of logs is written to a file.
+        interval    // Sync at most once per interval, while a file has logs that haven't been synced.
+    };
+
+    enum class log_period : unsigned char
+    {
+        none,       // Only rotate files by size.
+        hourly,     // Rotate files at the start of each hour, local time.
+        daily       // Rotate files at midnight, local time.
+    };
+
+    enum class log_naming : unsigned char
+    {
+        index,      // Rotated files are numbered, newest first. Each rotation renames every rotated file.
+        timestamp   // Rotated files are named by the time they were rotated. Each rotation renames one file.
+    };
+
+    enum class log_fields : unsigned char
+    {
+        logfmt, // Messages with fields are written like msg="message" key=value.
+        json    // Messages with fields are written like {"msg":"message","key":value}.
+    };
+
+    class log_site;
+
     struct source_info
     {
-        const char* file;
-        int         line;
-        const char* function;
+        const char*     file;
+        int             line;
+        const char*     function;
+        const log_site* site;       // Set by the logging macros, so the default log writer can copy the rendered source
 
         PLUTO_UTILS_CONSTEXPR source_info(
-            const char* const   file,
-            const int           line,
-            const char* const   function) :
+            const char* const       file,
+            const int               line,
+            const char* const       function,
+            const log_site* const   site = nullptr) :
             file    { file },
             line    { line },
-            function{ function } {}
+            function{ function },
+            site    { site } {}
 
 #if PLUTO_UTILS_HAS_SOURCE_LOCATION
         PLUTO_UTILS_CONSTEXPR source_info(const std::source_location& source = std::source_location::current()) :
             file    { source.file_name() },
             line    { static_cast<int>(source.line()) },
-            function{ source.function_name() } {}
+            function{ source.function_name() },
+            site    { nullptr } {}
 #endif
     };
 
+    // Source info for one call site, with the default log writer's file name, line and function columns rendered once.
+    // The logging macros keep one of these static to each call site.
+    class log_site
+    {
+        source_info m_source;
+        char        m_text[64];
+        std::size_t m_size;
+
+    public:
+        log_site(const char* const file, const int line, const char* const function);
+
+        log_site(const log_site&) = delete;
+
+        log_site& operator=(const log_site&) = delete;
+
+        PLUTO_UTILS_NODISCARD const source_info& source() const
+        {
+            return m_source;
+        }
+
+        PLUTO_UTILS_NODISCARD const char* text() const
+        {
+            return m_text;
+        }
+
+        PLUTO_UTILS_NODISCARD std::size_t size() const
+        {
+            return m_size;
+        }
+    };
+
     struct log_entry
     {
         typedef PLUTO_LOGGER_CLOCK_TYPE::time_point time_type;
@@ -216,6 +604,27 @@ namespace pluto
             message     { message } {}
     };
 
+    struct log_file_stats
+    {
+        std::size_t                 records_enqueued    { 0 };  // Logs added to the file's buffer
+        std::size_t                 records_written     { 0 };
+        std::size_t                 bytes_written       { 0 };
+        std::size_t                 flushes             { 0 };  // Batches of logs written to the file
+        std::vector<std::size_t>    flush_latencies     {};     // Flushes by how long they took, in powers of 2 microseconds
+        std::size_t                 max_buffer_depth    { 0 };  // Most logs waiting in the file's buffer at once
+        std::size_t                 rotations           { 0 };
+        std::chrono::nanoseconds    rotation_time       { 0 };
+    };
+
+    struct log_stats
+    {
+        log_file_stats                          total           {};     // All files added up, with the largest buffer depth
+        std::map<std::string, log_file_stats>   files           {};
+        std::size_t                             lock_waits      { 0 };  // Times a logging call found a lock it needed taken
+        std::chrono::nanoseconds                lock_wait_time  { 0 };
+        std::size_t                             discarded       { 0 };
+    };
+
     PLUTO_UTILS_NODISCARD_CONSTEXPR const char* log_level_to_c_str(const log_level logLevel)
     {
         switch (logLevel)
@@ -288,640 +697,6331 @@ namespace pluto
         }
     }
 
-    class logger
+    enum class log_arg_type : unsigned char
     {
-    public:
-        typedef PLUTO_LOGGER_CLOCK_TYPE clock_type;
+        boolean,
+        character,
+        signed_integer,
+        unsigned_integer,
+        floating_point,
+        string,
+        static_string,
+        pointer
+    };
 
-    private:
-        class streamer
+    struct log_arg
+    {
+        log_arg_type        type                { log_arg_type::boolean };
+        unsigned char       size                { 0 };      // Size of the original value in bytes
+        bool                boolean             { false };
+        char                character           { '\0' };
+        long long           signed_integer      { 0 };
+        unsigned long long  unsigned_integer    { 0 };
+        long double         floating_point      { 0 };
+        const char*         string              { nullptr };
+        std::size_t         string_size         { 0 };
+        std::uintptr_t      pointer             { 0 };
+
+        PLUTO_UTILS_NODISCARD inline bool is_string() const
         {
-            logger*             m_logger;
-            const std::string   m_logFile;
-            const log_level     m_logLevel;
-            const source_info   m_sourceInfo;
-            std::ostringstream  m_stream;
+            return (type == log_arg_type::string || type == log_arg_type::static_string);
+        }
 
-        public:
-            streamer(
-                logger*             logger,
-                const std::string&  logFile,
-                const log_level     logLevel,
-                const source_info   sourceInfo) :
-                m_logger    { logger },
-                m_logFile   { logFile },
-                m_logLevel  { logLevel },
-                m_sourceInfo{ sourceInfo },
-                m_stream    {} {}
+        PLUTO_UTILS_NODISCARD long long to_signed() const
+        {
+            switch (type)
+            {
+                case log_arg_type::boolean:             return static_cast<long long>(boolean);
+                case log_arg_type::character:           return static_cast<long long>(character);
+                case log_arg_type::signed_integer:      return signed_integer;
+                case log_arg_type::unsigned_integer:    return static_cast<long long>(unsigned_integer);
+                case log_arg_type::floating_point:      return static_cast<long long>(floating_point);
+                case log_arg_type::pointer:             return static_cast<long long>(pointer);
+                default:                                return 0;
+            }
+        }
 
-            ~streamer()
+        PLUTO_UTILS_NODISCARD unsigned long long to_unsigned() const
+        {
+            return ((type == log_arg_type::unsigned_integer) ? unsigned_integer : static_cast<unsigned long long>(to_signed()));
+        }
+
+        PLUTO_UTILS_NODISCARD long double to_floating() const
+        {
+            switch (type)
             {
-                end();
+                case log_arg_type::floating_point:      return floating_point;
+                case log_arg_type::unsigned_integer:    return static_cast<long double>(unsigned_integer);
+                default:                                return static_cast<long double>(to_signed());
             }
+        }
+    };
 
-            streamer(const streamer&) = delete;
+    // A key and value passed to write_kv(). The key is stored as a pointer, so it must outlive the log, like a string literal.
+    template<class Value>
+    struct log_field
+    {
+        const char*     key;
+        const Value&    value;
+    };
 
-            streamer(streamer&&) = delete;
+    template<class Value>
+    PLUTO_UTILS_NODISCARD inline log_field<Value> kv(const char* const key, const Value& value)
+    {
+        return { key, value };
+    }
 
-            streamer& operator=(const streamer&) = delete;
+    // Message renderers take a buffer of log args, where the first arg is the scheme
+    typedef void(*log_renderer)(std::string& message, const char* args, std::size_t size);
 
-            streamer& operator=(streamer&&) = delete;
+    // Writes args to a compact, self describing buffer and renders messages from that buffer later.
+    // Each arg is written as its type, its size and its bytes. Strings are written as their length and their characters,
+    // except static strings, which are written as their length and a pointer.
+    class log_args
+    {
+        template<class Value, class Enable = void>
+        struct traits
+        {
+            static constexpr bool is_deferrable{ false };
+        };
 
-            void end()
+        template<class Value>
+        struct number_traits
+        {
+            static constexpr bool is_deferrable{ true };
+
+            static inline std::size_t size(const Value&)
             {
-                if (m_logger && m_logger->should_log(m_logLevel))
-                {
-                    m_logger->add_log_to_buffer(m_logFile, m_logLevel, m_sourceInfo, m_stream.str());
-                    m_logger = nullptr;
-                }
+                return (2 + sizeof(Value));
             }
 
-            template<class Value>
-            inline streamer& operator<<(const Value& value)
+            static inline char* write(char* dest, const Value value, const log_arg_type type)
             {
-                m_stream << value;
-                return *this;
+                *dest++ = static_cast<char>(type);
+                *dest++ = static_cast<char>(sizeof(Value));
+                std::memcpy(dest, &value, sizeof(Value));
+                return (dest + sizeof(Value));
             }
         };
 
-        typedef std::list<log_entry> log_buffer;
-
-        struct log_file
+        struct string_traits
         {
-            log_buffer              buffer      {};
-            pluto::filesystem::path filePath    {};
-            bool                    dirsCreated { false };
+            static constexpr bool is_deferrable{ true };
+
+            static inline std::size_t size(const char* const, const std::size_t stringSize)
+            {
+                return (2 + sizeof(std::uint32_t) + stringSize);
+            }
+
+            static inline char* write(char* dest, const char* const string, const std::size_t stringSize)
+            {
+                const auto length{ static_cast<std::uint32_t>(stringSize) };
+
+                *dest++ = static_cast<char>(log_arg_type::string);
+                *dest++ = 0;
+                std::memcpy(dest, &length, sizeof(length));
+                std::memcpy(dest + sizeof(length), string, stringSize);
+                return (dest + sizeof(length) + stringSize);
+            }
         };
 
-        std::mutex                      m_loggingMutex      {};
-        std::thread                     m_loggingThread     {};
-        std::condition_variable         m_loggingCondition  {};
-        std::map<std::string, log_file> m_logFiles          {};
+        // Args are passed by const reference, so arrays decay to pointers to const
+        template<class Value>
+        using arg_type = typename std::decay<const Value>::type;
 
-        std::atomic_bool        m_isLogging         { true };
-        std::atomic<log_level>  m_level             { log_level::PLUTO_LOGGER_INITIAL_LEVEL };
-        std::atomic_bool        m_createDirs        { PLUTO_LOGGER_INITIAL_CREATE_DIRS };
-        std::atomic_bool        m_writeHeader       { PLUTO_LOGGER_INITIAL_WRITE_HEADER };
-        std::atomic_size_t      m_bufferMaxSize     { PLUTO_LOGGER_INITIAL_BUFFER_MAX_SIZE };
-        std::atomic_size_t      m_bufferFlushSize   { PLUTO_LOGGER_INITIAL_BUFFER_FLUSH_SIZE };
-        std::atomic_size_t      m_fileRotationSize  { PLUTO_LOGGER_INITIAL_FILE_ROTATION_SIZE };
-        std::atomic_size_t      m_fileRotationLimit { PLUTO_LOGGER_INITIAL_FILE_ROTATION_LIMIT };
-        std::atomic_size_t      m_numDiscardedLogs  { 0 };
+        template<class Value>
+        struct is_c_string : std::integral_constant<bool,
+            (std::is_same<Value, const char*>::value || std::is_same<Value, char*>::value)> {};
 
-        mutable std::mutex                                      m_configMutex   {};
-        std::function<void(std::ostream&, const log_entry&)>    m_logWriter     { PLUTO_LOGGER_INITIAL_LOG_WRITER };
-        std::function<void(std::ostream&)>                      m_headerWriter  { PLUTO_LOGGER_INITIAL_HEADER_WRITER };
+        // Wide strings are formatted straight away, since they're only read as strings by the conversion
+        template<class Value>
+        struct is_wide_c_string : std::integral_constant<bool, (std::is_pointer<Value>::value && (
+            std::is_same<typename std::remove_cv<typename std::remove_pointer<Value>::type>::type, wchar_t>::value ||
+#ifdef __cpp_char8_t
+            std::is_same<typename std::remove_cv<typename std::remove_pointer<Value>::type>::type, char8_t>::value ||
+#endif
+            std::is_same<typename std::remove_cv<typename std::remove_pointer<Value>::type>::type, char16_t>::value ||
+            std::is_same<typename std::remove_cv<typename std::remove_pointer<Value>::type>::type, char32_t>::value))> {};
 
-    public:
-        logger()
+        template<class... Values>
+        struct has_any_c_string : std::false_type {};
+
+        template<class Value, class... Values>
+        struct has_any_c_string<Value, Values...> : std::integral_constant<bool,
+            (is_c_string<arg_type<Value>>::value || has_any_c_string<Values...>::value)> {};
+
+        template<class... Values>
+        struct are_all_deferrable : std::true_type {};
+
+        template<class Value, class... Values>
+        struct are_all_deferrable<Value, Values...> : std::integral_constant<bool,
+            (traits<arg_type<Value>>::is_deferrable && are_all_deferrable<Values...>::value)> {};
+
+        template<class Value>
+        static inline std::size_t size_of(const Value& value)
         {
-            m_loggingThread = std::thread(&logger::start_logging, this);
+            return traits<arg_type<Value>>::size(value);
         }
 
-        ~logger()
+        template<class Value>
+        static inline char* write_one(char* dest, const Value& value)
         {
-            m_isLogging.store(false);
-            m_loggingCondition.notify_all();
+            return traits<arg_type<Value>>::write(dest, value);
+        }
 
-            if (m_loggingThread.joinable())
+        template<class... Values>
+        static inline void append_printf(std::string& message, const std::string& spec, const Values... values)
+        {
+            char buffer[128];
+            const auto length{ std::snprintf(buffer, sizeof(buffer), spec.c_str(), values...) };
+
+            if (length < 0)
             {
-                m_loggingThread.join();
+                return;
             }
 
-            // Write all buffers to their files
-            for (auto& logFilePair : m_logFiles)
+            if (static_cast<std::size_t>(length) < sizeof(buffer))
             {
-                auto& buffer{ logFilePair.second.buffer };
-
-                if (!buffer.empty())
-                {
-                    auto& fileName      { logFilePair.first };
-                    auto& filePath      { logFilePair.second.filePath };
-                    auto& dirsCreated   { logFilePair.second.dirsCreated };
-
-                    write_buffer_to_file(buffer.begin(), buffer.end(), fileName, filePath, dirsCreated);
-                }
+                message.append(buffer, static_cast<std::size_t>(length));
+            }
+            else
+            {
+                const auto offset{ message.size() };
+                message.resize(offset + length + 1);
+                std::snprintf(&message[offset], length + 1, spec.c_str(), values...);
+                message.resize(offset + length);
             }
         }
 
-        logger(const logger&) = delete;
+        static void append_printf_signed(std::string& message, const std::string& spec, const std::string& length, const long long value)
+        {
+            if (length == "hh")         append_printf(message, spec, static_cast<int>(static_cast<signed char>(value)));
+            else if (length == "h")     append_printf(message, spec, static_cast<int>(static_cast<short>(value)));
+            else if (length == "l")     append_printf(message, spec, static_cast<long>(value));
+            else if (length == "j")     append_printf(message, spec, static_cast<std::intmax_t>(value));
+            else if (length == "z")     append_printf(message, spec, static_cast<std::make_signed<std::size_t>::type>(value));
+            else if (length == "t")     append_printf(message, spec, static_cast<std::ptrdiff_t>(value));
+            else if (length.empty())    append_printf(message, spec, static_cast<int>(value));
+            else                        append_printf(message, spec, value);
+        }
 
-        logger(logger&&) = delete;
-
-        logger& operator=(const logger&) = delete;
-
-        logger& operator=(logger&&) = delete;
-
-        static inline logger& instance()
+        static void append_printf_unsigned(std::string& message, const std::string& spec, const std::string& length, const unsigned long long value)
         {
-            static logger instance{};
-            return instance;
+            if (length == "hh")         append_printf(message, spec, static_cast<unsigned int>(static_cast<unsigned char>(value)));
+            else if (length == "h")     append_printf(message, spec, static_cast<unsigned int>(static_cast<unsigned short>(value)));
+            else if (length == "l")     append_printf(message, spec, static_cast<unsigned long>(value));
+            else if (length == "j")     append_printf(message, spec, static_cast<std::uintmax_t>(value));
+            else if (length == "z")     append_printf(message, spec, static_cast<std::size_t>(value));
+            else if (length == "t")     append_printf(message, spec, static_cast<std::make_unsigned<std::ptrdiff_t>::type>(value));
+            else if (length.empty())    append_printf(message, spec, static_cast<unsigned int>(value));
+            else                        append_printf(message, spec, value);
         }
 
-        static void default_log_writer(std::ostream& stream, const log_entry& log)
+        static void append_text(std::string& message, const log_arg& arg)
         {
-            const auto localTime{ pluto::local_time(pluto::logger::clock_type::to_time_t(log.time)) };
-
-            const auto microseconds{ std::chrono::duration_cast<std::chrono::microseconds>(
-                        log.time.time_since_epoch()).count() % 1'000'000 };
-
-            stream << std::right << std::setfill('0')
-                << std::put_time(&localTime, "%Y-%m-%d %H:%M:%S.")
-                << std::setw(6) << microseconds << '|'
-                << std::setfill(' ')
-                << std::setw(7) << log.thread_id << '|'
-                << std::left
-                << std::setw(8) << pluto::log_level_to_title(log.level) << '|'
-    #if !PLUTO_LOGGER_HIDE_SOURCE_INFO
-                << std::setw(20) << std::string(pluto::file_name(log.source.file), 0, 20) << '|'
-                << std::right
-                << std::setw(5) << log.source.line << '|'
-                << std::left
-                << std::setw(20) << std::string(log.source.function, 0, 20) << '|'
-    #endif
-                << log.message;
+            switch (arg.type)
+            {
+                case log_arg_type::boolean:             message.append(arg.boolean ? "true" : "false"); break;
+                case log_arg_type::character:           message.push_back(arg.character); break;
+                case log_arg_type::signed_integer:      message.append(std::to_string(arg.signed_integer)); break;
+                case log_arg_type::unsigned_integer:    message.append(std::to_string(arg.unsigned_integer)); break;
+                case log_arg_type::floating_point:      append_printf(message, "%Lg", arg.floating_point); break;
+                case log_arg_type::pointer:             append_printf(message, "%p", reinterpret_cast<const void*>(arg.pointer)); break;
+                default:                                message.append(arg.string, arg.string_size); break;
+            }
         }
 
-        static void default_header_writer(std::ostream& stream)
+        static void append_escaped(std::string& message, const char* const string, const std::size_t stringSize)
         {
-            stream << std::left << std::setfill(' ')
-                << std::setw(26) << "Timestamp" << '|'
-                << std::right
-                << std::setw(7) << "TID" << '|'
-                << std::left
-                << std::setw(8) << pluto::log_level_to_title(log_level::header) << '|'
-    #if !PLUTO_LOGGER_HIDE_SOURCE_INFO
-                << std::setw(20) << "File Name" << '|'
-                << std::right
-                << std::setw(5) << "Line" << '|'
-                << std::left
-                << std::setw(20) << "Function" << '|'
-    #endif
-                << "Message" << '\n'
-                << std::setfill('-')
-                << std::setw(26) << "" << '+'
-                << std::setw(7) << "" << '+'
-                << std::setw(8) << "" << '+'
-    #if !PLUTO_LOGGER_HIDE_SOURCE_INFO
-                << std::setw(20) << "" << '+'
-                << std::setw(5) << "" << '+'
-                << std::setw(20) << "" << '+'
-    #endif
-                << std::setw(7) << ""
-                << std::setfill(' ');
+            for (std::size_t i{ 0 }; i < stringSize; ++i)
+            {
+                const auto c{ string[i] };
+                switch (c)
+                {
+                    case '"':   message.append("\\\""); break;
+                    case '\\':  message.append("\\\\"); break;
+                    case '\n':  message.append("\\n"); break;
+                    case '\r':  message.append("\\r"); break;
+                    case '\t':  message.append("\\t"); break;
+                    default:
+                    {
+                        if (static_cast<unsigned char>(c) < 0x20)
+                        {
+                            append_printf(message, "\\u%04x", static_cast<unsigned int>(c));
+                        }
+                        else
+                        {
+                            message.push_back(c);
+                        }
+                        break;
+                    }
+                }
+            }
         }
 
-        PLUTO_UTILS_NODISCARD inline bool is_logging() const
+        // Strings are quoted if they're empty or contain spaces, quotes, equals signs or control characters
+        static void append_logfmt_string(std::string& message, const char* const string, const std::size_t stringSize)
         {
-            return m_isLogging.load();
-        }
+            const auto stringEnd{ string + stringSize };
+            const auto needsQuotes{ stringSize == 0 || std::find_if(string, stringEnd,
+                [](const char c) { return (c == ' ' || c == '"' || c == '=' || static_cast<unsigned char>(c) < 0x20); }) != stringEnd };
 
-        PLUTO_UTILS_NODISCARD inline log_level level() const
-        {
-            return m_level.load();
+            if (needsQuotes)
+            {
+                message.push_back('"');
+                append_escaped(message, string, stringSize);
+                message.push_back('"');
+            }
+            else
+            {
+                message.append(string, stringSize);
+            }
         }
 
-        PLUTO_UTILS_NODISCARD inline bool create_dirs() const
+        static inline void append_json_string(std::string& message, const char* const string, const std::size_t stringSize)
         {
-            return m_createDirs.load();
+            message.push_back('"');
+            append_escaped(message, string, stringSize);
+            message.push_back('"');
         }
 
-        PLUTO_UTILS_NODISCARD inline bool write_header() const
+        static void append_logfmt_value(std::string& message, const log_arg& arg)
         {
-            return m_writeHeader.load();
+            if (arg.is_string())
+            {
+                append_logfmt_string(message, arg.string, arg.string_size);
+            }
+            else if (arg.type == log_arg_type::character)
+            {
+                append_logfmt_string(message, &arg.character, 1);
+            }
+            else
+            {
+                append_text(message, arg);
+            }
         }
 
-        PLUTO_UTILS_NODISCARD inline std::size_t buffer_max_size() const
+        static void append_json_value(std::string& message, const log_arg& arg)
         {
-            return m_bufferMaxSize.load();
-        }
+            switch (arg.type)
+            {
+                case log_arg_type::character:
+                {
+                    append_json_string(message, &arg.character, 1);
+                    break;
+                }
+                case log_arg_type::floating_point:
+                {
+                    // JSON has no infinity or NaN
+                    if (std::isfinite(arg.floating_point))
+                    {
+                        append_text(message, arg);
+                    }
+                    else
+                    {
+                        message.append("null");
+                    }
+                    break;
+                }
+                case log_arg_type::pointer:
+                {
+                    const auto offset{ message.size() };
+                    append_text(message, arg);
 
-        PLUTO_UTILS_NODISCARD inline std::size_t buffer_flush_size() const
-        {
-            return m_bufferFlushSize.load();
+                    message.insert(offset, 1, '"');
+                    message.push_back('"');
+                    break;
+                }
+                case log_arg_type::string:
+                case log_arg_type::static_string:
+                {
+                    append_json_string(message, arg.string, arg.string_size);
+                    break;
+                }
+                default:
+                {
+                    append_text(message, arg);
+                    break;
+                }
+            }
         }
 
-        PLUTO_UTILS_NODISCARD inline std::size_t file_rotation_size() const
+#if PLUTO_UTILS_HAS_FORMAT
+        static void append_format(std::string& message, const std::string& spec, const log_arg& arg)
         {
-            return m_fileRotationSize.load();
+            try
+            {
+                switch (arg.type)
+                {
+                    case log_arg_type::boolean:
+                    {
+                        const auto value{ arg.boolean };
+                        message.append(std::vformat(spec, std::make_format_args(value)));
+                        break;
+                    }
+                    case log_arg_type::character:
+                    {
+                        const auto value{ arg.character };
+                        message.append(std::vformat(spec, std::make_format_args(value)));
+                        break;
+                    }
+                    case log_arg_type::signed_integer:
+                    {
+                        const auto value{ arg.signed_integer };
+                        message.append(std::vformat(spec, std::make_format_args(value)));
+                        break;
+                    }
+                    case log_arg_type::unsigned_integer:
+                    {
+                        const auto value{ arg.unsigned_integer };
+                        message.append(std::vformat(spec, std::make_format_args(value)));
+                        break;
+                    }
+                    case log_arg_type::floating_point:
+                    {
+                        // Keep the original type, since the shortest representation of a float differs from a double
+                        if (arg.size == sizeof(float))
+                        {
+                            const auto value{ static_cast<float>(arg.floating_point) };
+                            message.append(std::vformat(spec, std::make_format_args(value)));
+                        }
+                        else if (arg.size == sizeof(double))
+                        {
+                            const auto value{ static_cast<double>(arg.floating_point) };
+                            message.append(std::vformat(spec, std::make_format_args(value)));
+                        }
+                        else
+                        {
+                            const auto value{ arg.floating_point };
+                            message.append(std::vformat(spec, std::make_format_args(value)));
+                        }
+                        break;
+                    }
+                    case log_arg_type::pointer:
+                    {
+                        const auto value{ reinterpret_cast<const void*>(arg.pointer) };
+                        message.append(std::vformat(spec, std::make_format_args(value)));
+                        break;
+                    }
+                    default:
+                    {
+                        const std::string_view value{ arg.string, arg.string_size };
+                        message.append(std::vformat(spec, std::make_format_args(value)));
+                        break;
+                    }
+                }
+            }
+            catch (const std::format_error&)
+            {
+                append_text(message, arg);
+            }
         }
+#endif
 
-        PLUTO_UTILS_NODISCARD inline std::size_t file_rotation_limit() const
+    public:
+        // How a printf scheme uses a char pointer arg
+        struct printf_capture
         {
-            return m_fileRotationLimit.load();
-        }
+            bool        isPointer   { false };
+            std::size_t maxSize     { static_cast<std::size_t>(-1) };  // Read until the terminator if not limited
+        };
 
-        PLUTO_UTILS_NODISCARD inline std::size_t num_discarded_logs() const
+        // A char pointer arg, read as far as the printf scheme allows
+        struct printf_string
         {
-            return m_numDiscardedLogs.load();
-        }
+            const char* string;
+            std::size_t size;
+            bool        isPointer;
+        };
 
-        PLUTO_UTILS_NODISCARD inline std::function<void(std::ostream&, const log_entry&)> log_writer() const
-        {
-            const std::unique_lock<std::mutex> lock{ m_configMutex };
-            return m_logWriter;
-        }
+        template<class... Values>
+        using are_deferrable = are_all_deferrable<Values...>;
 
-        PLUTO_UTILS_NODISCARD inline std::function<void(std::ostream&)> header_writer() const
-        {
-            const std::unique_lock<std::mutex> lock{ m_configMutex };
-            return m_headerWriter;
-        }
+        template<class... Values>
+        using has_c_string = has_any_c_string<Values...>;
 
-        inline logger& level(const log_level level)
+        template<class Value>
+        static inline typename std::enable_if<std::is_integral<Value>::value, long long>::type to_integer(const Value value)
         {
-            m_level.store(level);
-            return *this;
+            return static_cast<long long>(value);
         }
 
-        inline logger& create_dirs(const bool createDirs)
+        template<class Value>
+        static inline typename std::enable_if<!std::is_integral<Value>::value, long long>::type to_integer(const Value&)
         {
-            m_createDirs.store(createDirs);
-            return *this;
+            return 0;
         }
 
-        inline logger& write_header(const bool writeHeader)
+        template<class Value>
+        static inline typename std::enable_if<!is_c_string<arg_type<Value>>::value, const Value&>::type capture(
+            const Value&            value,
+            const printf_capture&)
         {
-            m_writeHeader.store(writeHeader);
-            return *this;
+            return value;
         }
 
-        inline logger& buffer_max_size(const std::size_t bufferMaxSize)
+        // Strings are only read as far as printf would read them, so a buffer limited by precision needn't be terminated
+        template<class Value>
+        static inline typename std::enable_if<is_c_string<arg_type<Value>>::value, printf_string>::type capture(
+            const Value             value,
+            const printf_capture&   printfCapture)
         {
-            m_bufferMaxSize.store(bufferMaxSize);
-            return *this;
-        }
+            if (printfCapture.isPointer)
+            {
+                return { value, 0, true };
+            }
 
-        inline logger& buffer_flush_size(const std::size_t bufferFlushSize)
-        {
-            m_bufferFlushSize.store(bufferFlushSize);
-            m_loggingCondition.notify_one(); // wake the logging thread
-            return *this;
-        }
+            if (value == nullptr)
+            {
+                return { "(null)", 6, false };
+            }
 
-        inline logger& file_rotation_size(const std::size_t fileRotationSize)
-        {
-            m_fileRotationSize.store(fileRotationSize);
-            return *this;
+            if (printfCapture.maxSize == static_cast<std::size_t>(-1))
+            {
+                return { value, std::strlen(value), false };
+            }
+
+            const auto terminator{ static_cast<const char*>(std::memchr(value, '\0', printfCapture.maxSize)) };
+            return { value, (terminator ? static_cast<std::size_t>(terminator - value) : printfCapture.maxSize), false };
         }
 
-        inline logger& file_rotation_limit(const std::size_t fileRotationLimit)
+        // Finds how each char pointer arg is used by a printf scheme, following the parsing of render_printf().
+        // Takes the integer value of each arg, for precisions passed as args. Returns false if an arg has no conversion.
+        static bool capture_printf_strings(
+            const char*         pScheme,
+            const long long*    integers,
+            printf_capture*     captures,
+            const std::size_t   size)
         {
-            m_fileRotationLimit.store(fileRotationLimit);
-            return *this;
+            std::size_t index{ 0 };
+
+            while (index < size)
+            {
+                pScheme = std::strchr(pScheme, '%');
+                if (pScheme == nullptr)
+                {
+                    return false;
+                }
+
+                if (*++pScheme == '%')
+                {
+                    ++pScheme;
+                    continue;
+                }
+
+                while (*pScheme == '-' || *pScheme == '+' || *pScheme == ' ' || *pScheme == '#' || *pScheme == '0')
+                {
+                    ++pScheme;
+                }
+
+                if (*pScheme == '*')
+                {
+                    ++pScheme;
+                    ++index;
+                }
+                else
+                {
+                    while (std::isdigit(static_cast<unsigned char>(*pScheme)))
+                    {
+                        ++pScheme;
+                    }
+                }
+
+                long long precision{ -1 };
+                if (*pScheme == '.')
+                {
+                    ++pScheme;
+                    precision = 0;
+
+                    if (*pScheme == '*')
+                    {
+                        ++pScheme;
+                        precision = ((index < size) ? integers[index++] : -1);
+                    }
+                    else
+                    {
+                        while (std::isdigit(static_cast<unsigned char>(*pScheme)))
+                        {
+                            precision = (precision * 10) + (*pScheme++ - '0');
+                        }
+                    }
+                }
+
+                while (*pScheme == 'h' || *pScheme == 'l' || *pScheme == 'j' || *pScheme == 'z' || *pScheme == 't' || *pScheme == 'L' || *pScheme == 'q')
+                {
+                    ++pScheme;
+                }
+
+                if (*pScheme == '\0' || size <= index)
+                {
+                    return false;
+                }
+
+                // Anything but a string is read as a pointer, so it's never dereferenced
+                const auto conversion{ *pScheme++ };
+                captures[index].isPointer = (conversion != 's');
+                if (conversion == 's' && 0 <= precision)
+                {
+                    captures[index].maxSize = static_cast<std::size_t>(precision);
+                }
+
+                ++index;
+            }
+
+            return true;
         }
 
-        inline logger& reset_num_discarded_logs()
+        template<class... Values>
+        static std::size_t size(const Values&... values)
         {
-            m_numDiscardedLogs.store(0);
-            return *this;
+            const std::size_t sizes[]{ 0, size_of(values)... };
+
+            std::size_t total{ 0 };
+            for (const auto thisSize : sizes)
+            {
+                total += thisSize;
+            }
+
+            return total;
         }
 
-        inline logger& log_writer(const std::function<void(std::ostream&, const log_entry&)>& logWriter)
+        template<class... Values>
+        static char* write(char* dest, const Values&... values)
         {
-            const std::unique_lock<std::mutex> lock{ m_configMutex };
-            m_logWriter = logWriter;
-            return *this;
+            const int expander[]{ 0, ((dest = write_one(dest, values)), 0)... };
+            static_cast<void>(expander);
+            return dest;
         }
 
-        inline logger& header_writer(const std::function<void(std::ostream&)>& headerWriter)
+        static inline std::size_t string_size(const std::size_t stringSize)
         {
-            const std::unique_lock<std::mutex> lock{ m_configMutex };
-            m_headerWriter = headerWriter;
-            return *this;
+            return string_traits::size(nullptr, stringSize);
         }
 
-        PLUTO_UTILS_NODISCARD inline bool should_log(const log_level logLevel) const
+        static inline char* write_string(char* dest, const char* const string, const std::size_t stringSize)
         {
-            return (is_logging() && level() <= logLevel);
+            return string_traits::write(dest, string, stringSize);
         }
 
-        void write(
-            const std::string&  logFile,
-            const log_level     logLevel,
-            const source_info   sourceInfo,
-            const std::string&  message)
+        // Static strings must outlive every log that uses them, like string literals
+        static inline std::size_t static_string_size()
         {
-            if (should_log(logLevel))
-            {
-                add_log_to_buffer(logFile, logLevel, sourceInfo, message);
-            }
+            return (2 + sizeof(std::uint32_t) + sizeof(const char*));
         }
 
-#if PLUTO_LOGGER_HIDE_SOURCE_INFO
-        inline void write(
-            const std::string&  logFile,
-            const log_level     logLevel,
-            const std::string&  message)
+        static inline char* write_static_string(char* dest, const char* const string, const std::size_t stringSize)
         {
-            write(logFile, logLevel, { "", 0, "" }, message);
+            const auto length{ static_cast<std::uint32_t>(stringSize) };
+
+            *dest++ = static_cast<char>(log_arg_type::static_string);
+            *dest++ = 0;
+            std::memcpy(dest, &length, sizeof(length));
+            std::memcpy(dest + sizeof(length), &string, sizeof(string));
+            return (dest + sizeof(length) + sizeof(string));
         }
-#endif
 
-        void writef(
-            const std::string&  logFile,
-            const log_level     logLevel,
-            const source_info   sourceInfo,
-            const char* const   scheme,
-            ...)
+        // Reads the arg at the cursor and moves the cursor past it. Returns false if there are no more valid args.
+        static bool read(const char*& cursor, const char* const end, log_arg& arg)
         {
-            if (should_log(logLevel))
+            if (end - cursor < 2)
             {
-                std::string message{};
-                bool messageCreated{ false };
-                std::va_list args, argsCopy;
+                return false;
+            }
+
+            arg.type = static_cast<log_arg_type>(cursor[0]);
+            arg.size = static_cast<unsigned char>(cursor[1]);
 
-                va_start(args, scheme);
-                va_copy(argsCopy, args);
+            const auto pValue   { cursor + 2 };
+            const auto available{ static_cast<std::size_t>(end - pValue) };
 
-                try
+            switch (arg.type)
+            {
+                case log_arg_type::boolean:
+                case log_arg_type::character:
                 {
-                    // Create message from scheme and args
-                    auto messageLength{ std::vsnprintf(nullptr, 0, scheme, args) };
-                    if (0 < messageLength)
+                    if (available < 1)
                     {
-                        message.resize(messageLength + 1);
-                        if (std::vsnprintf(&message[0], message.size(), scheme, argsCopy) == messageLength)
-                        {
-                            message.resize(messageLength);
-                            messageCreated = true;
-                        }
+                        return false;
                     }
+
+                    arg.boolean = (*pValue != 0);
+                    arg.character = *pValue;
+                    cursor = pValue + 1;
+                    return true;
                 }
-                catch (...) {}
+                case log_arg_type::signed_integer:
+                case log_arg_type::unsigned_integer:
+                {
+                    if (available < arg.size)
+                    {
+                        return false;
+                    }
 
-                va_end(args);
-                va_end(argsCopy);
+                    switch (arg.size)
+                    {
+                        case 1: { std::int8_t  s; std::uint8_t  u; std::memcpy(&s, pValue, 1); std::memcpy(&u, pValue, 1); arg.signed_integer = s; arg.unsigned_integer = u; break; }
+                        case 2: { std::int16_t s; std::uint16_t u; std::memcpy(&s, pValue, 2); std::memcpy(&u, pValue, 2); arg.signed_integer = s; arg.unsigned_integer = u; break; }
+                        case 4: { std::int32_t s; std::uint32_t u; std::memcpy(&s, pValue, 4); std::memcpy(&u, pValue, 4); arg.signed_integer = s; arg.unsigned_integer = u; break; }
+                        case 8: { std::int64_t s; std::uint64_t u; std::memcpy(&s, pValue, 8); std::memcpy(&u, pValue, 8); arg.signed_integer = s; arg.unsigned_integer = u; break; }
+                        default: return false;
+                    }
 
-                // If message creation failed, use scheme
-                if (!messageCreated)
-                {
-                    message.assign(scheme);
+                    cursor = pValue + arg.size;
+                    return true;
                 }
+                case log_arg_type::floating_point:
+                {
+                    if (available < arg.size)
+                    {
+                        return false;
+                    }
 
-                add_log_to_buffer(logFile, logLevel, sourceInfo, message);
-            }
-        }
-
-#if PLUTO_LOGGER_HIDE_SOURCE_INFO
-        template<class... Args>
-        inline void writef(
-            const std::string&  logFile,
-            const log_level     logLevel,
-            const char* const   scheme,
-            Args&&...           args)
+                    if (arg.size == sizeof(float))
+                    {
+                        float value;
+                        std::memcpy(&value, pValue, sizeof(value));
+                        arg.floating_point = value;
+                    }
+                    else if (arg.size == sizeof(double))
+                    {
+                        double value;
+                        std::memcpy(&value, pValue, sizeof(value));
+                        arg.floating_point = value;
+                    }
+                    else if (arg.size == sizeof(long double))
+                    {
+                        std::memcpy(&arg.floating_point, pValue, sizeof(long double));
+                    }
+                    else
+                    {
+                        return false;
+                    }
+
+                    cursor = pValue + arg.size;
+                    return true;
+                }
+                case log_arg_type::pointer:
+                {
+                    std::uint64_t value;
+                    if (available < sizeof(value))
+                    {
+                        return false;
+                    }
+
+                    std::memcpy(&value, pValue, sizeof(value));
+                    arg.pointer = static_cast<std::uintptr_t>(value);
+                    cursor = pValue + sizeof(value);
+                    return true;
+                }
+                case log_arg_type::string:
+                case log_arg_type::static_string:
+                {
+                    std::uint32_t length;
+                    if (available < sizeof(length))
+                    {
+                        return false;
+                    }
+
+                    std::memcpy(&length, pValue, sizeof(length));
+                    arg.string_size = length;
+
+                    if (arg.type == log_arg_type::string)
+                    {
+                        if (available - sizeof(length) < length)
+                        {
+                            return false;
+                        }
+
+                        arg.string = pValue + sizeof(length);
+                        cursor = arg.string + length;
+                    }
+                    else
+                    {
+                        if (available - sizeof(length) < sizeof(arg.string))
+                        {
+                            return false;
+                        }
+
+                        std::memcpy(&arg.string, pValue + sizeof(length), sizeof(arg.string));
+                        cursor = pValue + sizeof(length) + sizeof(arg.string);
+                    }
+
+                    return true;
+                }
+                default:
+                {
+                    return false;
+                }
+            }
+        }
+
+        // Renders a message from a printf style scheme, with the same rules as std::snprintf
+        static void render_printf(std::string& message, const char* const args, const std::size_t size)
         {
-            writef(logFile, logLevel, { "", 0, "" }, scheme, std::forward<Args>(args)...);
+            const char* cursor  { args };
+            const char* end     { args + size };
+
+            log_arg schemeArg{};
+            if (!read(cursor, end, schemeArg) || !schemeArg.is_string())
+            {
+                return;
+            }
+
+            std::string spec{};
+            std::string length{};
+            log_arg arg{};
+
+            const char* pScheme     { schemeArg.string };
+            const char* schemeEnd   { schemeArg.string + schemeArg.string_size };
+
+            while (pScheme != schemeEnd)
+            {
+                if (*pScheme != '%')
+                {
+                    const auto pNext{ std::find(pScheme, schemeEnd, '%') };
+                    message.append(pScheme, pNext);
+                    pScheme = pNext;
+                    continue;
+                }
+
+                const char* pStart{ pScheme++ };
+
+                if (pScheme != schemeEnd && *pScheme == '%')
+                {
+                    message.push_back('%');
+                    ++pScheme;
+                    continue;
+                }
+
+                spec.assign(1, '%');
+                length.clear();
+
+                int precision{ -1 };
+                bool isValid{ true };
+
+                // Flags
+                while (pScheme != schemeEnd && (*pScheme == '-' || *pScheme == '+' || *pScheme == ' ' || *pScheme == '#' || *pScheme == '0'))
+                {
+                    spec.push_back(*pScheme++);
+                }
+
+                // Width
+                if (pScheme != schemeEnd && *pScheme == '*')
+                {
+                    ++pScheme;
+                    isValid = read(cursor, end, arg);
+                    spec.append(std::to_string(arg.to_signed()));
+                }
+                else
+                {
+                    while (pScheme != schemeEnd && std::isdigit(static_cast<unsigned char>(*pScheme)))
+                    {
+                        spec.push_back(*pScheme++);
+                    }
+                }
+
+                // Precision
+                if (pScheme != schemeEnd && *pScheme == '.')
+                {
+                    ++pScheme;
+                    precision = 0;
+
+                    if (pScheme != schemeEnd && *pScheme == '*')
+                    {
+                        ++pScheme;
+                        isValid = (isValid && read(cursor, end, arg));
+                        precision = static_cast<int>(arg.to_signed()); // Negative is taken as if omitted
+                    }
+                    else
+                    {
+                        while (pScheme != schemeEnd && std::isdigit(static_cast<unsigned char>(*pScheme)))
+                        {
+                            precision = (precision * 10) + (*pScheme++ - '0');
+                        }
+                    }
+                }
+
+                // Length
+                while (pScheme != schemeEnd &&
+                    (*pScheme == 'h' || *pScheme == 'l' || *pScheme == 'j' || *pScheme == 'z' || *pScheme == 't' || *pScheme == 'L' || *pScheme == 'q'))
+                {
+                    length.push_back(*pScheme++);
+                }
+
+                if (pScheme == schemeEnd || !isValid)
+                {
+                    message.append(pStart, pScheme);
+                    continue;
+                }
+
+                const auto conversion{ *pScheme++ };
+
+                // Strings aren't null terminated, so their length is always passed as the precision
+                if (conversion == 's')
+                {
+                    if (!read(cursor, end, arg))
+                    {
+                        message.append(pStart, pScheme);
+                    }
+                    else if (arg.is_string())
+                    {
+                        const auto stringSize{ static_cast<int>(arg.string_size) };
+                        spec.append(".*s");
+                        append_printf(message, spec, ((0 <= precision && precision < stringSize) ? precision : stringSize), arg.string);
+                    }
+                    else
+                    {
+                        append_text(message, arg);
+                    }
+
+                    continue;
+                }
+
+                if (0 <= precision)
+                {
+                    spec.push_back('.');
+                    spec.append(std::to_string(precision));
+                }
+
+                spec.append(length);
+                spec.push_back(conversion);
+
+                const bool isConversion{ (conversion != '\0') && (std::strchr("diuoxXcpfFeEgGaAn", conversion) != nullptr) };
+                if (!isConversion || !read(cursor, end, arg))
+                {
+                    message.append(pStart, pScheme);
+                    continue;
+                }
+
+                switch (conversion)
+                {
+                    case 'd': case 'i':
+                        append_printf_signed(message, spec, length, arg.to_signed());
+                        break;
+                    case 'u': case 'o': case 'x': case 'X':
+                        append_printf_unsigned(message, spec, length, arg.to_unsigned());
+                        break;
+                    case 'c':
+                        append_printf(message, spec, static_cast<int>(arg.to_signed()));
+                        break;
+                    case 'p':
+                        append_printf(message, spec, reinterpret_cast<const void*>(static_cast<std::uintptr_t>(arg.to_unsigned())));
+                        break;
+                    case 'n':
+                        break; // Nothing is written back
+                    default:
+                        if (length == "L")  append_printf(message, spec, arg.to_floating());
+                        else                append_printf(message, spec, static_cast<double>(arg.to_floating()));
+                        break;
+                }
+            }
         }
-#endif
+
+        // Renders a message from a std::format style scheme. Without std::format, format specs are ignored.
+        static void render_format(std::string& message, const char* const args, const std::size_t size)
+        {
+            const char* cursor  { args };
+            const char* end     { args + size };
+
+            log_arg schemeArg{};
+            if (!read(cursor, end, schemeArg) || !schemeArg.is_string())
+            {
+                return;
+            }
+
+            thread_local std::vector<log_arg> values{};
+            values.clear();
+
+            log_arg arg{};
+            while (read(cursor, end, arg))
+            {
+                values.push_back(arg);
+            }
+
+            std::string spec{};
+            std::size_t nextIndex{ 0 };
+
+            const auto get_index = [&nextIndex](const char*& pScheme, const char* const schemeEnd)
+            {
+                if (pScheme == schemeEnd || !std::isdigit(static_cast<unsigned char>(*pScheme)))
+                {
+                    return nextIndex++;
+                }
+
+                std::size_t index{ 0 };
+                while (pScheme != schemeEnd && std::isdigit(static_cast<unsigned char>(*pScheme)))
+                {
+                    index = (index * 10) + static_cast<std::size_t>(*pScheme++ - '0');
+                }
+
+                return index;
+            };
+
+            const char* pScheme     { schemeArg.string };
+            const char* schemeEnd   { schemeArg.string + schemeArg.string_size };
+
+            while (pScheme != schemeEnd)
+            {
+                const auto c{ *pScheme++ };
+
+                if ((c == '{' || c == '}') && pScheme != schemeEnd && *pScheme == c)
+                {
+                    message.push_back(c);
+                    ++pScheme;
+                    continue;
+                }
+
+                if (c != '{')
+                {
+                    message.push_back(c);
+                    continue;
+                }
+
+                const char* pStart{ pScheme - 1 };
+                const auto index{ get_index(pScheme, schemeEnd) };
+
+                spec.assign("{:");
+                if (pScheme != schemeEnd && *pScheme == ':')
+                {
+                    ++pScheme;
+
+                    // Nested replacement fields (dynamic width and precision) are replaced with their values
+                    while (pScheme != schemeEnd && *pScheme != '}')
+                    {
+                        if (*pScheme == '{')
+                        {
+                            ++pScheme;
+                            const auto nestedIndex{ get_index(pScheme, schemeEnd) };
+                            if (nestedIndex < values.size())
+                            {
+                                spec.append(std::to_string(values[nestedIndex].to_signed()));
+                            }
+
+                            if (pScheme != schemeEnd)
+                            {
+                                ++pScheme; // Closing brace
+                            }
+                        }
+                        else
+                        {
+                            spec.push_back(*pScheme++);
+                        }
+                    }
+                }
+
+                if (pScheme == schemeEnd || values.size() <= index)
+                {
+                    message.append(pStart, pScheme);
+                    continue;
+                }
+
+                ++pScheme; // Closing brace
+                spec.push_back('}');
 
 #if PLUTO_UTILS_HAS_FORMAT
-        template<class... Args>
-        void format(
-            const std::string&                  logFile,
-            const log_level                     logLevel,
-            const source_info                   sourceInfo,
-            const std::format_string<Args...>   scheme,
-            Args&&...                           args)
+                append_format(message, spec, values[index]);
+#else
+                append_text(message, values[index]);
+#endif
+            }
+        }
+
+        // Renders a message and the keys and values after it as logfmt, like msg="message" key=value
+        static void render_logfmt(std::string& message, const char* const args, const std::size_t size)
         {
-            if (should_log(logLevel))
+            const char* cursor  { args };
+            const char* end     { args + size };
+
+            log_arg key{};
+            if (!read(cursor, end, key) || !key.is_string())
+            {
+                return;
+            }
+
+            message.append("msg=");
+            append_logfmt_string(message, key.string, key.string_size);
+
+            log_arg value{};
+            while (read(cursor, end, key) && key.is_string() && read(cursor, end, value))
             {
-                auto message{ std::vformat(scheme.get(), std::make_format_args(args...)) };
-                add_log_to_buffer(logFile, logLevel, sourceInfo, message);
+                message.push_back(' ');
+                message.append(key.string, key.string_size);
+                message.push_back('=');
+                append_logfmt_value(message, value);
             }
         }
 
-#if PLUTO_LOGGER_HIDE_SOURCE_INFO
-        template<class... Args>
-        inline void format(
-            const std::string&                  logFile,
-            const log_level                     logLevel,
-            const std::format_string<Args...>   scheme,
-            Args&&...                           args)
+        // Renders a message and the keys and values after it as a JSON object, like {"msg":"message","key":value}
+        static void render_json(std::string& message, const char* const args, const std::size_t size)
         {
-            format(logFile, logLevel, { "", 0, "" }, scheme, std::forward<Args>(args)...);
+            const char* cursor  { args };
+            const char* end     { args + size };
+
+            log_arg key{};
+            if (!read(cursor, end, key) || !key.is_string())
+            {
+                return;
+            }
+
+            message.append("{\"msg\":");
+            append_json_string(message, key.string, key.string_size);
+
+            log_arg value{};
+            while (read(cursor, end, key) && key.is_string() && read(cursor, end, value))
+            {
+                message.push_back(',');
+                append_json_string(message, key.string, key.string_size);
+                message.push_back(':');
+                append_json_value(message, value);
+            }
+
+            message.push_back('}');
         }
-#endif
-#endif
+    };
 
-        PLUTO_UTILS_NODISCARD inline streamer stream(
-            const std::string&  logFile,
-            const log_level     logLevel,
-#if PLUTO_LOGGER_HIDE_SOURCE_INFO
-            const source_info   sourceInfo = { "", 0, "" })
-#else
-            const source_info   sourceInfo)
-#endif
+    template<class Value>
+    struct log_args::traits<Value, typename std::enable_if<std::is_same<Value, bool>::value>::type>
+    {
+        static constexpr bool is_deferrable{ true };
+
+        static inline std::size_t size(const bool)
         {
-            return { this, logFile, logLevel, sourceInfo };
+            return 3;
         }
 
-    private:
-        void add_log_to_buffer(
-            const std::string&  logFile,
-            const log_level     logLevel,
-            const source_info   sourceInfo,
-            const std::string&  message)
+        static inline char* write(char* dest, const bool value)
         {
-            const auto logTime  { clock_type::now() };
-            const auto threadID { pluto::thread_id() };
+            *dest++ = static_cast<char>(log_arg_type::boolean);
+            *dest++ = 1;
+            *dest++ = static_cast<char>(value);
+            return dest;
+        }
+    };
 
-            std::unique_lock<std::mutex> lock{ m_loggingMutex };
+    template<class Value>
+    struct log_args::traits<Value, typename std::enable_if<std::is_same<Value, char>::value>::type>
+    {
+        static constexpr bool is_deferrable{ true };
+
+        static inline std::size_t size(const char)
+        {
+            return 3;
+        }
+
+        static inline char* write(char* dest, const char value)
+        {
+            *dest++ = static_cast<char>(log_arg_type::character);
+            *dest++ = 1;
+            *dest++ = value;
+            return dest;
+        }
+    };
+
+    template<class Value>
+    struct log_args::traits<Value, typename std::enable_if<std::is_integral<Value>::value &&
+        !std::is_same<Value, bool>::value && !std::is_same<Value, char>::value && sizeof(Value) <= 8 &&
+        (std::is_same<Value, signed char>::value || std::is_same<Value, unsigned char>::value || 1 < sizeof(Value)) &&
+        !std::is_same<Value, wchar_t>::value && !std::is_same<Value, char16_t>::value && !std::is_same<Value, char32_t>::value>::type> :
+        number_traits<Value>
+    {
+        static inline char* write(char* dest, const Value value)
+        {
+            return number_traits<Value>::write(dest, value,
+                (std::is_signed<Value>::value ? log_arg_type::signed_integer : log_arg_type::unsigned_integer));
+        }
+    };
+
+    template<class Value>
+    struct log_args::traits<Value, typename std::enable_if<std::is_floating_point<Value>::value>::type> :
+        number_traits<Value>
+    {
+        static inline char* write(char* dest, const Value value)
+        {
+            return number_traits<Value>::write(dest, value, log_arg_type::floating_point);
+        }
+    };
+
+    template<class Value>
+    struct log_args::traits<Value, typename std::enable_if<std::is_same<Value, const char*>::value || std::is_same<Value, char*>::value>::type> :
+        string_traits
+    {
+        static inline std::size_t size(const char* const value)
+        {
+            return string_traits::size(value, (value ? std::strlen(value) : 6));
+        }
+
+        static inline char* write(char* dest, const char* const value)
+        {
+            return (value ? string_traits::write(dest, value, std::strlen(value)) : string_traits::write(dest, "(null)", 6));
+        }
+    };
+
+    template<class Value>
+    struct log_args::traits<Value, typename std::enable_if<std::is_same<Value, std::string>::value>::type> :
+        string_traits
+    {
+        static inline std::size_t size(const std::string& value)
+        {
+            return string_traits::size(value.data(), value.size());
+        }
+
+        static inline char* write(char* dest, const std::string& value)
+        {
+            return string_traits::write(dest, value.data(), value.size());
+        }
+    };
+
+#if PLUTO_UTILS_HAS_CXX_17
+    template<class Value>
+    struct log_args::traits<Value, typename std::enable_if<std::is_same<Value, std::string_view>::value>::type> :
+        string_traits
+    {
+        static inline std::size_t size(const std::string_view value)
+        {
+            return string_traits::size(value.data(), value.size());
+        }
+
+        static inline char* write(char* dest, const std::string_view value)
+        {
+            return string_traits::write(dest, value.data(), value.size());
+        }
+    };
+#endif
+
+    template<class Value>
+    struct log_args::traits<Value, typename std::enable_if<(std::is_pointer<Value>::value &&
+        !std::is_function<typename std::remove_pointer<Value>::type>::value &&
+        !std::is_same<Value, const char*>::value && !std::is_same<Value, char*>::value && !log_args::is_wide_c_string<Value>::value) ||
+        std::is_same<Value, std::nullptr_t>::value>::type>
+    {
+        static constexpr bool is_deferrable{ true };
+
+        static inline std::size_t size(const Value&)
+        {
+            return (2 + sizeof(std::uint64_t));
+        }
+
+        static inline char* write(char* dest, const Value& value)
+        {
+            const auto address{ static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(static_cast<const volatile void*>(value))) };
+
+            *dest++ = static_cast<char>(log_arg_type::pointer);
+            *dest++ = static_cast<char>(sizeof(address));
+            std::memcpy(dest, &address, sizeof(address));
+            return (dest + sizeof(address));
+        }
+    };
+
+    template<class Value>
+    struct log_args::traits<Value, typename std::enable_if<std::is_same<Value, log_args::printf_string>::value>::type> :
+        string_traits
+    {
+        static inline std::size_t size(const printf_string& value)
+        {
+            return (value.isPointer ? traits<const void*>::size(value.string) : string_traits::size(value.string, value.size));
+        }
+
+        static inline char* write(char* dest, const printf_string& value)
+        {
+            return (value.isPointer ? traits<const void*>::write(dest, value.string) : string_traits::write(dest, value.string, value.size));
+        }
+    };
+
+    // Keys are static strings, so they aren't copied
+    template<class Value>
+    struct log_args::traits<log_field<Value>, void>
+    {
+        static constexpr bool is_deferrable{ traits<arg_type<Value>>::is_deferrable };
+
+        static inline std::size_t size(const log_field<Value>& field)
+        {
+            return (static_string_size() + size_of(field.value));
+        }
+
+        static inline char* write(char* dest, const log_field<Value>& field)
+        {
+            dest = write_static_string(dest, field.key, std::strlen(field.key));
+            return write_one(dest, field.value);
+        }
+    };
+
+    class logger
+    {
+    public:
+        typedef PLUTO_LOGGER_CLOCK_TYPE clock_type;
+
+    private:
+        friend class log_site;
+
+        struct log_file;
+
+    public:
+        // Refers to a log file of a logger, so logs can skip looking up the file by name.
+        // Only valid for the lifetime of the logger that opened it.
+        class file_handle
+        {
+            friend class logger;
+
+            log_file* m_logFile;
+
+            explicit file_handle(log_file* const logFile) :
+                m_logFile{ logFile } {}
+
+        public:
+            file_handle() :
+                m_logFile{ nullptr } {}
+
+            PLUTO_UTILS_NODISCARD inline bool is_open() const
+            {
+                return (m_logFile != nullptr);
+            }
+
+            PLUTO_UTILS_NODISCARD explicit inline operator bool() const
+            {
+                return is_open();
+            }
+        };
+
+    private:
+        // Streams into an inline buffer, so typical logs don't allocate. Numbers, characters and strings are appended directly.
+        // Anything else, and anything after it like a value after std::hex, goes through a stream that's created if needed.
+        class streamer
+        {
+            logger*                             m_logger;
+            log_file* const                     m_logFile;
+            const log_level                     m_logLevel;
+            const source_info                   m_sourceInfo;
+            char*                               m_data;     // The inline data, until the message outgrows it
+            std::size_t                         m_size;
+            std::size_t                         m_capacity;
+            std::unique_ptr<char[]>             m_heapData;
+            std::unique_ptr<std::ostringstream> m_stream;
+            char                                m_inlineData[PLUTO_LOGGER_STREAMER_INLINE_SIZE];
+
+            template<class Value>
+            struct is_number : std::integral_constant<bool,
+                std::is_floating_point<Value>::value ||
+                (std::is_integral<Value>::value &&
+                    !std::is_same<Value, bool>::value &&
+                    !std::is_same<Value, char>::value &&
+                    !std::is_same<Value, signed char>::value &&
+                    !std::is_same<Value, unsigned char>::value &&
+                    !std::is_same<Value, wchar_t>::value &&
+                    !std::is_same<Value, char16_t>::value &&
+                    !std::is_same<Value, char32_t>::value)> {};
+
+        public:
+            streamer(
+                logger*             logger,
+                log_file* const     logFile,
+                const log_level     logLevel,
+                const source_info   sourceInfo) :
+                m_logger    { logger },
+                m_logFile   { logFile },
+                m_logLevel  { logLevel },
+                m_sourceInfo{ sourceInfo },
+                m_data      { m_inlineData },
+                m_size      { 0 },
+                m_capacity  { sizeof(m_inlineData) },
+                m_heapData  {},
+                m_stream    {} {}
+
+            ~streamer()
+            {
+                end();
+            }
+
+            streamer(const streamer&) = delete;
+
+            streamer(streamer&&) = delete;
+
+            streamer& operator=(const streamer&) = delete;
+
+            streamer& operator=(streamer&&) = delete;
+
+            void end()
+            {
+                if (m_logger && m_logFile && m_logger->should_log(m_logLevel))
+                {
+                    const auto data{ m_data };
+                    const auto size{ m_size };
+
+                    m_logger->add_log_to_buffer(*m_logFile, m_logLevel, m_sourceInfo, nullptr, size,
+                        [data, size](char* const dest) { std::memcpy(dest, data, size); });
+
+                    m_logger = nullptr;
+                }
+            }
+
+            template<class Value>
+            inline streamer& operator<<(const Value& value)
+            {
+                if (m_stream)
+                {
+                    stream_value(value);
+                }
+                else
+                {
+                    append_value(value);
+                }
+
+                return *this;
+            }
+
+        private:
+            void reserve(const std::size_t size)
+            {
+                if (m_capacity - m_size < size)
+                {
+                    const auto capacity{ (std::max)((2 * m_capacity), (m_size + size)) };
+
+                    std::unique_ptr<char[]> data{ new char[capacity] };
+                    std::memcpy(data.get(), m_data, m_size);
+
+                    m_heapData = std::move(data);
+                    m_data = m_heapData.get();
+                    m_capacity = capacity;
+                }
+            }
+
+            void append(const char* const data, const std::size_t size)
+            {
+                reserve(size);
+                std::memcpy((m_data + m_size), data, size);
+                m_size += size;
+            }
+
+            // Only what the value adds is appended, and the stream keeps its flags for the values after it
+            template<class Value>
+            void stream_value(const Value& value)
+            {
+                if (!m_stream)
+                {
+                    m_stream.reset(new std::ostringstream{});
+                }
+
+                m_stream->str(std::string{});
+                *m_stream << value;
+
+                const auto text{ m_stream->str() };
+                append(text.data(), text.size());
+            }
+
+            inline void append_value(const char* const text)
+            {
+                if (text)
+                {
+                    append(text, std::strlen(text));
+                }
+            }
+
+            inline void append_value(const std::string& text)
+            {
+                append(text.data(), text.size());
+            }
+
+#if PLUTO_UTILS_HAS_CXX_17
+            inline void append_value(const std::string_view text)
+            {
+                append(text.data(), text.size());
+            }
+#endif
+
+            inline void append_value(const char character)
+            {
+                append(&character, 1);
+            }
+
+            inline void append_value(const signed char character)
+            {
+                append_value(static_cast<char>(character));
+            }
+
+            inline void append_value(const unsigned char character)
+            {
+                append_value(static_cast<char>(character));
+            }
+
+            inline void append_value(const bool value)
+            {
+                append_value(value ? '1' : '0');
+            }
+
+            template<class Value>
+            inline void append_value(const Value& value)
+            {
+                append_number(value, is_number<Value>{});
+            }
+
+            template<class Value>
+            inline void append_number(const Value& value, std::false_type)
+            {
+                stream_value(value);
+            }
+
+            // Formatted like a stream with default flags would, so switching to the stream doesn't change the output
+            template<class Value>
+            void append_number(const Value value, std::true_type)
+            {
+                reserve(64);
+
+                const auto first{ m_data + m_size };
+                m_size += static_cast<std::size_t>(
+                    write_number(first, (m_data + m_capacity), value, std::is_floating_point<Value>{}, std::is_signed<Value>{}) - first);
+            }
+
+#if PLUTO_UTILS_HAS_TO_CHARS
+            template<class Value, class IsSigned>
+            static inline char* write_number(char* const first, char* const last, const Value value, std::false_type, IsSigned)
+            {
+                return std::to_chars(first, last, value).ptr;
+            }
+
+            template<class Value, class IsSigned>
+            static inline char* write_number(char* const first, char* const last, const Value value, std::true_type, IsSigned)
+            {
+                return std::to_chars(first, last, value, std::chars_format::general, 6).ptr;
+            }
+#else
+            template<class Value>
+            static char* write_number(char* first, char* const last, const Value value, std::false_type, std::true_type)
+            {
+                typedef typename std::make_unsigned<Value>::type unsigned_type;
+
+                if (value < 0)
+                {
+                    *first++ = '-';
+                    return write_number(first, last, static_cast<unsigned_type>(unsigned_type{ 0 } - static_cast<unsigned_type>(value)), std::false_type{}, std::false_type{});
+                }
+
+                return write_number(first, last, static_cast<unsigned_type>(value), std::false_type{}, std::false_type{});
+            }
+
+            template<class Value>
+            static char* write_number(char* const first, char* const, Value value, std::false_type, std::false_type)
+            {
+                char digits[24]{};
+
+                auto end{ digits + sizeof(digits) };
+                auto begin{ end };
+                do
+                {
+                    *--begin = static_cast<char>('0' + (value % 10));
+                    value /= 10;
+                }
+                while (value != 0);
+
+                std::memcpy(first, begin, static_cast<std::size_t>(end - begin));
+                return (first + (end - begin));
+            }
+
+            template<class Value, class IsSigned>
+            static inline char* write_number(char* const first, char* const last, const Value value, std::true_type, IsSigned)
+            {
+                const auto size{ std::snprintf(first, static_cast<std::size_t>(last - first), "%g", static_cast<double>(value)) };
+                return (first + ((0 < size) ? size : 0));
+            }
+
+            template<class IsSigned>
+            static inline char* write_number(char* const first, char* const last, const long double value, std::true_type, IsSigned)
+            {
+                const auto size{ std::snprintf(first, static_cast<std::size_t>(last - first), "%Lg", value) };
+                return (first + ((0 < size) ? size : 0));
+            }
+#endif
+        };
+
+        // Logs are stored back to back in large blocks, with each message stored inline after its header.
+        // Clearing keeps the blocks that were used, so buffers that are swapped back and forth stop allocating.
+        class log_buffer
+        {
+        public:
+            struct header
+            {
+                log_entry::time_type    time;
+                std::size_t             threadID;
+                source_info             source;
+                log_renderer            renderer;       // Renders the message from args if not null
+                std::size_t             messageSize;
+                log_level               level;
+                std::uint64_t           staged;         // Sequence of the log in the staging file, 0 if it wasn't staged
+
+                PLUTO_UTILS_NODISCARD inline const char* message() const
+                {
+                    return reinterpret_cast<const char*>(this + 1);
+                }
+            };
+
+        private:
+            struct block
+            {
+                std::unique_ptr<char[]> data;
+                std::size_t             capacity;
+                std::size_t             used;
+            };
+
+            std::vector<block>  m_blocks        {};
+            std::size_t         m_blockIndex    { 0 };
+            std::size_t         m_frontOffset   { 0 };  // Offset of the oldest log in the first block
+            std::size_t         m_size          { 0 };
+
+            static inline std::size_t record_size(const std::size_t messageSize)
+            {
+                const auto size{ sizeof(header) + messageSize };
+                return (size + alignof(header) - 1) / alignof(header) * alignof(header);
+            }
+
+        public:
+            PLUTO_UTILS_NODISCARD inline std::size_t size() const
+            {
+                return m_size;
+            }
+
+            PLUTO_UTILS_NODISCARD inline bool empty() const
+            {
+                return (m_size == 0);
+            }
+
+            template<class MessageWriter>
+            header& push_back(
+                const log_entry::time_type  logTime,
+                const std::size_t           threadID,
+                const log_level             logLevel,
+                const source_info           sourceInfo,
+                const log_renderer          renderer,
+                const std::size_t           messageSize,
+                MessageWriter&&             writeMessage)
+            {
+                const auto recordSize{ record_size(messageSize) };
+
+                if (m_blockIndex < m_blocks.size() &&
+                    m_blocks[m_blockIndex].capacity - m_blocks[m_blockIndex].used < recordSize)
+                {
+                    ++m_blockIndex;
+                }
+
+                if (m_blockIndex == m_blocks.size() || m_blocks[m_blockIndex].capacity < recordSize)
+                {
+                    // Logs bigger than a block get a block of their own
+                    const auto capacity{ (PLUTO_LOGGER_BUFFER_BLOCK_SIZE < recordSize) ? recordSize : PLUTO_LOGGER_BUFFER_BLOCK_SIZE };
+                    m_blocks.insert(m_blocks.begin() + m_blockIndex, block{ std::unique_ptr<char[]>{ new char[capacity] }, capacity, 0 });
+                }
+
+                auto& thisBlock{ m_blocks[m_blockIndex] };
+                auto  pHeader  { new (thisBlock.data.get() + thisBlock.used) header{ logTime, threadID, sourceInfo, renderer, messageSize, logLevel, 0 } };
+
+                writeMessage(reinterpret_cast<char*>(pHeader + 1));
+                thisBlock.used += recordSize;
+                ++m_size;
+                return *pHeader;
+            }
+
+            // Removes the oldest log
+            void pop_front()
+            {
+                recycle_front_blocks();
+
+                if (m_size != 0)
+                {
+                    const auto& thisHeader{ *reinterpret_cast<const header*>(m_blocks.front().data.get() + m_frontOffset) };
+                    m_frontOffset += record_size(thisHeader.messageSize);
+                    --m_size;
+
+                    recycle_front_blocks();
+                }
+            }
+
+            template<class Function>
+            void for_each(Function&& function) const
+            {
+                for (std::size_t i{ 0 }; i < m_blocks.size(); ++i)
+                {
+                    const auto& thisBlock{ m_blocks[i] };
+
+                    for (std::size_t offset{ (i == 0) ? m_frontOffset : 0 }; offset < thisBlock.used; )
+                    {
+                        const auto& thisHeader{ *reinterpret_cast<const header*>(thisBlock.data.get() + offset) };
+                        function(thisHeader);
+                        offset += record_size(thisHeader.messageSize);
+                    }
+                }
+            }
+
+            void clear()
+            {
+                // Blocks that weren't used since the last clear are freed
+                if (m_blockIndex + 1 < m_blocks.size())
+                {
+                    m_blocks.erase(m_blocks.begin() + m_blockIndex + 1, m_blocks.end());
+                }
+
+                for (auto& thisBlock : m_blocks)
+                {
+                    thisBlock.used = 0;
+                }
+
+                m_blockIndex = 0;
+                m_frontOffset = 0;
+                m_size = 0;
+            }
+
+            inline void swap(log_buffer& other)
+            {
+                std::swap(m_blocks, other.m_blocks);
+                std::swap(m_blockIndex, other.m_blockIndex);
+                std::swap(m_frontOffset, other.m_frontOffset);
+                std::swap(m_size, other.m_size);
+            }
+
+        private:
+            // Blocks emptied by removing logs are moved to the back, so they're reused before new blocks are allocated
+            void recycle_front_blocks()
+            {
+                while (0 < m_blockIndex && m_frontOffset == m_blocks.front().used)
+                {
+                    auto thisBlock{ std::move(m_blocks.front()) };
+                    thisBlock.used = 0;
+
+                    m_blocks.erase(m_blocks.begin());
+                    m_blocks.push_back(std::move(thisBlock));
+                    --m_blockIndex;
+                    m_frontOffset = 0;
+                }
+
+                if (m_size == 0 && !m_blocks.empty())
+                {
+                    m_blocks.front().used = 0;
+                    m_frontOffset = 0;
+                }
+            }
+        };
+
+        // Writes straight to the operating system, without a stream buffer, so each write is one system call.
+        // If there's a mapping size, writes are copied into a mapped region of the file instead, and it's truncated to what was written when closed.
+        class native_file
+        {
+#ifdef _WIN32
+            HANDLE      m_handle        { INVALID_HANDLE_VALUE };
+            HANDLE      m_mappingHandle { nullptr };
+#else
+            int         m_handle        { -1 };
+#endif
+            char*       m_mapping       { nullptr };
+            std::size_t m_mappingSize   { 0 };  // Least amount of room mapped at a time, 0 means writes are system calls
+            std::size_t m_mappingOffset { 0 };  // Where the mapped region starts in the file
+            std::size_t m_mappingLength { 0 };
+            std::size_t m_end           { 0 };  // End of what was written, when there's a mapping size
+
+        public:
+            native_file() = default;
+
+            ~native_file()
+            {
+                close();
+            }
+
+            native_file(const native_file&) = delete;
+
+            native_file(native_file&& other) noexcept
+            {
+                swap(other);
+            }
+
+            native_file& operator=(const native_file&) = delete;
+
+            native_file& operator=(native_file&& other) noexcept
+            {
+                swap(other);
+                return *this;
+            }
+
+            PLUTO_UTILS_NODISCARD inline bool is_open() const
+            {
+#ifdef _WIN32
+                return (m_handle != INVALID_HANDLE_VALUE);
+#else
+                return (m_handle != -1);
+#endif
+            }
+
+            PLUTO_UTILS_NODISCARD inline std::size_t mapping_size() const
+            {
+                return m_mappingSize;
+            }
+
+            // Returns the size of the mapped region after what was written, which is part of the file until it's closed
+            PLUTO_UTILS_NODISCARD inline std::size_t reserved_size() const
+            {
+                return (m_mapping ? (m_mappingOffset + m_mappingLength - m_end) : 0);
+            }
+
+            // Opens the file for appending, creating it if needed. Returns false on failure.
+            bool open(const pluto::filesystem::path& filePath, const std::size_t mappingSize = 0)
+            {
+                close();
+
+#ifdef _WIN32
+                // Mapping needs read and write access, rather than append access.
+                // Other processes can read, rotate or remove the file while it's open.
+                m_handle = ::CreateFileW(filePath.wstring().c_str(),
+                    ((mappingSize == 0) ? (FILE_APPEND_DATA | FILE_READ_ATTRIBUTES) : (GENERIC_READ | GENERIC_WRITE)),
+                    (FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE), nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+#else
+                const auto flags{ (mappingSize == 0) ? (O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC) : (O_RDWR | O_CREAT | O_CLOEXEC) };
+
+                do
+                {
+                    m_handle = ::open(filePath.c_str(), flags, 0644);
+                }
+                while (m_handle == -1 && errno == EINTR);
+#endif
+
+                if (is_open() && mappingSize != 0)
+                {
+                    m_mappingSize = mappingSize;
+                    m_end = written_size();
+
+                    // Cut off what a crash left of the last region, so new logs follow the ones already written
+                    if (m_end != disk_size())
+                    {
+                        truncate_to_end();
+                    }
+                }
+
+                return is_open();
+            }
+
+            void close()
+            {
+                if (is_open())
+                {
+                    if (m_mappingSize != 0)
+                    {
+                        // Cut off the part of the last region that wasn't written to
+                        unmap_region();
+                        truncate_to_end();
+                        m_mappingSize = 0;
+                        m_end = 0;
+                    }
+
+#ifdef _WIN32
+                    ::CloseHandle(m_handle);
+                    m_handle = INVALID_HANDLE_VALUE;
+#else
+                    ::close(m_handle);
+                    m_handle = -1;
+#endif
+                }
+            }
+
+            // Returns the size of the open file, or 0 if it can't be found
+            PLUTO_UTILS_NODISCARD std::size_t size() const
+            {
+                return ((m_mappingSize != 0) ? m_end : disk_size());
+            }
+
+            // Returns when the open file was last written to, or 0 if it can't be found
+            PLUTO_UTILS_NODISCARD std::time_t modified_time() const
+            {
+#ifdef _WIN32
+                FILETIME writeTime{};
+                if (!::GetFileTime(m_handle, nullptr, nullptr, &writeTime))
+                {
+                    return 0;
+                }
+
+                // File times count 100 nanosecond intervals from 1601, rather than seconds from 1970
+                const auto fileTime{ (static_cast<std::uint64_t>(writeTime.dwHighDateTime) << 32) | writeTime.dwLowDateTime };
+                return static_cast<std::time_t>((fileTime - 116444736000000000ULL) / 10000000ULL);
+#else
+                struct stat fileStat{};
+                return ((::fstat(m_handle, &fileStat) == 0) ? fileStat.st_mtime : 0);
+#endif
+            }
+
+            // Returns true if the open file is still at this path and has this size, so nothing moved, removed or wrote to it
+            PLUTO_UTILS_NODISCARD bool is_same_file(const pluto::filesystem::path& filePath, const std::size_t expectedSize) const
+            {
+#ifdef _WIN32
+                BY_HANDLE_FILE_INFORMATION fileInfo{};
+                if (!::GetFileInformationByHandle(m_handle, &fileInfo) || fileInfo.nNumberOfLinks == 0 ||
+                    ((static_cast<std::uint64_t>(fileInfo.nFileSizeHigh) << 32) | fileInfo.nFileSizeLow) != expectedSize)
+                {
+                    return false;
+                }
+
+                std::error_code error{};
+                return (pluto::filesystem::file_size(filePath, error) == expectedSize && !error);
+#else
+                struct stat fileStat{};
+                struct stat pathStat{};
+                return (::fstat(m_handle, &fileStat) == 0 && fileStat.st_nlink != 0 && static_cast<std::size_t>(fileStat.st_size) == expectedSize &&
+                    ::stat(filePath.c_str(), &pathStat) == 0 && pathStat.st_dev == fileStat.st_dev && pathStat.st_ino == fileStat.st_ino);
+#endif
+            }
+
+            // Writes all of the data, retrying partial writes. Returns the number of bytes written, which is less on failure.
+            std::size_t write(const char* data, std::size_t size)
+            {
+                if (m_mappingSize != 0)
+                {
+                    return write_mapped(data, size);
+                }
+
+                const auto dataStart{ data };
+
+                while (size != 0)
+                {
+#ifdef _WIN32
+                    const auto chunkSize{ static_cast<DWORD>((std::min)(size, static_cast<std::size_t>(0x40000000))) };
+
+                    DWORD numWritten{ 0 };
+                    if (!::WriteFile(m_handle, data, chunkSize, &numWritten, nullptr))
+                    {
+                        return static_cast<std::size_t>(data - dataStart);
+                    }
+#else
+                    const auto numWritten{ ::write(m_handle, data, size) };
+                    if (numWritten < 0)
+                    {
+                        if (errno == EINTR)
+                        {
+                            continue;
+                        }
+
+                        return static_cast<std::size_t>(data - dataStart);
+                    }
+#endif
+
+                    data += numWritten;
+                    size -= static_cast<std::size_t>(numWritten);
+                }
+
+                return static_cast<std::size_t>(data - dataStart);
+            }
+
+            // Waits for written data to reach the disk. Returns false on failure.
+            bool sync()
+            {
+                if (m_mapping)
+                {
+#ifdef _WIN32
+                    if (!::FlushViewOfFile(m_mapping, 0))
+#else
+                    if (::msync(m_mapping, m_mappingLength, MS_SYNC) != 0)
+#endif
+                    {
+                        return false;
+                    }
+                }
+
+#ifdef _WIN32
+                return (::FlushFileBuffers(m_handle) != 0);
+#elif defined(__APPLE__)
+                return (::fsync(m_handle) == 0);
+#else
+                return (::fdatasync(m_handle) == 0);
+#endif
+            }
+
+        private:
+            void swap(native_file& other) noexcept
+            {
+                std::swap(m_handle, other.m_handle);
+#ifdef _WIN32
+                std::swap(m_mappingHandle, other.m_mappingHandle);
+#endif
+                std::swap(m_mapping, other.m_mapping);
+                std::swap(m_mappingSize, other.m_mappingSize);
+                std::swap(m_mappingOffset, other.m_mappingOffset);
+                std::swap(m_mappingLength, other.m_mappingLength);
+                std::swap(m_end, other.m_end);
+            }
+
+            PLUTO_UTILS_NODISCARD std::size_t disk_size() const
+            {
+#ifdef _WIN32
+                LARGE_INTEGER fileSize{};
+                return (::GetFileSizeEx(m_handle, &fileSize) ? static_cast<std::size_t>(fileSize.QuadPart) : 0);
+#else
+                struct stat fileStat{};
+                return ((::fstat(m_handle, &fileStat) == 0) ? static_cast<std::size_t>(fileStat.st_size) : 0);
+#endif
+            }
+
+            void truncate_to_end()
+            {
+#ifdef _WIN32
+                LARGE_INTEGER end{};
+                end.QuadPart = static_cast<LONGLONG>(m_end);
+                if (::SetFilePointerEx(m_handle, end, nullptr, FILE_BEGIN))
+                {
+                    ::SetEndOfFile(m_handle);
+                }
+#else
+                while (::ftruncate(m_handle, static_cast<off_t>(m_end)) != 0 && errno == EINTR);
+#endif
+            }
+
+            // Reads from an offset in the file, returning how much was read
+            std::size_t read_at(const std::size_t offset, char* const data, const std::size_t size) const
+            {
+                std::size_t numRead{ 0 };
+
+                while (numRead != size)
+                {
+#ifdef _WIN32
+                    const auto position{ static_cast<std::uint64_t>(offset + numRead) };
+                    OVERLAPPED overlapped{};
+                    overlapped.Offset       = static_cast<DWORD>(position & 0xFFFFFFFF);
+                    overlapped.OffsetHigh   = static_cast<DWORD>(position >> 32);
+
+                    DWORD chunkRead{ 0 };
+                    const auto chunkSize{ static_cast<DWORD>((std::min)((size - numRead), static_cast<std::size_t>(0x7FFFFFFF))) };
+                    if (!::ReadFile(m_handle, (data + numRead), chunkSize, &chunkRead, &overlapped) || chunkRead == 0)
+                    {
+                        break;
+                    }
+#else
+                    const auto chunkRead{ ::pread(m_handle, (data + numRead), (size - numRead), static_cast<off_t>(offset + numRead)) };
+                    if (chunkRead <= 0)
+                    {
+                        if (chunkRead == -1 && errno == EINTR)
+                        {
+                            continue;
+                        }
+
+                        break;
+                    }
+#endif
+                    numRead += static_cast<std::size_t>(chunkRead);
+                }
+
+                return numRead;
+            }
+
+            // Returns where what was written to the file ends. If the application crashed while the file was mapped,
+            // the file goes on with zeros up to the end of the last region. Text logs always end with a new line,
+            // so the zeros are whatever follows the last byte that isn't zero. Binary records can end with zeros,
+            // so they're walked from the start until a record has no size.
+            PLUTO_UTILS_NODISCARD std::size_t written_size() const
+            {
+                const auto fileSize{ disk_size() };
+
+                std::vector<char> buffer(65536);
+                auto end{ fileSize };
+
+                while (end != 0)
+                {
+                    const auto chunkSize{ (std::min)(end, buffer.size()) };
+                    if (read_at((end - chunkSize), buffer.data(), chunkSize) != chunkSize)
+                    {
+                        return fileSize;
+                    }
+
+                    const auto it{ std::find_if(buffer.rbegin() + static_cast<std::ptrdiff_t>(buffer.size() - chunkSize), buffer.rend(),
+                        [](const char c) { return (c != '\0'); }) };
+
+                    end -= static_cast<std::size_t>(it - (buffer.rbegin() + static_cast<std::ptrdiff_t>(buffer.size() - chunkSize)));
+                    if (it != buffer.rend())
+                    {
+                        break;
+                    }
+                }
+
+                const std::size_t magicSize{ std::strlen(binary_magic()) };
+                if (end == fileSize || end < magicSize || read_at(0, buffer.data(), magicSize) != magicSize ||
+                    std::memcmp(buffer.data(), binary_magic(), magicSize) != 0)
+                {
+                    return end;
+                }
+
+                auto recordStart{ binary_file_header_size() };
+                std::size_t chunkStart  { 0 };
+                std::size_t chunkSize   { 0 };
+
+                while (recordStart + sizeof(std::uint32_t) <= fileSize)
+                {
+                    // Sizes are read through the buffer, which is refilled from the next record when it runs out
+                    if (recordStart + sizeof(std::uint32_t) > chunkStart + chunkSize)
+                    {
+                        chunkStart = recordStart;
+                        chunkSize = read_at(chunkStart, buffer.data(), (std::min)(buffer.size(), (fileSize - chunkStart)));
+
+                        if (chunkSize < sizeof(std::uint32_t))
+                        {
+                            break;
+                        }
+                    }
+
+                    std::uint32_t recordSize{ 0 };
+                    std::memcpy(&recordSize, (buffer.data() + (recordStart - chunkStart)), sizeof(recordSize));
+
+                    if (recordSize == 0 || recordStart + sizeof(recordSize) + recordSize > fileSize)
+                    {
+                        break;
+                    }
+
+                    recordStart += sizeof(recordSize) + recordSize;
+                }
+
+                // Nothing that isn't zero is cut off, even if the records don't add up
+                return (std::max)(end, recordStart);
+            }
+
+            // Mapped regions have to start at a multiple of this
+            static inline std::size_t mapping_granularity()
+            {
+#ifdef _WIN32
+                SYSTEM_INFO systemInfo{};
+                ::GetSystemInfo(&systemInfo);
+                return static_cast<std::size_t>(systemInfo.dwAllocationGranularity);
+#else
+                return static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+#endif
+            }
+
+            // Maps at least the mapping size after what was written, growing the file to fit it
+            bool map_region()
+            {
+                unmap_region();
+
+                const auto granularity  { mapping_granularity() };
+                const auto offset       { m_end - (m_end % granularity) };
+                const auto length       { (((m_end - offset) + m_mappingSize + granularity - 1) / granularity) * granularity };
+
+#ifdef _WIN32
+                const auto fileEnd{ static_cast<std::uint64_t>(offset) + length };
+                m_mappingHandle = ::CreateFileMappingW(m_handle, nullptr, PAGE_READWRITE,
+                    static_cast<DWORD>(fileEnd >> 32), static_cast<DWORD>(fileEnd & 0xFFFFFFFF), nullptr);
+
+                if (!m_mappingHandle)
+                {
+                    return false;
+                }
+
+                m_mapping = static_cast<char*>(::MapViewOfFile(m_mappingHandle, FILE_MAP_WRITE,
+                    static_cast<DWORD>(static_cast<std::uint64_t>(offset) >> 32), static_cast<DWORD>(offset & 0xFFFFFFFF), length));
+
+                if (!m_mapping)
+                {
+                    ::CloseHandle(m_mappingHandle);
+                    m_mappingHandle = nullptr;
+                    return false;
+                }
+#else
+                // Where it's supported, disk space is allocated up front, so running out fails here rather than with SIGBUS while copying
+#ifdef __APPLE__
+                if (::ftruncate(m_handle, static_cast<off_t>(offset + length)) != 0)
+#else
+                if (::posix_fallocate(m_handle, static_cast<off_t>(offset), static_cast<off_t>(length)) != 0)
+#endif
+                {
+                    return false;
+                }
+
+                const auto mapping{ ::mmap(nullptr, length, (PROT_READ | PROT_WRITE), MAP_SHARED, m_handle, static_cast<off_t>(offset)) };
+                if (mapping == MAP_FAILED)
+                {
+                    return false;
+                }
+
+                m_mapping = static_cast<char*>(mapping);
+#endif
+
+                m_mappingOffset = offset;
+                m_mappingLength = length;
+                return true;
+            }
+
+            void unmap_region()
+            {
+                if (m_mapping)
+                {
+#ifdef _WIN32
+                    ::UnmapViewOfFile(m_mapping);
+                    ::CloseHandle(m_mappingHandle);
+                    m_mappingHandle = nullptr;
+#else
+                    ::munmap(m_mapping, m_mappingLength);
+#endif
+                    m_mapping = nullptr;
+                    m_mappingOffset = 0;
+                    m_mappingLength = 0;
+                }
+            }
+
+            std::size_t write_mapped(const char* data, std::size_t size)
+            {
+                const auto dataStart{ data };
+
+                while (size != 0)
+                {
+                    const auto mappingEnd{ m_mappingOffset + m_mappingLength };
+                    if (!m_mapping || m_end == mappingEnd)
+                    {
+                        if (!map_region())
+                        {
+                            return static_cast<std::size_t>(data - dataStart);
+                        }
+
+                        continue;
+                    }
+
+                    const auto chunkSize{ (std::min)(size, (mappingEnd - m_end)) };
+                    std::memcpy((m_mapping + (m_end - m_mappingOffset)), data, chunkSize);
+
+                    m_end += chunkSize;
+                    data += chunkSize;
+                    size -= chunkSize;
+                }
+
+                return static_cast<std::size_t>(data - dataStart);
+            }
+        };
+
+        // A ring of logs in a file that's shared with the operating system, so what's copied in survives the process dying.
+        // Each record is its size, its sequence and its body. Records are committed once they've been written to the log file,
+        // and their space is reused. Records that weren't committed when the process died are read back by the next open.
+        // Logs are copied in as they are in the buffer, and the source info and static strings they point to are copied
+        // into a table after the ring, once each.
+        class staging_file
+        {
+            struct file_header
+            {
+                char            magic[8];
+                std::uint32_t   version;
+                std::uint32_t   headerSize;
+                std::uint64_t   capacity;       // Size of the ring
+                std::uint64_t   head;           // Bytes ever added, so the end of the ring is at head % capacity
+                std::uint64_t   tail;           // Bytes ever reused
+                std::uint64_t   committed;      // Sequence of the last record written to the log file
+                std::uint64_t   tableCapacity;  // Size of the table after the ring
+                std::uint64_t   tableSize;      // Bytes added to the table
+            };
+
+            // Each table entry is its size, its type and its body
+            enum class table_entry : unsigned char
+            {
+                source  = 1,    // Id, line, file and function
+                string  = 2     // Address in the process that added it and the string
+            };
+
+            enum : std::size_t
+            {
+                // Time, thread id, level, source id and renderer id, followed by the message or args
+                log_prefix_size = (sizeof(std::int64_t) + sizeof(std::uint64_t) + sizeof(std::int8_t) + sizeof(std::uint32_t) + 1)
+            };
+
+            struct staged_source
+            {
+                std::int32_t    line;
+                std::string     file;
+                std::string     function;
+            };
+
+            typedef std::tuple<const char*, int, const char*>   source_key;
+            typedef std::pair<std::uint64_t, std::size_t>       string_key;
+
+#ifdef _WIN32
+            HANDLE          m_handle        { INVALID_HANDLE_VALUE };
+            HANDLE          m_mappingHandle { nullptr };
+#else
+            int             m_handle        { -1 };
+#endif
+            char*                   m_mapping       { nullptr };
+            std::size_t             m_capacity      { 0 };
+            std::size_t             m_tableCapacity { 0 };
+            std::uint64_t           m_nextSequence  { 1 };  // Kept when reopened, so sequences only go up
+            std::uint64_t           m_lastSequence  { 0 };  // Last sequence added since opening
+            pluto::filesystem::path m_filePath      {};
+            std::map<source_key, std::uint32_t> m_sources  {};
+            std::set<string_key>    m_strings       {};
+            std::string             m_entry         {};     // Reused to build table entries
+
+            static inline const char* magic()
+            {
+                return "PLUTOSTG";
+            }
+
+            PLUTO_UTILS_NODISCARD inline file_header& get_header() const
+            {
+                return *reinterpret_cast<file_header*>(m_mapping);
+            }
+
+            template<class Value>
+            static inline char* put(char* const dest, const Value value)
+            {
+                std::memcpy(dest, &value, sizeof(value));
+                return (dest + sizeof(value));
+            }
+
+            void copy_in(const std::uint64_t position, const char* const data, const std::size_t size)
+            {
+                const auto offset   { static_cast<std::size_t>(position % m_capacity) };
+                const auto firstSize{ (std::min)(size, (m_capacity - offset)) };
+
+                std::memcpy((m_mapping + sizeof(file_header) + offset), data, firstSize);
+                std::memcpy((m_mapping + sizeof(file_header)), (data + firstSize), (size - firstSize));
+            }
+
+            static void copy_out(const char* const ring, const std::size_t capacity, const std::uint64_t position, char* const data, const std::size_t size)
+            {
+                const auto offset   { static_cast<std::size_t>(position % capacity) };
+                const auto firstSize{ (std::min)(size, (capacity - offset)) };
+
+                std::memcpy(data, (ring + offset), firstSize);
+                std::memcpy((data + firstSize), ring, (size - firstSize));
+            }
+
+            // Copies the entry being built to the end of the table. The table only covers it once it's complete.
+            bool add_entry()
+            {
+                auto& header{ get_header() };
+
+                const auto entrySize{ static_cast<std::uint32_t>(m_entry.size()) };
+                if (header.tableCapacity - header.tableSize < (sizeof(entrySize) + m_entry.size()))
+                {
+                    return false;
+                }
+
+                const auto dest{ m_mapping + sizeof(file_header) + m_capacity + header.tableSize };
+                std::memcpy(dest, &entrySize, sizeof(entrySize));
+                std::memcpy((dest + sizeof(entrySize)), m_entry.data(), m_entry.size());
+
+                std::atomic_signal_fence(std::memory_order_release);
+                header.tableSize += (sizeof(entrySize) + m_entry.size());
+                return true;
+            }
+
+            // Returns false if the source isn't in the table and there's no room to add it
+            bool add_source(const source_info& source, std::uint32_t& sourceID)
+            {
+                const source_key key{ source.file, source.line, source.function };
+
+                const auto it{ m_sources.find(key) };
+                if (it != m_sources.end())
+                {
+                    sourceID = it->second;
+                    return true;
+                }
+
+                sourceID = static_cast<std::uint32_t>(m_sources.size());
+
+                m_entry.assign(1, static_cast<char>(table_entry::source));
+                append_binary(m_entry, sourceID);
+                append_binary(m_entry, static_cast<std::int32_t>(source.line));
+                append_binary(m_entry, source.file);
+                append_binary(m_entry, source.function);
+
+                if (!add_entry())
+                {
+                    return false;
+                }
+
+                m_sources.emplace(key, sourceID);
+                return true;
+            }
+
+            // Returns false if a static string in the args isn't in the table and there's no room to add it
+            bool add_strings(const char* cursor, const char* const end)
+            {
+                log_arg arg{};
+                while (log_args::read(cursor, end, arg))
+                {
+                    const string_key key{ static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(arg.string)), arg.string_size };
+                    if (arg.type != log_arg_type::static_string || m_strings.count(key) != 0)
+                    {
+                        continue;
+                    }
+
+                    m_entry.assign(1, static_cast<char>(table_entry::string));
+                    append_binary(m_entry, key.first);
+                    append_binary(m_entry, static_cast<std::uint32_t>(arg.string_size));
+                    m_entry.append(arg.string, arg.string_size);
+
+                    if (!add_entry())
+                    {
+                        return false;
+                    }
+
+                    m_strings.insert(key);
+                }
+
+                return true;
+            }
+
+            // Turns a staged log back into one that stands alone. That's its time, thread id, level, line, file, function
+            // and renderer id, followed by its message, or its args with the static strings copied in.
+            static bool expand_log(
+                const std::string&                              record,
+                const std::map<std::uint32_t, staged_source>&   sources,
+                const std::map<string_key, std::string>&        strings,
+                std::string&                                    body)
+            {
+                binary_reader reader{ record.data(), (record.data() + record.size()) };
+
+                std::int64_t    time        { 0 };
+                std::uint64_t   threadID    { 0 };
+                std::int8_t     level       { 0 };
+                std::uint32_t   sourceID    { 0 };
+                unsigned char   rendererID  { 0 };
+
+                if (!reader.read(time) || !reader.read(threadID) || !reader.read(level) || !reader.read(sourceID) || !reader.read(rendererID))
+                {
+                    return false;
+                }
+
+                const auto sourceIt{ sources.find(sourceID) };
+                if (sourceIt == sources.end())
+                {
+                    return false;
+                }
+
+                append_binary(body, time);
+                append_binary(body, threadID);
+                append_binary(body, level);
+                append_binary(body, sourceIt->second.line);
+                append_binary(body, sourceIt->second.file.c_str());
+                append_binary(body, sourceIt->second.function.c_str());
+                append_binary(body, rendererID);
+
+                if (rendererID == 0)
+                {
+                    body.append(reader.cursor, reader.end);
+                    return true;
+                }
+
+                log_arg arg{};
+                for (auto cursor{ reader.cursor }; cursor != reader.end; )
+                {
+                    const auto argStart{ cursor };
+                    if (!log_args::read(cursor, reader.end, arg))
+                    {
+                        break;
+                    }
+
+                    if (arg.type == log_arg_type::static_string)
+                    {
+                        const auto stringIt{ strings.find(string_key{ static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(arg.string)), arg.string_size }) };
+                        if (stringIt == strings.end())
+                        {
+                            return false;
+                        }
+
+                        const auto argOffset{ body.size() };
+                        body.resize(argOffset + log_args::string_size(stringIt->second.size()));
+                        log_args::write_string(&body[argOffset], stringIt->second.data(), stringIt->second.size());
+                    }
+                    else
+                    {
+                        body.append(argStart, cursor);
+                    }
+                }
+
+                return true;
+            }
+
+            // Reads the logs that weren't committed from a file left by an earlier open
+            static void read_uncommitted(const pluto::filesystem::path& filePath, std::vector<std::string>& bodies)
+            {
+                std::ifstream file{ filePath, std::ios::binary };
+                const std::string contents{ std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{} };
+
+                file_header header{};
+                if (contents.size() < sizeof(header))
+                {
+                    return;
+                }
+
+                std::memcpy(&header, contents.data(), sizeof(header));
+                if (std::memcmp(header.magic, magic(), sizeof(header.magic)) != 0 || header.version != 2 ||
+                    header.headerSize != sizeof(header) || (header.capacity + header.tableCapacity) != (contents.size() - sizeof(header)) ||
+                    header.head < header.tail || header.capacity < (header.head - header.tail) || header.tableCapacity < header.tableSize)
+                {
+                    return;
+                }
+
+                const auto ring     { contents.data() + sizeof(header) };
+                const auto capacity { static_cast<std::size_t>(header.capacity) };
+
+                std::map<std::uint32_t, staged_source>  sources {};
+                std::map<string_key, std::string>       strings {};
+
+                binary_reader tableReader{ (ring + capacity), (ring + capacity + header.tableSize) };
+                for (std::uint32_t entrySize{ 0 }; tableReader.read(entrySize) && entrySize <= static_cast<std::size_t>(tableReader.end - tableReader.cursor); )
+                {
+                    binary_reader entryReader{ tableReader.cursor, (tableReader.cursor + entrySize) };
+                    tableReader.cursor += entrySize;
+
+                    unsigned char   type    { 0 };
+                    std::uint32_t   sourceID{ 0 };
+                    staged_source   source  {};
+                    std::uint64_t   address { 0 };
+                    std::string     string  {};
+
+                    if (!entryReader.read(type))
+                    {
+                        continue;
+                    }
+
+                    if (static_cast<table_entry>(type) == table_entry::source && entryReader.read(sourceID) &&
+                        entryReader.read(source.line) && entryReader.read(source.file) && entryReader.read(source.function))
+                    {
+                        sources[sourceID] = std::move(source);
+                    }
+                    else if (static_cast<table_entry>(type) == table_entry::string && entryReader.read(address) && entryReader.read(string))
+                    {
+                        const string_key key{ address, string.size() };
+                        strings[key] = std::move(string);
+                    }
+                }
+
+                std::string record{};
+                for (auto position{ header.tail }; (header.head - position) >= (sizeof(std::uint32_t) + sizeof(std::uint64_t)); )
+                {
+                    std::uint32_t bodySize{ 0 };
+                    std::uint64_t sequence{ 0 };
+                    copy_out(ring, capacity, position, reinterpret_cast<char*>(&bodySize), sizeof(bodySize));
+                    copy_out(ring, capacity, (position + sizeof(bodySize)), reinterpret_cast<char*>(&sequence), sizeof(sequence));
+
+                    const auto recordSize{ sizeof(bodySize) + sizeof(sequence) + bodySize };
+                    if ((header.head - position) < recordSize)
+                    {
+                        return;
+                    }
+
+                    if (header.committed < sequence)
+                    {
+                        record.resize(bodySize);
+                        copy_out(ring, capacity, (position + sizeof(bodySize) + sizeof(sequence)), &record[0], bodySize);
+
+                        bodies.emplace_back();
+                        if (!expand_log(record, sources, strings, bodies.back()))
+                        {
+                            bodies.pop_back();
+                        }
+                    }
+
+                    position += recordSize;
+                }
+            }
+
+            // Copies a record in, reusing space from committed records. Returns its sequence, or 0 if there's no room.
+            std::uint64_t push(const char* const prefix, const char* const body, const std::size_t bodySize)
+            {
+                auto& header{ get_header() };
+
+                const auto bodySize32   { static_cast<std::uint32_t>(log_prefix_size + bodySize) };
+                const auto recordSize   { sizeof(bodySize32) + sizeof(std::uint64_t) + bodySize32 };
+
+                if (m_capacity < recordSize)
+                {
+                    return 0;
+                }
+
+                auto tail{ header.tail };
+                while (m_capacity - (header.head - tail) < recordSize)
+                {
+                    std::uint32_t oldBodySize{ 0 };
+                    std::uint64_t oldSequence{ 0 };
+                    copy_out((m_mapping + sizeof(file_header)), m_capacity, tail, reinterpret_cast<char*>(&oldBodySize), sizeof(oldBodySize));
+                    copy_out((m_mapping + sizeof(file_header)), m_capacity, (tail + sizeof(oldBodySize)), reinterpret_cast<char*>(&oldSequence), sizeof(oldSequence));
+
+                    if (header.committed < oldSequence)
+                    {
+                        header.tail = tail;
+                        return 0;
+                    }
+
+                    tail += (sizeof(oldBodySize) + sizeof(oldSequence) + oldBodySize);
+                }
+
+                header.tail = tail;
+
+                const auto sequence{ m_nextSequence++ };
+                m_lastSequence = sequence;
+
+                auto position{ header.head };
+                copy_in(position, reinterpret_cast<const char*>(&bodySize32), sizeof(bodySize32));
+                copy_in((position += sizeof(bodySize32)), reinterpret_cast<const char*>(&sequence), sizeof(sequence));
+                copy_in((position += sizeof(sequence)), prefix, log_prefix_size);
+                copy_in((position + log_prefix_size), body, bodySize);
+
+                // The record is complete before the head covers it, even if the process dies on this thread
+                std::atomic_signal_fence(std::memory_order_release);
+                header.head += recordSize;
+                return sequence;
+            }
+
+        public:
+            staging_file() = default;
+
+            ~staging_file()
+            {
+                close(false);
+            }
+
+            staging_file(const staging_file&) = delete;
+
+            staging_file& operator=(const staging_file&) = delete;
+
+            PLUTO_UTILS_NODISCARD inline bool is_open() const
+            {
+                return (m_mapping != nullptr);
+            }
+
+            // Opens the file with the size in bytes, replacing what was there. A quarter of it is for the table and the rest is the ring.
+            // Logs that an earlier open didn't commit are read first. Returns false on failure.
+            bool open(const pluto::filesystem::path& filePath, const std::size_t size, std::vector<std::string>& uncommitted)
+            {
+                close(false);
+                read_uncommitted(filePath, uncommitted);
+
+                const auto fileSize{ sizeof(file_header) + size };
+
+#ifdef _WIN32
+                m_handle = ::CreateFileW(filePath.wstring().c_str(), (GENERIC_READ | GENERIC_WRITE),
+                    (FILE_SHARE_READ | FILE_SHARE_WRITE), nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+                if (m_handle == INVALID_HANDLE_VALUE)
+                {
+                    return false;
+                }
+
+                const auto size64{ static_cast<std::uint64_t>(fileSize) };
+                m_mappingHandle = ::CreateFileMappingW(m_handle, nullptr, PAGE_READWRITE,
+                    static_cast<DWORD>(size64 >> 32), static_cast<DWORD>(size64 & 0xFFFFFFFF), nullptr);
+
+                if (m_mappingHandle)
+                {
+                    m_mapping = static_cast<char*>(::MapViewOfFile(m_mappingHandle, FILE_MAP_WRITE, 0, 0, fileSize));
+                }
+#else
+                do
+                {
+                    m_handle = ::open(filePath.c_str(), (O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC), 0644);
+                }
+                while (m_handle == -1 && errno == EINTR);
+
+                if (m_handle == -1)
+                {
+                    return false;
+                }
+
+                // Disk space is allocated up front where it's supported, so running out fails here rather than with SIGBUS
+#ifdef __APPLE__
+                if (::ftruncate(m_handle, static_cast<off_t>(fileSize)) == 0)
+#else
+                if (::posix_fallocate(m_handle, 0, static_cast<off_t>(fileSize)) == 0)
+#endif
+                {
+                    const auto mapping{ ::mmap(nullptr, fileSize, (PROT_READ | PROT_WRITE), MAP_SHARED, m_handle, 0) };
+                    m_mapping = ((mapping == MAP_FAILED) ? nullptr : static_cast<char*>(mapping));
+                }
+#endif
+
+                if (!m_mapping)
+                {
+                    close(false);
+                    return false;
+                }
+
+                m_tableCapacity = size / 4;
+                m_capacity = size - m_tableCapacity;
+                m_lastSequence = 0;
+                m_filePath = filePath;
+                m_sources.clear();
+                m_strings.clear();
+
+                auto& header{ get_header() };
+                std::memcpy(header.magic, magic(), sizeof(header.magic));
+                header.version          = 2;
+                header.headerSize       = sizeof(file_header);
+                header.capacity         = m_capacity;
+                header.head             = 0;
+                header.tail             = 0;
+                header.committed        = 0;
+                header.tableCapacity    = m_tableCapacity;
+                header.tableSize        = 0;
+                return true;
+            }
+
+            // Removes the file if asked to and every record was committed
+            void close(const bool removeIfCommitted)
+            {
+                const auto shouldRemove{ m_mapping && removeIfCommitted && m_lastSequence <= get_header().committed };
+
+                if (m_mapping)
+                {
+#ifdef _WIN32
+                    ::UnmapViewOfFile(m_mapping);
+#else
+                    ::munmap(m_mapping, (sizeof(file_header) + m_capacity + m_tableCapacity));
+#endif
+                    m_mapping = nullptr;
+                    m_capacity = 0;
+                    m_tableCapacity = 0;
+                }
+
+#ifdef _WIN32
+                if (m_mappingHandle)
+                {
+                    ::CloseHandle(m_mappingHandle);
+                    m_mappingHandle = nullptr;
+                }
+
+                if (m_handle != INVALID_HANDLE_VALUE)
+                {
+                    ::CloseHandle(m_handle);
+                    m_handle = INVALID_HANDLE_VALUE;
+                }
+#else
+                if (m_handle != -1)
+                {
+                    ::close(m_handle);
+                    m_handle = -1;
+                }
+#endif
+
+                if (shouldRemove)
+                {
+                    std::error_code error{};
+                    pluto::filesystem::remove(m_filePath, error);
+                }
+            }
+
+            // Copies the log in as it is in the buffer, adding what it points to to the table if it isn't there yet.
+            // Returns its sequence, or 0 if there's no room.
+            std::uint64_t push_log(const log_buffer::header& thisHeader)
+            {
+                std::uint32_t sourceID{ 0 };
+                if (!add_source(thisHeader.source, sourceID) ||
+                    (thisHeader.renderer && !add_strings(thisHeader.message(), (thisHeader.message() + thisHeader.messageSize))))
+                {
+                    return 0;
+                }
+
+                char prefix[log_prefix_size];
+                auto dest{ put(prefix, static_cast<std::int64_t>(thisHeader.time.time_since_epoch().count())) };
+                dest = put(dest, static_cast<std::uint64_t>(thisHeader.threadID));
+                dest = put(dest, static_cast<std::int8_t>(thisHeader.level));
+                dest = put(dest, sourceID);
+                put(dest, renderer_id(thisHeader.renderer));
+
+                return push(prefix, thisHeader.message(), thisHeader.messageSize);
+            }
+
+            // Marks records up to and including this sequence as written
+            inline void commit(const std::uint64_t sequence)
+            {
+                auto& header{ get_header() };
+                if (header.committed < sequence && sequence < m_nextSequence)
+                {
+                    header.committed = sequence;
+                }
+            }
+        };
+
+        // Compresses rotated files to gzip without anything external. Matches are found over a 32KB window and
+        // coded with the fixed Huffman codes from RFC 1951, which does well on logs since they repeat so much.
+        class gzip_writer
+        {
+            enum : std::size_t
+            {
+                window_size = 32768,
+                hash_size   = 32768,
+                min_match   = 3,
+                max_match   = 258,
+                max_chain   = 128   // Number of earlier positions tried for each match
+            };
+
+            native_file                 m_file      {};
+            std::string                 m_input     {};             // Window and lookahead, starting at m_base
+            std::size_t                 m_base      { 0 };
+            std::size_t                 m_position  { 0 };          // Next position to encode
+            std::vector<std::size_t>    m_head      ;               // Last position with each hash
+            std::vector<std::size_t>    m_previous  ;               // Position before each one in the window with the same hash
+            std::string                 m_output    {};
+            std::uint64_t               m_bits      { 0 };          // Bits not yet making up a whole byte of output
+            unsigned int                m_numBits   { 0 };
+            std::uint32_t               m_crc       { 0xFFFFFFFF };
+            std::uint32_t               m_size      { 0 };          // Input size, modulo 2^32 like gzip stores it
+
+        public:
+            gzip_writer() :
+                m_head      (hash_size, std::string::npos),
+                m_previous  (window_size, std::string::npos) {}
+
+            // Opens the file for appending and starts the only block. Returns false on failure.
+            bool open(const pluto::filesystem::path& filePath)
+            {
+                if (!m_file.open(filePath))
+                {
+                    return false;
+                }
+
+                // Magic, deflate, no flags, no time, no extra flags and an unknown operating system
+                m_output.assign("\x1f\x8b\x08\x00\x00\x00\x00\x00\x00\xff", 10);
+
+                put_bits(1, 1); // Final block
+                put_bits(1, 2); // Fixed Huffman codes
+                return true;
+            }
+
+            // Returns false if the compressed data couldn't be written
+            bool write(const char* const data, const std::size_t size)
+            {
+                m_crc = crc32(m_crc, data, size);
+                m_size += static_cast<std::uint32_t>(size);
+                m_input.append(data, size);
+
+                encode(false);
+                return write_output(false);
+            }
+
+            // Ends the block, adds the checksum and size, and closes the file. Returns false on failure.
+            bool finish()
+            {
+                encode(true);
+                put_symbol(256); // End of block
+
+                if (m_numBits != 0)
+                {
+                    put_bits(0, (8 - m_numBits));
+                }
+
+                for (const auto value : { (m_crc ^ 0xFFFFFFFF), m_size })
+                {
+                    for (unsigned int shift{ 0 }; shift < 32; shift += 8)
+                    {
+                        m_output.push_back(static_cast<char>((value >> shift) & 0xFF));
+                    }
+                }
+
+                const auto written{ write_output(true) };
+                m_file.close();
+                return written;
+            }
+
+        private:
+            static std::uint32_t crc32(std::uint32_t crc, const char* const data, const std::size_t size)
+            {
+                static const auto table = []()
+                    {
+                        std::vector<std::uint32_t> crcTable(256);
+                        for (std::uint32_t i{ 0 }; i < 256; ++i)
+                        {
+                            auto value{ i };
+                            for (int bit{ 0 }; bit < 8; ++bit)
+                            {
+                                value = ((value & 1) ? (0xEDB88320 ^ (value >> 1)) : (value >> 1));
+                            }
+
+                            crcTable[i] = value;
+                        }
+
+                        return crcTable;
+                    }();
+
+                for (std::size_t i{ 0 }; i < size; ++i)
+                {
+                    crc = (table[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (crc >> 8));
+                }
+
+                return crc;
+            }
+
+            static inline std::size_t hash(const unsigned char* const bytes)
+            {
+                return (((static_cast<std::size_t>(bytes[0]) << 10) ^ (static_cast<std::size_t>(bytes[1]) << 5) ^ bytes[2]) % hash_size);
+            }
+
+            void put_bits(const std::uint32_t value, const unsigned int numBits)
+            {
+                m_bits |= (static_cast<std::uint64_t>(value) << m_numBits);
+                m_numBits += numBits;
+
+                while (8 <= m_numBits)
+                {
+                    m_output.push_back(static_cast<char>(m_bits & 0xFF));
+                    m_bits >>= 8;
+                    m_numBits -= 8;
+                }
+            }
+
+            // Huffman codes are packed starting from their most significant bit, unlike everything else
+            void put_code(std::uint32_t code, const unsigned int numBits)
+            {
+                std::uint32_t reversed{ 0 };
+                for (unsigned int i{ 0 }; i < numBits; ++i)
+                {
+                    reversed = ((reversed << 1) | (code & 1));
+                    code >>= 1;
+                }
+
+                put_bits(reversed, numBits);
+            }
+
+            // Literals are 0 to 255, the end of block is 256 and lengths are 257 to 285
+            void put_symbol(const std::uint32_t symbol)
+            {
+                if (symbol < 144)
+                {
+                    put_code((0x30 + symbol), 8);
+                }
+                else if (symbol < 256)
+                {
+                    put_code((0x190 + (symbol - 144)), 9);
+                }
+                else if (symbol < 280)
+                {
+                    put_code((symbol - 256), 7);
+                }
+                else
+                {
+                    put_code((0xC0 + (symbol - 280)), 8);
+                }
+            }
+
+            void put_match(const std::size_t length, const std::size_t distance)
+            {
+                static const std::uint16_t lengthBases[29]{
+                    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+
+                static const unsigned char lengthExtraBits[29]{
+                    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+
+                static const std::uint16_t distanceBases[30]{
+                    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769,
+                    1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+
+                std::uint32_t code{ 28 };
+                while (length < lengthBases[code])
+                {
+                    --code;
+                }
+
+                put_symbol(257 + code);
+                put_bits(static_cast<std::uint32_t>(length - lengthBases[code]), lengthExtraBits[code]);
+
+                code = 29;
+                while (distance < distanceBases[code])
+                {
+                    --code;
+                }
+
+                // Distance codes are all 5 bits, the first 4 have no extra bits and then every 2 have 1 more
+                put_code(code, 5);
+                put_bits(static_cast<std::uint32_t>(distance - distanceBases[code]), ((code < 4) ? 0 : ((code / 2) - 1)));
+            }
+
+            void insert(const unsigned char* const data, const std::size_t position)
+            {
+                auto& head{ m_head[hash(data + (position - m_base))] };
+                m_previous[position % window_size] = head;
+                head = position;
+            }
+
+            // Input is only encoded once there's enough after it for the longest match, unless it's the end
+            void encode(const bool isEnd)
+            {
+                const auto data { reinterpret_cast<const unsigned char*>(m_input.data()) };
+                const auto end  { m_base + m_input.size() };
+                const auto limit{ isEnd ? end : ((max_match < end) ? (end - max_match) : 0) };
+
+                while (m_position < limit)
+                {
+                    std::size_t matchLength     { 0 };
+                    std::size_t matchDistance   { 0 };
+
+                    if (m_position + min_match <= end)
+                    {
+                        const auto current  { data + (m_position - m_base) };
+                        const auto maxLength{ (std::min)(static_cast<std::size_t>(max_match), (end - m_position)) };
+
+                        auto candidate{ m_head[hash(current)] };
+                        for (std::size_t numTried{ 0 };
+                            candidate != std::string::npos && (m_position - candidate) <= window_size && numTried < max_chain;
+                            ++numTried)
+                        {
+                            const auto earlier{ data + (candidate - m_base) };
+
+                            // Only worth comparing if it could be longer than the best so far
+                            if (earlier[matchLength] == current[matchLength])
+                            {
+                                std::size_t length{ 0 };
+                                while (length < maxLength && earlier[length] == current[length])
+                                {
+                                    ++length;
+                                }
+
+                                if (matchLength < length)
+                                {
+                                    matchLength = length;
+                                    matchDistance = (m_position - candidate);
+
+                                    if (matchLength == maxLength)
+                                    {
+                                        break;
+                                    }
+                                }
+                            }
+
+                            candidate = m_previous[candidate % window_size];
+                        }
+
+                        insert(data, m_position);
+                    }
+
+                    if (min_match <= matchLength)
+                    {
+                        put_match(matchLength, matchDistance);
+
+                        for (auto position{ m_position + 1 }; position < m_position + matchLength && position + min_match <= end; ++position)
+                        {
+                            insert(data, position);
+                        }
+
+                        m_position += matchLength;
+                    }
+                    else
+                    {
+                        put_symbol(data[m_position - m_base]);
+                        ++m_position;
+                    }
+                }
+
+                // Only the window before the next position is needed for matches
+                if ((2 * window_size) < (m_position - m_base))
+                {
+                    const auto numDropped{ m_position - m_base - window_size };
+                    m_input.erase(0, numDropped);
+                    m_base += numDropped;
+                }
+            }
+
+            bool write_output(const bool force)
+            {
+                if (!force && m_output.size() < 65536)
+                {
+                    return true;
+                }
+
+                const auto written{ m_file.write(m_output.data(), m_output.size()) == m_output.size() };
+                m_output.clear();
+                return written;
+            }
+        };
+
+        // Binary files intern source info and schemes, so each is written once per file and then referred to by id
+        struct binary_tables
+        {
+            typedef std::tuple<const char*, int, const char*> source_key;
+
+            std::map<source_key, std::uint32_t>             sources {};
+            std::unordered_map<std::string, std::uint32_t>  schemes {};
+            std::string                                     scheme  {};     // Reused lookup key
+
+            void clear()
+            {
+                sources.clear();
+                schemes.clear();
+            }
+        };
+
+        typedef std::chrono::steady_clock::time_point steady_time;
+
+        // Counted by the thread writing the file, and read by stats() from any thread
+        struct write_counters
+        {
+            enum : std::size_t
+            {
+                num_latency_buckets = 24    // The last bucket has flushes that took 4 seconds or more
+            };
+
+            std::atomic_size_t          numRecords                          { 0 };
+            std::atomic_size_t          numBytes                            { 0 };
+            std::atomic_size_t          numFlushes                          { 0 };
+            std::atomic_size_t          numRotations                        { 0 };
+            std::atomic<std::int64_t>   rotationTime                        { 0 };  // In nanoseconds
+            std::atomic_size_t          flushLatencies[num_latency_buckets] {};
+
+            static inline void add(std::atomic_size_t& counter, const std::size_t value)
+            {
+                counter.fetch_add(value, std::memory_order_relaxed);
+            }
+        };
+
+        // Counted by each thread that waits for a lock, so waiting doesn't write memory shared with other threads.
+        // Only the owning thread writes them, and stats() adds them up.
+        struct lock_counters
+        {
+            enum : std::size_t
+            {
+                sample_rate = 16    // One wait in this many is timed
+            };
+
+            std::atomic_size_t          numWaits    { 0 };
+            std::atomic_size_t          numTimed    { 0 };
+            std::atomic<std::int64_t>   waitTime    { 0 };  // Of the timed waits, in nanoseconds
+
+            template<class Value>
+            static inline void add(std::atomic<Value>& counter, const Value value)
+            {
+                counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+            }
+        };
+
+        struct lock_totals
+        {
+            std::size_t     numWaits    { 0 };
+            std::size_t     numTimed    { 0 };
+            std::int64_t    waitTime    { 0 };
+
+            void add(const lock_counters& counters)
+            {
+                numWaits += counters.numWaits.load(std::memory_order_relaxed);
+                numTimed += counters.numTimed.load(std::memory_order_relaxed);
+                waitTime += counters.waitTime.load(std::memory_order_relaxed);
+            }
+        };
+
+        struct log_file
+        {
+            std::string             name            {};
+            mutable std::mutex      mutex           {};     // Guards the buffer, so files don't contend with each other
+            std::condition_variable spaceCondition  {};     // Notified when the buffer is taken
+            log_buffer              buffer          {};     // Logs added by calling threads
+            log_buffer              pending         {};     // Logs taken by the logging thread
+            std::size_t             numWritten      { 0 };  // Number of pending logs written
+            log_entry               entry           { {}, 0, log_level::off, { "", 0, "" }, {} };
+            binary_tables           binary          {};
+            std::string             output          {};     // Logs appended by the logging thread, written in one call
+            std::vector<std::size_t> outputEnds     {};     // Where each log in the output ends, so a failed write knows which made it
+            std::ostringstream      writerStream    {};     // Used by log writers, rather than the file
+            native_file             file            {};
+            std::size_t             fileSize        { 0 };  // Tracked as logs are written
+            bool                    isBinary        { false };
+            bool                    isSynced        { true };
+            bool                    isWriting       { false };  // Set while a writer thread has the pending logs
+            steady_time             lastSync        {};
+            steady_time             lastCheck       {};     // When the file was last checked for changes by something else
+            pluto::filesystem::path filePath        {};
+            bool                    dirsCreated     { false };
+            log_period              rotationPeriod  { log_period::none };   // The period the rotation time was worked out for
+            std::time_t             rotationTime    { 0 };                  // When the file is next rotated, if there's a period
+            std::size_t             numEnqueued     { 0 };  // Guarded by the mutex, like the buffer
+            std::size_t             maxBufferDepth  { 0 };
+            write_counters          counters        {};
+            staging_file            staging         {};     // Guarded by the mutex, like the buffer
+            std::size_t             stagingSize     { 0 };  // The staging size the staging file was opened for
+            bool                    stagingRecovered{ false };
+            std::set<std::string>   recoveredStrings{};     // Source info of recovered logs
+        };
+
+        struct thread_entry
+        {
+            log_entry::time_type    time;
+            std::size_t             threadID;
+            log_level               level;
+            source_info             source;
+            log_file*               file;
+            log_renderer            renderer;
+            std::string             message;
+
+            thread_entry() :
+                time    {},
+                threadID{ 0 },
+                level   { log_level::off },
+                source  { "", 0, "" },
+                file    { nullptr },
+                renderer{ nullptr },
+                message {}
+            {
+                message.reserve(PLUTO_LOGGER_THREAD_BUFFER_MESSAGE_RESERVE);
+            }
+        };
+
+        // Single producer, single consumer ring of preallocated entries.
+        // The owning thread is the only producer and the logging thread is the only consumer.
+        struct thread_buffer
+        {
+            std::vector<thread_entry>   entries     {};
+            std::atomic_size_t          head        { 0 };  // Next entry to read, moved by the logging thread
+            std::atomic_size_t          tail        { 0 };  // Next entry to write, moved by the owning thread
+            std::string                 lastFileName{};     // Only used by the owning thread, to skip looking up files
+            log_file*                   lastFile    { nullptr };
+
+            explicit thread_buffer(const std::size_t size) :
+                entries(size) {}
+        };
+
+        typedef std::vector<std::shared_ptr<thread_buffer>> thread_buffer_list;
+
+        // A binary file starts with a file header, followed by records. Each record is its size, its type and its body.
+        enum class binary_record : unsigned char
+        {
+            source  = 1,    // Id, line, file and function
+            scheme  = 2,    // Id and scheme
+            log     = 3     // Time, thread id, level, source id, message type, scheme id and message or args
+        };
+
+        enum class binary_message : unsigned char
+        {
+            text    = 0,    // Message is stored as is
+            printf  = 1,    // Args are stored, rendered with log_args::render_printf
+            format  = 2     // Args are stored, rendered with log_args::render_format
+        };
+
+        struct binary_source
+        {
+            std::string file;
+            int         line;
+            std::string function;
+        };
+
+        struct binary_reader
+        {
+            const char* cursor;
+            const char* end;
+
+            template<class Value>
+            bool read(Value& value)
+            {
+                if (static_cast<std::size_t>(end - cursor) < sizeof(value))
+                {
+                    return false;
+                }
+
+                std::memcpy(&value, cursor, sizeof(value));
+                cursor += sizeof(value);
+                return true;
+            }
+
+            bool read(std::string& value)
+            {
+                std::uint32_t length{ 0 };
+                if (!read(length) || static_cast<std::size_t>(end - cursor) < length)
+                {
+                    return false;
+                }
+
+                value.assign(cursor, length);
+                cursor += length;
+                return true;
+            }
+        };
+
+        const std::size_t               m_id                { next_id() };
+        mutable std::mutex              m_loggingMutex      {};     // Guards the log files map, thread buffers list and writer pool
+        std::thread                     m_loggingThread     {};
+        std::condition_variable         m_loggingCondition  {};
+        std::condition_variable         m_spaceCondition    {};     // Notified when thread buffers are drained
+        std::mutex                      m_spillMutex        {};
+        std::map<std::string, native_file> m_spillFiles     {};
+        std::map<std::string, log_file> m_logFiles          {};
+        thread_buffer_list              m_threadBuffers     {};
+        std::unique_ptr<pluto::thread_pool> m_ownWriterPool {};     // Created for writer_threads()
+        pluto::thread_pool*             m_writerPool        { nullptr };
+        std::size_t                     m_numWriting        { 0 };  // Number of files being written by writer threads
+        std::mutex                      m_rotationMutex     {};
+        std::unique_ptr<pluto::thread_pool> m_rotationPool  {};     // One thread, created by the first rotation with work to do
+        mutable std::mutex              m_lockCountersMutex {};
+        mutable std::vector<std::shared_ptr<lock_counters>> m_lockCounters{};  // One for each thread that waited for a lock
+        mutable lock_totals             m_exitedLockTotals  {};     // Added up from threads that have exited
+        lock_totals                     m_resetLockTotals   {};     // What was counted when the stats were last reset
+
+        std::atomic_bool        m_isWaiting         { false };
+        std::atomic_bool        m_hasPendingLogs    { false };
+        std::atomic_bool        m_hasFlushTimer     { false };  // Set by the first log after a flush, if there's a flush interval
+        std::atomic_bool        m_isLogging         { true };
+        std::atomic<log_level>  m_level             { log_level::PLUTO_LOGGER_INITIAL_LEVEL };
+        std::atomic_bool        m_createDirs        { PLUTO_LOGGER_INITIAL_CREATE_DIRS };
+        std::atomic_bool        m_writeHeader       { PLUTO_LOGGER_INITIAL_WRITE_HEADER };
+        std::atomic_size_t      m_bufferMaxSize     { PLUTO_LOGGER_INITIAL_BUFFER_MAX_SIZE };
+        std::atomic_size_t      m_bufferFlushSize   { PLUTO_LOGGER_INITIAL_BUFFER_FLUSH_SIZE };
+        std::atomic<log_overflow> m_overflowPolicy  { log_overflow::PLUTO_LOGGER_INITIAL_OVERFLOW_POLICY };
+        std::atomic<std::chrono::milliseconds> m_overflowTimeout{ std::chrono::milliseconds{ PLUTO_LOGGER_INITIAL_OVERFLOW_TIMEOUT } };
+        std::atomic<log_level>  m_overflowLevel     { log_level::PLUTO_LOGGER_INITIAL_OVERFLOW_LEVEL };
+        std::atomic<std::chrono::milliseconds> m_flushInterval{ std::chrono::milliseconds{ PLUTO_LOGGER_INITIAL_FLUSH_INTERVAL } };
+        std::atomic_size_t      m_threadBufferSize  { PLUTO_LOGGER_INITIAL_THREAD_BUFFER_SIZE };
+        std::atomic_bool        m_deferFormatting   { PLUTO_LOGGER_INITIAL_DEFERRED_FORMATTING };
+        std::atomic_bool        m_binaryMode        { PLUTO_LOGGER_INITIAL_BINARY_MODE };
+        std::atomic<log_fields> m_fieldFormat       { log_fields::PLUTO_LOGGER_INITIAL_FIELD_FORMAT };
+        std::atomic<log_sync>   m_syncPolicy        { log_sync::PLUTO_LOGGER_INITIAL_SYNC_POLICY };
+        std::atomic<std::chrono::milliseconds> m_syncInterval{ std::chrono::milliseconds{ PLUTO_LOGGER_INITIAL_SYNC_INTERVAL } };
+        std::atomic<std::chrono::milliseconds> m_fileCheckInterval{ std::chrono::milliseconds{ PLUTO_LOGGER_INITIAL_FILE_CHECK_INTERVAL } };
+        std::atomic_size_t      m_stagingSize       { PLUTO_LOGGER_INITIAL_STAGING_SIZE };
+        std::atomic_size_t      m_fileMappingSize   { PLUTO_LOGGER_INITIAL_FILE_MAPPING_SIZE };
+        std::atomic_size_t      m_fileRotationSize  { PLUTO_LOGGER_INITIAL_FILE_ROTATION_SIZE };
+        std::atomic_size_t      m_fileRotationLimit { PLUTO_LOGGER_INITIAL_FILE_ROTATION_LIMIT };
+        std::atomic<log_period> m_fileRotationPeriod{ log_period::PLUTO_LOGGER_INITIAL_FILE_ROTATION_PERIOD };
+        std::atomic<log_naming> m_fileRotationNaming{ log_naming::PLUTO_LOGGER_INITIAL_FILE_ROTATION_NAMING };
+        std::atomic_bool        m_fileRotationCompress{ PLUTO_LOGGER_INITIAL_FILE_ROTATION_COMPRESS };
+        std::atomic_size_t      m_numDiscardedLogs  { 0 };
+
+        mutable std::mutex                                      m_configMutex   {};
+        std::function<void(std::ostream&, const log_entry&)>    m_logWriter     { PLUTO_LOGGER_INITIAL_LOG_WRITER };
+        std::function<void(std::ostream&)>                      m_headerWriter  { PLUTO_LOGGER_INITIAL_HEADER_WRITER };
+        std::function<void(std::string&, const log_entry&)>     m_logAppender   { PLUTO_LOGGER_INITIAL_LOG_APPENDER };
+        std::function<void(std::string&)>                       m_headerAppender{ PLUTO_LOGGER_INITIAL_HEADER_APPENDER };
+        std::string                                             m_overflowFile  { PLUTO_LOGGER_INITIAL_OVERFLOW_FILE };
+
+    public:
+        logger()
+        {
+            writer_threads(PLUTO_LOGGER_INITIAL_WRITER_THREADS);
+            m_loggingThread = std::thread(&logger::start_logging, this);
+        }
+
+        ~logger()
+        {
+            m_isLogging.store(false);
+            m_loggingCondition.notify_all();
+
+            // Release calling threads waiting for room
+            {
+                const std::unique_lock<std::mutex> lock{ m_loggingMutex };
+
+                for (auto& logFilePair : m_logFiles)
+                {
+                    auto& logFile{ logFilePair.second };
+
+                    {
+                        const std::unique_lock<std::mutex> fileLock{ logFile.mutex };
+                    }
+
+                    logFile.spaceCondition.notify_all();
+                }
+            }
+
+            m_spaceCondition.notify_all();
+
+            if (m_loggingThread.joinable())
+            {
+                m_loggingThread.join();
+            }
+
+            // Move logs left in thread buffers to their file buffers
+            {
+                const std::unique_lock<std::mutex> lock{ m_loggingMutex };
+                drain_thread_buffers();
+            }
+
+            // Write all buffers to their files
+            for (auto& logFilePair : m_logFiles)
+            {
+                auto& logFile{ logFilePair.second };
+
+                if (!logFile.pending.empty())
+                {
+                    write_buffer_to_file(logFilePair.first, logFile);
+                }
+
+                if (!logFile.buffer.empty() && logFile.numWritten == logFile.pending.size())
+                {
+                    logFile.pending.swap(logFile.buffer);
+                    logFile.numWritten = 0;
+                    write_buffer_to_file(logFilePair.first, logFile);
+                }
+
+                sync_file(logFile, true);
+
+                // Nothing needs recovering after a clean exit
+                logFile.staging.close(true);
+            }
+
+            // Wait for rotated files to be compressed
+            m_rotationPool.reset();
+        }
+
+        logger(const logger&) = delete;
+
+        logger(logger&&) = delete;
+
+        logger& operator=(const logger&) = delete;
+
+        logger& operator=(logger&&) = delete;
+
+        static inline logger& instance()
+        {
+            static logger instance{};
+            return instance;
+        }
+
+        static void default_log_writer(std::ostream& stream, const log_entry& log)
+        {
+            thread_local std::string line{};
+
+            line.clear();
+            default_log_appender(line, log);
+            stream.write(line.data(), static_cast<std::streamsize>(line.size()));
+        }
+
+        static void default_header_writer(std::ostream& stream)
+        {
+            std::string header{};
+
+            default_header_appender(header);
+            stream.write(header.data(), static_cast<std::streamsize>(header.size()));
+        }
+
+        static void default_log_appender(std::string& output, const log_entry& log)
+        {
+            // Logs come in bursts, so the date and time are only rendered when the second changes
+            thread_local bool           hasCachedTime   { false };
+            thread_local std::time_t    cachedTime      {};
+            thread_local char           cachedPrefix[32]{};
+            thread_local std::size_t    cachedPrefixSize{ 0 };
+
+            const auto posixTime{ pluto::logger::clock_type::to_time_t(log.time) };
+            if (!hasCachedTime || cachedTime != posixTime)
+            {
+                const auto localTime{ pluto::local_time(posixTime) };
+
+                cachedPrefixSize = std::strftime(cachedPrefix, sizeof(cachedPrefix), "%Y-%m-%d %H:%M:%S.", &localTime);
+                cachedTime = posixTime;
+                hasCachedTime = true;
+            }
+
+            const auto microseconds{ std::chrono::duration_cast<std::chrono::microseconds>(
+                        log.time.time_since_epoch()).count() % 1'000'000 };
+
+            output.append(cachedPrefix, cachedPrefixSize);
+            append_integer(output, microseconds, 6, '0');
+            output.push_back('|');
+            append_integer(output, log.thread_id, 7, ' ');
+            output.push_back('|');
+            append_padded(output, pluto::log_level_to_title(log.level), 8);
+            output.push_back('|');
+#if !PLUTO_LOGGER_HIDE_SOURCE_INFO
+            if (log.source.site != nullptr)
+            {
+                output.append(log.source.site->text(), log.source.site->size());
+            }
+            else
+            {
+                append_source(output, log.source);
+            }
+#endif
+            output.append(log.message);
+        }
+
+        static void default_header_appender(std::string& output)
+        {
+            append_padded(output, "Timestamp", 26);
+            output.append("|    TID|");
+            append_padded(output, pluto::log_level_to_title(log_level::header), 8);
+            output.push_back('|');
+#if !PLUTO_LOGGER_HIDE_SOURCE_INFO
+            append_padded(output, "File Name", 20);
+            output.append("| Line|");
+            append_padded(output, "Function", 20);
+            output.push_back('|');
+#endif
+            output.append("Message\n");
+            output.append(26, '-');
+            output.push_back('+');
+            output.append(7, '-');
+            output.push_back('+');
+            output.append(8, '-');
+            output.push_back('+');
+#if !PLUTO_LOGGER_HIDE_SOURCE_INFO
+            output.append(20, '-');
+            output.push_back('+');
+            output.append(5, '-');
+            output.push_back('+');
+            output.append(20, '-');
+            output.push_back('+');
+#endif
+            output.append(7, '-');
+        }
+
+        // Reads logs written in binary mode. The log passed to the function is only valid for that call.
+        // Returns false if the stream isn't a binary log file, or if it ends partway through a record.
+        static bool read_binary_log(std::istream& stream, const std::function<void(const log_entry&)>& function)
+        {
+            std::string fileHeader(binary_file_header_size(), '\0');
+            if (!stream.read(&fileHeader[0], fileHeader.size()) || fileHeader.compare(0, 8, binary_magic()) != 0)
+            {
+                return false;
+            }
+
+            std::uint32_t version   { 0 };
+            std::int64_t periodNum  { 0 };
+            std::int64_t periodDen  { 0 };
+
+            binary_reader headerReader{ fileHeader.data() + 8, fileHeader.data() + fileHeader.size() };
+            if (!headerReader.read(version) || version != binary_version() ||
+                !headerReader.read(periodNum) || !headerReader.read(periodDen) || periodNum <= 0 || periodDen <= 0)
+            {
+                return false;
+            }
+
+            std::map<std::uint32_t, binary_source>  sources {};
+            std::map<std::uint32_t, std::string>    schemes {};
+            std::string                             record  {};
+            std::string                             args    {};
+            log_entry                               entry   { {}, 0, log_level::off, { "", 0, "" }, {} };
+
+            while (true)
+            {
+                std::uint32_t recordSize{ 0 };
+                if (!stream.read(reinterpret_cast<char*>(&recordSize), sizeof(recordSize)))
+                {
+                    return (stream.gcount() == 0); // Only a clean end if no part of a record was read
+                }
+
+                record.resize(recordSize);
+                if (recordSize == 0 || !stream.read(&record[0], recordSize))
+                {
+                    return false;
+                }
+
+                binary_reader reader{ record.data() + 1, record.data() + record.size() };
+
+                switch (static_cast<binary_record>(record[0]))
+                {
+                    case binary_record::source:
+                    {
+                        std::uint32_t id{ 0 };
+                        std::int32_t line{ 0 };
+                        binary_source source{};
+
+                        if (!reader.read(id) || !reader.read(line) || !reader.read(source.file) || !reader.read(source.function))
+                        {
+                            return false;
+                        }
+
+                        source.line = line;
+                        sources[id] = std::move(source);
+                        break;
+                    }
+                    case binary_record::scheme:
+                    {
+                        std::uint32_t id{ 0 };
+                        std::string scheme{};
+
+                        if (!reader.read(id) || !reader.read(scheme))
+                        {
+                            return false;
+                        }
+
+                        schemes[id] = std::move(scheme);
+                        break;
+                    }
+                    case binary_record::log:
+                    {
+                        std::int64_t ticks      { 0 };
+                        std::uint64_t threadID  { 0 };
+                        std::int8_t level       { 0 };
+                        std::uint32_t sourceID  { 0 };
+                        unsigned char type      { 0 };
+                        std::uint32_t schemeID  { 0 };
+
+                        if (!reader.read(ticks) || !reader.read(threadID) || !reader.read(level) ||
+                            !reader.read(sourceID) || !reader.read(type) || !reader.read(schemeID))
+                        {
+                            return false;
+                        }
+
+                        entry.time      = binary_time(ticks, periodNum, periodDen);
+                        entry.thread_id = static_cast<std::size_t>(threadID);
+                        entry.level     = static_cast<log_level>(level);
+
+                        const auto sourceIt{ sources.find(sourceID) };
+                        if (sourceIt != sources.end())
+                        {
+                            const auto& source{ sourceIt->second };
+                            entry.source = { source.file.c_str(), source.line, source.function.c_str() };
+                        }
+                        else
+                        {
+                            entry.source = { "", 0, "" };
+                        }
+
+                        const auto messageType{ static_cast<binary_message>(type) };
+                        if (messageType == binary_message::printf || messageType == binary_message::format)
+                        {
+                            // Put the scheme back in front of the args
+                            const auto schemeIt { schemes.find(schemeID) };
+                            const auto& scheme  { (schemeIt != schemes.end()) ? schemeIt->second : std::string{} };
+
+                            args.resize(log_args::string_size(scheme.size()));
+                            log_args::write_string(&args[0], scheme.data(), scheme.size());
+                            args.append(reader.cursor, reader.end);
+
+                            entry.message.clear();
+                            if (messageType == binary_message::printf)
+                            {
+                                log_args::render_printf(entry.message, args.data(), args.size());
+                            }
+                            else
+                            {
+                                log_args::render_format(entry.message, args.data(), args.size());
+                            }
+                        }
+                        else
+                        {
+                            entry.message.assign(reader.cursor, reader.end);
+                        }
+
+                        function(entry);
+                        break;
+                    }
+                    default:
+                    {
+                        break; // Unknown records are skipped
+                    }
+                }
+            }
+        }
+
+        PLUTO_UTILS_NODISCARD inline bool is_logging() const
+        {
+            return m_isLogging.load();
+        }
+
+        PLUTO_UTILS_NODISCARD inline log_level level() const
+        {
+            return m_level.load();
+        }
+
+        PLUTO_UTILS_NODISCARD inline bool create_dirs() const
+        {
+            return m_createDirs.load();
+        }
+
+        PLUTO_UTILS_NODISCARD inline bool write_header() const
+        {
+            return m_writeHeader.load();
+        }
+
+        PLUTO_UTILS_NODISCARD inline std::size_t buffer_max_size() const
+        {
+            return m_bufferMaxSize.load();
+        }
+
+        PLUTO_UTILS_NODISCARD inline std::size_t buffer_flush_size() const
+        {
+            return m_bufferFlushSize.load();
+        }
+
+        PLUTO_UTILS_NODISCARD inline log_overflow overflow_policy() const
+        {
+            return m_overflowPolicy.load();
+        }
+
+        PLUTO_UTILS_NODISCARD inline std::chrono::milliseconds overflow_timeout() const
+        {
+            return m_overflowTimeout.load();
+        }
+
+        PLUTO_UTILS_NODISCARD inline log_level overflow_level() const
+        {
+            return m_overflowLevel.load();
+        }
+
+        PLUTO_UTILS_NODISCARD inline std::string overflow_file() const
+        {
+            const std::unique_lock<std::mutex> lock{ m_configMutex };
+            return m_overflowFile;
+        }
+
+        PLUTO_UTILS_NODISCARD inline std::size_t writer_threads() const
+        {
+            const std::unique_lock<std::mutex> lock{ m_loggingMutex };
+            return (m_ownWriterPool ? m_ownWriterPool->target_workers_size() : 0);
+        }
+
+        PLUTO_UTILS_NODISCARD inline pluto::thread_pool* writer_pool() const
+        {
+            const std::unique_lock<std::mutex> lock{ m_loggingMutex };
+            return m_writerPool;
+        }
+
+        PLUTO_UTILS_NODISCARD inline std::chrono::milliseconds flush_interval() const
+        {
+            return m_flushInterval.load();
+        }
+
+        PLUTO_UTILS_NODISCARD inline bool deferred_formatting() const
+        {
+            return m_deferFormatting.load();
+        }
+
+        PLUTO_UTILS_NODISCARD inline bool binary_mode() const
+        {
+            return m_binaryMode.load();
+        }
+
+        PLUTO_UTILS_NODISCARD inline log_fields field_format() const
+        {
+            return m_fieldFormat.load();
+        }
+
+        PLUTO_UTILS_NODISCARD inline std::size_t thread_buffer_size() const
+        {
+            return m_threadBufferSize.load();
+        }
+
+        PLUTO_UTILS_NODISCARD inline log_sync sync_policy() const
+        {
+            return m_syncPolicy.load();
+        }
+
+        PLUTO_UTILS_NODISCARD inline std::chrono::milliseconds sync_interval() const
+        {
+            return m_syncInterval.load();
+        }
+
+        PLUTO_UTILS_NODISCARD inline std::chrono::milliseconds file_check_interval() const
+        {
+            return m_fileCheckInterval.load();
+        }
+
+        PLUTO_UTILS_NODISCARD inline std::size_t staging_size() const
+        {
+            return m_stagingSize.load();
+        }
+
+        PLUTO_UTILS_NODISCARD inline std::size_t file_mapping_size() const
+        {
+            return m_fileMappingSize.load();
+        }
+
+        PLUTO_UTILS_NODISCARD inline std::size_t file_rotation_size() const
+        {
+            return m_fileRotationSize.load();
+        }
+
+        PLUTO_UTILS_NODISCARD inline std::size_t file_rotation_limit() const
+        {
+            return m_fileRotationLimit.load();
+        }
+
+        PLUTO_UTILS_NODISCARD inline log_period file_rotation_period() const
+        {
+            return m_fileRotationPeriod.load();
+        }
+
+        PLUTO_UTILS_NODISCARD inline log_naming file_rotation_naming() const
+        {
+            return m_fileRotationNaming.load();
+        }
+
+        PLUTO_UTILS_NODISCARD inline bool file_rotation_compress() const
+        {
+            return m_fileRotationCompress.load();
+        }
+
+        PLUTO_UTILS_NODISCARD inline std::size_t num_discarded_logs() const
+        {
+            return m_numDiscardedLogs.load();
+        }
+
+        // Counts are kept all the time, this takes a snapshot of them
+        PLUTO_UTILS_NODISCARD log_stats stats() const
+        {
+            log_stats stats{};
+            stats.total.flush_latencies.resize(write_counters::num_latency_buckets);
+
+            {
+                const std::unique_lock<std::mutex> lock{ m_loggingMutex };
+
+                for (const auto& logFilePair : m_logFiles)
+                {
+                    const auto& logFile { logFilePair.second };
+                    const auto& counters{ logFile.counters };
+                    auto& fileStats     { stats.files[logFilePair.first] };
+
+                    {
+                        const std::unique_lock<std::mutex> fileLock{ logFile.mutex };
+                        fileStats.records_enqueued = logFile.numEnqueued;
+                        fileStats.max_buffer_depth = logFile.maxBufferDepth;
+                    }
+
+                    fileStats.records_written   = counters.numRecords.load(std::memory_order_relaxed);
+                    fileStats.bytes_written     = counters.numBytes.load(std::memory_order_relaxed);
+                    fileStats.flushes           = counters.numFlushes.load(std::memory_order_relaxed);
+                    fileStats.rotations         = counters.numRotations.load(std::memory_order_relaxed);
+                    fileStats.rotation_time     = std::chrono::nanoseconds{ counters.rotationTime.load(std::memory_order_relaxed) };
+
+                    fileStats.flush_latencies.resize(write_counters::num_latency_buckets);
+                    for (std::size_t i{ 0 }; i < write_counters::num_latency_buckets; ++i)
+                    {
+                        fileStats.flush_latencies[i] = counters.flushLatencies[i].load(std::memory_order_relaxed);
+                        stats.total.flush_latencies[i] += fileStats.flush_latencies[i];
+                    }
+
+                    stats.total.records_enqueued    += fileStats.records_enqueued;
+                    stats.total.records_written     += fileStats.records_written;
+                    stats.total.bytes_written       += fileStats.bytes_written;
+                    stats.total.flushes             += fileStats.flushes;
+                    stats.total.max_buffer_depth    = (std::max)(stats.total.max_buffer_depth, fileStats.max_buffer_depth);
+                    stats.total.rotations           += fileStats.rotations;
+                    stats.total.rotation_time       += fileStats.rotation_time;
+                }
+            }
+
+            lock_totals lockTotals{};
+            {
+                const std::unique_lock<std::mutex> lock{ m_lockCountersMutex };
+                lockTotals = total_lock_counters();
+
+                lockTotals.numWaits -= m_resetLockTotals.numWaits;
+                lockTotals.numTimed -= m_resetLockTotals.numTimed;
+                lockTotals.waitTime -= m_resetLockTotals.waitTime;
+            }
+
+            // The time is estimated from the timed waits
+            stats.lock_waits        = lockTotals.numWaits;
+            stats.lock_wait_time    = std::chrono::nanoseconds{ (lockTotals.numTimed == 0) ? 0 : static_cast<std::int64_t>(
+                static_cast<double>(lockTotals.waitTime) * static_cast<double>(lockTotals.numWaits) / static_cast<double>(lockTotals.numTimed)) };
+            stats.discarded         = num_discarded_logs();
+            return stats;
+        }
+
+        PLUTO_UTILS_NODISCARD inline std::function<void(std::ostream&, const log_entry&)> log_writer() const
+        {
+            const std::unique_lock<std::mutex> lock{ m_configMutex };
+            return m_logWriter;
+        }
+
+        PLUTO_UTILS_NODISCARD inline std::function<void(std::ostream&)> header_writer() const
+        {
+            const std::unique_lock<std::mutex> lock{ m_configMutex };
+            return m_headerWriter;
+        }
+
+        PLUTO_UTILS_NODISCARD inline std::function<void(std::string&, const log_entry&)> log_appender() const
+        {
+            const std::unique_lock<std::mutex> lock{ m_configMutex };
+            return m_logAppender;
+        }
+
+        PLUTO_UTILS_NODISCARD inline std::function<void(std::string&)> header_appender() const
+        {
+            const std::unique_lock<std::mutex> lock{ m_configMutex };
+            return m_headerAppender;
+        }
+
+        inline logger& level(const log_level level)
+        {
+            m_level.store(level);
+            return *this;
+        }
+
+        inline logger& create_dirs(const bool createDirs)
+        {
+            m_createDirs.store(createDirs);
+            return *this;
+        }
+
+        inline logger& write_header(const bool writeHeader)
+        {
+            m_writeHeader.store(writeHeader);
+            return *this;
+        }
+
+        inline logger& buffer_max_size(const std::size_t bufferMaxSize)
+        {
+            m_bufferMaxSize.store(bufferMaxSize);
+            return *this;
+        }
+
+        inline logger& buffer_flush_size(const std::size_t bufferFlushSize)
+        {
+            m_bufferFlushSize.store(bufferFlushSize);
+            m_loggingCondition.notify_one(); // wake the logging thread
+            return *this;
+        }
+
+        inline logger& overflow_policy(const log_overflow overflowPolicy)
+        {
+            m_overflowPolicy.store(overflowPolicy);
+            return *this;
+        }
+
+        inline logger& overflow_timeout(const std::chrono::milliseconds overflowTimeout)
+        {
+            m_overflowTimeout.store(overflowTimeout);
+            return *this;
+        }
+
+        inline logger& overflow_level(const log_level overflowLevel)
+        {
+            m_overflowLevel.store(overflowLevel);
+            return *this;
+        }
+
+        inline logger& overflow_file(const std::string& overflowFile)
+        {
+            const std::unique_lock<std::mutex> lock{ m_configMutex };
+            m_overflowFile = overflowFile;
+            return *this;
+        }
+
+        logger& writer_threads(const std::size_t writerThreads)
+        {
+            std::unique_ptr<pluto::thread_pool> writerPool{};
+            if (writerThreads != 0)
+            {
+                // Writes that were given to the pool are finished before it's destroyed
+                writerPool.reset(new pluto::thread_pool{ writerThreads });
+                writerPool->on_stop(pluto::thread_pool::action::complete_tasks);
+            }
+
+            set_writer_pool(writerPool, writerPool.get());
+            return *this;
+        }
+
+        inline logger& writer_pool(pluto::thread_pool* const writerPool)
+        {
+            std::unique_ptr<pluto::thread_pool> ownWriterPool{};
+            set_writer_pool(ownWriterPool, writerPool);
+            return *this;
+        }
+
+        inline logger& flush_interval(const std::chrono::milliseconds flushInterval)
+        {
+            m_flushInterval.store(flushInterval);
+            m_loggingCondition.notify_one(); // wake the logging thread
+            return *this;
+        }
+
+        inline logger& deferred_formatting(const bool deferFormatting)
+        {
+            m_deferFormatting.store(deferFormatting);
+            return *this;
+        }
+
+        inline logger& binary_mode(const bool binaryMode)
+        {
+            m_binaryMode.store(binaryMode);
+            return *this;
+        }
+
+        inline logger& field_format(const log_fields fieldFormat)
+        {
+            m_fieldFormat.store(fieldFormat);
+            return *this;
+        }
+
+        inline logger& thread_buffer_size(const std::size_t threadBufferSize)
+        {
+            m_threadBufferSize.store(threadBufferSize);
+            return *this;
+        }
+
+        inline logger& sync_policy(const log_sync syncPolicy)
+        {
+            m_syncPolicy.store(syncPolicy);
+            m_loggingCondition.notify_one(); // wake the logging thread
+            return *this;
+        }
+
+        inline logger& sync_interval(const std::chrono::milliseconds syncInterval)
+        {
+            m_syncInterval.store(syncInterval);
+            m_loggingCondition.notify_one(); // wake the logging thread
+            return *this;
+        }
+
+        inline logger& file_check_interval(const std::chrono::milliseconds fileCheckInterval)
+        {
+            m_fileCheckInterval.store(fileCheckInterval);
+            return *this;
+        }
+
+        // Staging files are opened, reopened or closed by the next log to their file
+        inline logger& staging_size(const std::size_t stagingSize)
+        {
+            m_stagingSize.store(stagingSize);
+            return *this;
+        }
+
+        // Open files are reopened on their next write
+        inline logger& file_mapping_size(const std::size_t fileMappingSize)
+        {
+            m_fileMappingSize.store(fileMappingSize);
+            return *this;
+        }
+
+        inline logger& file_rotation_size(const std::size_t fileRotationSize)
+        {
+            m_fileRotationSize.store(fileRotationSize);
+            return *this;
+        }
+
+        inline logger& file_rotation_limit(const std::size_t fileRotationLimit)
+        {
+            m_fileRotationLimit.store(fileRotationLimit);
+            return *this;
+        }
+
+        // Applies to files opened after this call
+        inline logger& file_rotation_period(const log_period fileRotationPeriod)
+        {
+            m_fileRotationPeriod.store(fileRotationPeriod);
+            return *this;
+        }
+
+        inline logger& file_rotation_naming(const log_naming fileRotationNaming)
+        {
+            m_fileRotationNaming.store(fileRotationNaming);
+            return *this;
+        }
+
+        inline logger& file_rotation_compress(const bool fileRotationCompress)
+        {
+            m_fileRotationCompress.store(fileRotationCompress);
+            return *this;
+        }
+
+        inline logger& reset_num_discarded_logs()
+        {
+            m_numDiscardedLogs.store(0);
+            return *this;
+        }
+
+        // Buffer depths start again from the number of logs in each buffer
+        logger& reset_stats()
+        {
+            {
+                const std::unique_lock<std::mutex> lock{ m_loggingMutex };
+
+                for (auto& logFilePair : m_logFiles)
+                {
+                    auto& logFile   { logFilePair.second };
+                    auto& counters  { logFile.counters };
+
+                    {
+                        const std::unique_lock<std::mutex> fileLock{ logFile.mutex };
+                        logFile.numEnqueued = 0;
+                        logFile.maxBufferDepth = logFile.buffer.size();
+                    }
+
+                    counters.numRecords.store(0);
+                    counters.numBytes.store(0);
+                    counters.numFlushes.store(0);
+                    counters.numRotations.store(0);
+                    counters.rotationTime.store(0);
+
+                    for (auto& flushLatency : counters.flushLatencies)
+                    {
+                        flushLatency.store(0);
+                    }
+                }
+            }
+
+            {
+                const std::unique_lock<std::mutex> lock{ m_lockCountersMutex };
+                m_resetLockTotals = total_lock_counters();
+            }
+
+            m_numDiscardedLogs.store(0);
+            return *this;
+        }
+
+        // Clears the log appender, so the new log writer is used
+        inline logger& log_writer(const std::function<void(std::ostream&, const log_entry&)>& logWriter)
+        {
+            const std::unique_lock<std::mutex> lock{ m_configMutex };
+            m_logWriter = logWriter;
+            m_logAppender = nullptr;
+            return *this;
+        }
+
+        // Clears the header appender, so the new header writer is used
+        inline logger& header_writer(const std::function<void(std::ostream&)>& headerWriter)
+        {
+            const std::unique_lock<std::mutex> lock{ m_configMutex };
+            m_headerWriter = headerWriter;
+            m_headerAppender = nullptr;
+            return *this;
+        }
+
+        // Takes priority over the log writer, unless empty
+        inline logger& log_appender(const std::function<void(std::string&, const log_entry&)>& logAppender)
+        {
+            const std::unique_lock<std::mutex> lock{ m_configMutex };
+            m_logAppender = logAppender;
+            return *this;
+        }
+
+        // Takes priority over the header writer, unless empty
+        inline logger& header_appender(const std::function<void(std::string&)>& headerAppender)
+        {
+            const std::unique_lock<std::mutex> lock{ m_configMutex };
+            m_headerAppender = headerAppender;
+            return *this;
+        }
+
+        PLUTO_UTILS_NODISCARD inline bool should_log(const log_level logLevel) const
+        {
+            return (is_logging() && level() <= logLevel);
+        }
+
+        // Looks up or adds the log file once, rather than on each log
+        PLUTO_UTILS_NODISCARD file_handle open(const std::string& logFile)
+        {
+            const auto lock{ lock_and_time(m_loggingMutex) };
+            return file_handle{ &get_log_file(logFile) };
+        }
+
+        void write(
+            const std::string&  logFile,
+            const log_level     logLevel,
+            const source_info   sourceInfo,
+            const std::string&  message)
+        {
+            if (should_log(logLevel))
+            {
+                add_log_to_buffer(find_log_file(logFile), logLevel, sourceInfo, message);
+            }
+        }
+
+        void write(
+            const file_handle   logFile,
+            const log_level     logLevel,
+            const source_info   sourceInfo,
+            const std::string&  message)
+        {
+            if (logFile && should_log(logLevel))
+            {
+                add_log_to_buffer(*logFile.m_logFile, logLevel, sourceInfo, message);
+            }
+        }
+
+#if PLUTO_LOGGER_HIDE_SOURCE_INFO
+        inline void write(
+            const std::string&  logFile,
+            const log_level     logLevel,
+            const std::string&  message)
+        {
+            write(logFile, logLevel, { "", 0, "" }, message);
+        }
+
+        inline void write(
+            const file_handle   logFile,
+            const log_level     logLevel,
+            const std::string&  message)
+        {
+            write(logFile, logLevel, { "", 0, "" }, message);
+        }
+#endif
+
+        template<class... Args>
+        void writef(
+            const std::string&  logFile,
+            const log_level     logLevel,
+            const source_info   sourceInfo,
+            const char* const   scheme,
+            const Args&...      args)
+        {
+            if (should_log(logLevel))
+            {
+                add_printf_log(find_log_file(logFile), logLevel, sourceInfo, scheme, args...);
+            }
+        }
+
+        template<class... Args>
+        void writef(
+            const file_handle   logFile,
+            const log_level     logLevel,
+            const source_info   sourceInfo,
+            const char* const   scheme,
+            const Args&...      args)
+        {
+            if (logFile && should_log(logLevel))
+            {
+                add_printf_log(*logFile.m_logFile, logLevel, sourceInfo, scheme, args...);
+            }
+        }
+
+#if PLUTO_LOGGER_HIDE_SOURCE_INFO
+        template<class... Args>
+        inline void writef(
+            const std::string&  logFile,
+            const log_level     logLevel,
+            const char* const   scheme,
+            Args&&...           args)
+        {
+            writef(logFile, logLevel, { "", 0, "" }, scheme, std::forward<Args>(args)...);
+        }
+
+        template<class... Args>
+        inline void writef(
+            const file_handle   logFile,
+            const log_level     logLevel,
+            const char* const   scheme,
+            Args&&...           args)
+        {
+            writef(logFile, logLevel, { "", 0, "" }, scheme, std::forward<Args>(args)...);
+        }
+#endif
+
+#if PLUTO_UTILS_HAS_FORMAT
+        template<class... Args>
+        void format(
+            const std::string&                  logFile,
+            const log_level                     logLevel,
+            const source_info                   sourceInfo,
+            const std::format_string<Args...>   scheme,
+            Args&&...                           args)
+        {
+            if (should_log(logLevel))
+            {
+                add_format_log(find_log_file(logFile), logLevel, sourceInfo, scheme.get(), args...);
+            }
+        }
+
+        template<class... Args>
+        void format(
+            const file_handle                   logFile,
+            const log_level                     logLevel,
+            const source_info                   sourceInfo,
+            const std::format_string<Args...>   scheme,
+            Args&&...                           args)
+        {
+            if (logFile && should_log(logLevel))
+            {
+                add_format_log(*logFile.m_logFile, logLevel, sourceInfo, scheme.get(), args...);
+            }
+        }
+
+#if PLUTO_LOGGER_HIDE_SOURCE_INFO
+        template<class... Args>
+        inline void format(
+            const std::string&                  logFile,
+            const log_level                     logLevel,
+            const std::format_string<Args...>   scheme,
+            Args&&...                           args)
+        {
+            format(logFile, logLevel, { "", 0, "" }, scheme, std::forward<Args>(args)...);
+        }
+
+        template<class... Args>
+        inline void format(
+            const file_handle                   logFile,
+            const log_level                     logLevel,
+            const std::format_string<Args...>   scheme,
+            Args&&...                           args)
+        {
+            format(logFile, logLevel, { "", 0, "" }, scheme, std::forward<Args>(args)...);
+        }
+#endif
+#endif
+
+        template<class... Values>
+        void write_kv(
+            const std::string&              logFile,
+            const log_level                 logLevel,
+            const source_info               sourceInfo,
+            const char* const               message,
+            const log_field<Values>&...     fields)
+        {
+            if (should_log(logLevel))
+            {
+                add_kv_log(find_log_file(logFile), logLevel, sourceInfo, message, fields...);
+            }
+        }
+
+        template<class... Values>
+        void write_kv(
+            const file_handle               logFile,
+            const log_level                 logLevel,
+            const source_info               sourceInfo,
+            const char* const               message,
+            const log_field<Values>&...     fields)
+        {
+            if (logFile && should_log(logLevel))
+            {
+                add_kv_log(*logFile.m_logFile, logLevel, sourceInfo, message, fields...);
+            }
+        }
+
+#if PLUTO_LOGGER_HIDE_SOURCE_INFO
+        template<class... Values>
+        inline void write_kv(
+            const std::string&              logFile,
+            const log_level                 logLevel,
+            const char* const               message,
+            const log_field<Values>&...     fields)
+        {
+            write_kv(logFile, logLevel, { "", 0, "" }, message, fields...);
+        }
+
+        template<class... Values>
+        inline void write_kv(
+            const file_handle               logFile,
+            const log_level                 logLevel,
+            const char* const               message,
+            const log_field<Values>&...     fields)
+        {
+            write_kv(logFile, logLevel, { "", 0, "" }, message, fields...);
+        }
+#endif
+
+        PLUTO_UTILS_NODISCARD inline streamer stream(
+            const std::string&  logFile,
+            const log_level     logLevel,
+#if PLUTO_LOGGER_HIDE_SOURCE_INFO
+            const source_info   sourceInfo = { "", 0, "" })
+#else
+            const source_info   sourceInfo)
+#endif
+        {
+            // Logs that won't be written don't add the file
+            return { this, (should_log(logLevel) ? &find_log_file(logFile) : nullptr), logLevel, sourceInfo };
+        }
+
+        PLUTO_UTILS_NODISCARD inline streamer stream(
+            const file_handle   logFile,
+            const log_level     logLevel,
+#if PLUTO_LOGGER_HIDE_SOURCE_INFO
+            const source_info   sourceInfo = { "", 0, "" })
+#else
+            const source_info   sourceInfo)
+#endif
+        {
+            return { this, logFile.m_logFile, logLevel, sourceInfo };
+        }
+
+    private:
+        static std::string create_message(const char* const scheme, ...)
+        {
+            std::string message{};
+            bool messageCreated{ false };
+            std::va_list args, argsCopy;
+
+            va_start(args, scheme);
+            va_copy(argsCopy, args);
+
+            try
+            {
+                // Create message from scheme and args
+                auto messageLength{ std::vsnprintf(nullptr, 0, scheme, args) };
+                if (0 < messageLength)
+                {
+                    message.resize(messageLength + 1);
+                    if (std::vsnprintf(&message[0], message.size(), scheme, argsCopy) == messageLength)
+                    {
+                        message.resize(messageLength);
+                        messageCreated = true;
+                    }
+                }
+            }
+            catch (...) {}
+
+            va_end(args);
+            va_end(argsCopy);
+
+            // If message creation failed, use scheme
+            if (!messageCreated)
+            {
+                message.assign(scheme);
+            }
+
+            return message;
+        }
+
+        // Appends an integer right aligned to the width, like std::setw with std::right
+        template<class Integer>
+        static void append_integer(std::string& line, const Integer value, const std::size_t width, const char fill)
+        {
+            char digits[24];
+            char* pDigit{ digits + sizeof(digits) };
+
+            const bool isNegative{ value < 0 };
+            auto magnitude{ static_cast<unsigned long long>(value) };
+            if (isNegative)
+            {
+                magnitude = (0 - magnitude);
+            }
+
+            do
+            {
+                *--pDigit = static_cast<char>('0' + (magnitude % 10));
+                magnitude /= 10;
+            }
+            while (magnitude != 0);
+
+            const auto numDigits{ static_cast<std::size_t>((digits + sizeof(digits)) - pDigit) + (isNegative ? 1 : 0) };
+
+            if (numDigits < width)
+            {
+                line.append(width - numDigits, fill);
+            }
+
+            if (isNegative)
+            {
+                line.push_back('-');
+            }
+
+            line.append(pDigit, digits + sizeof(digits));
+        }
+
+        // Appends up to width characters left aligned to the width, like std::setw with std::left on a truncated string
+        static void append_padded(std::string& line, const char* const text, const std::size_t width)
+        {
+            std::size_t size{ 0 };
+            while (size < width && text[size] != '\0')
+            {
+                ++size;
+            }
+
+            line.append(text, size);
+            line.append(width - size, ' ');
+        }
+
+        static void append_source(std::string& line, const source_info& source)
+        {
+            append_padded(line, pluto::file_name(source.file), 20);
+            line.push_back('|');
+            append_integer(line, source.line, 5, ' ');
+            line.push_back('|');
+            append_padded(line, source.function, 20);
+            line.push_back('|');
+        }
+
+        static std::size_t next_id()
+        {
+            static std::atomic_size_t id{ 0 };
+            return ++id;
+        }
+
+        std::shared_ptr<thread_buffer>& get_thread_buffer(const std::size_t threadBufferSize)
+        {
+            // Loggers are identified by id rather than address, since a new logger could reuse the address of an old one
+            thread_local std::vector<std::pair<std::size_t, std::shared_ptr<thread_buffer>>> threadBuffers{};
+
+            auto it{ threadBuffers.begin() };
+            while (it != threadBuffers.end() && it->first != m_id)
+            {
+                ++it;
+            }
+
+            if (it == threadBuffers.end())
+            {
+                it = threadBuffers.emplace(threadBuffers.end(), m_id, nullptr);
+            }
+
+            auto& threadBuffer{ it->second };
+            if (!threadBuffer || threadBuffer->entries.size() != threadBufferSize)
+            {
+                // A resized thread buffer replaces the old one, which the logging thread drains first
+                threadBuffer = std::make_shared<thread_buffer>(threadBufferSize);
+
+                const std::unique_lock<std::mutex> lock{ m_loggingMutex };
+                m_threadBuffers.push_back(threadBuffer);
+            }
+
+            return threadBuffer;
+        }
+
+        log_file& get_log_file(const std::string& logFile)
+        {
+            auto it{ m_logFiles.find(logFile) };
+            if (it == m_logFiles.end())
+            {
+                it = m_logFiles.emplace(std::piecewise_construct, std::forward_as_tuple(logFile), std::forward_as_tuple()).first;
+                it->second.name = logFile;
+            }
+
+            return it->second;
+        }
+
+        log_file& find_log_file(const std::string& logFile)
+        {
+            // Thread buffers remember the last file, so logging to the same file again doesn't lock
+            const auto threadBufferSize{ thread_buffer_size() };
+            if (threadBufferSize != 0)
+            {
+                auto& threadBuffer{ *get_thread_buffer(threadBufferSize) };
+
+                if (!threadBuffer.lastFile || threadBuffer.lastFileName != logFile)
+                {
+                    const auto lock{ lock_and_time(m_loggingMutex) };
+                    threadBuffer.lastFile = &get_log_file(logFile);
+                    threadBuffer.lastFileName = logFile;
+                }
+
+                return *threadBuffer.lastFile;
+            }
+
+            const auto lock{ lock_and_time(m_loggingMutex) };
+            return get_log_file(logFile);
+        }
+
+        // Calling threads count the locks they wait for in their own counters, and time a sample of the waits.
+        // Only locks that are already taken are counted, so the usual case costs nothing extra.
+        std::unique_lock<std::mutex> lock_and_time(std::mutex& mutex)
+        {
+            std::unique_lock<std::mutex> lock{ mutex, std::try_to_lock };
+            if (!lock.owns_lock())
+            {
+                auto& counters{ get_lock_counters() };
+                const auto numWaits{ counters.numWaits.load(std::memory_order_relaxed) };
+                counters.numWaits.store(numWaits + 1, std::memory_order_relaxed);
+
+                if (numWaits % lock_counters::sample_rate != 0)
+                {
+                    lock.lock();
+                    return lock;
+                }
+
+                const auto waitStart{ std::chrono::steady_clock::now() };
+                lock.lock();
+
+                lock_counters::add(counters.waitTime, static_cast<std::int64_t>(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - waitStart).count()));
+                lock_counters::add(counters.numTimed, std::size_t{ 1 });
+            }
+
+            return lock;
+        }
+
+        lock_counters& get_lock_counters()
+        {
+            thread_local std::vector<std::pair<std::size_t, std::shared_ptr<lock_counters>>> threadCounters{};
+
+            auto it{ threadCounters.begin() };
+            while (it != threadCounters.end() && it->first != m_id)
+            {
+                ++it;
+            }
+
+            if (it == threadCounters.end())
+            {
+                it = threadCounters.emplace(threadCounters.end(), m_id, std::make_shared<lock_counters>());
+
+                const std::unique_lock<std::mutex> lock{ m_lockCountersMutex };
+                m_lockCounters.push_back(it->second);
+            }
+
+            return *it->second;
+        }
+
+        // Requires the lock counters mutex to be locked. Counters of threads that have exited are added up once and let go.
+        lock_totals total_lock_counters() const
+        {
+            auto totals{ m_exitedLockTotals };
+            for (auto it{ m_lockCounters.begin() }; it != m_lockCounters.end(); )
+            {
+                if (it->use_count() == 1)
+                {
+                    m_exitedLockTotals.add(**it);
+                    totals.add(**it);
+                    it = m_lockCounters.erase(it);
+                }
+                else
+                {
+                    totals.add(**it);
+                    ++it;
+                }
+            }
+
+            return totals;
+        }
+
+        // Requires the file's mutex to be locked
+        static inline void count_enqueued_log(log_file& logFile)
+        {
+            ++logFile.numEnqueued;
+            logFile.maxBufferDepth = (std::max)(logFile.maxBufferDepth, logFile.buffer.size());
+        }
+
+        // The old pool is swapped out and destroyed by the caller after unlocking, since its writes lock this mutex when they finish
+        void set_writer_pool(std::unique_ptr<pluto::thread_pool>& ownWriterPool, pluto::thread_pool* const writerPool)
+        {
+            const std::unique_lock<std::mutex> lock{ m_loggingMutex };
+            m_ownWriterPool.swap(ownWriterPool);
+            m_writerPool = writerPool;
+        }
+
+        // Written by a writer thread, rather than the logging thread
+        void write_pending_logs(const std::string& fileName, log_file& logFile)
+        {
+            write_buffer_to_file(fileName, logFile);
+
+            const std::unique_lock<std::mutex> lock{ m_loggingMutex };
+
+            if (logFile.numWritten == logFile.pending.size())
+            {
+                logFile.pending.clear();
+                logFile.numWritten = 0;
+            }
+
+            logFile.isWriting = false;
+            --m_numWriting;
+
+            // Logs may have been added to the file while it was being written
+            m_hasPendingLogs.store(true);
+            m_loggingCondition.notify_one();
+        }
+
+        // Only the first log after a flush starts the flush timer, so logs don't wake the logging thread one by one
+        inline bool should_start_flush_timer()
+        {
+            return (flush_interval().count() != 0 && !m_hasFlushTimer.exchange(true));
+        }
+
+        void wake_logging_thread()
+        {
+            m_hasPendingLogs.store(true);
+
+            // Only lock when the logging thread is waiting, otherwise it will see the pending logs
+            if (m_isWaiting.load())
+            {
+                {
+                    const std::unique_lock<std::mutex> lock{ m_loggingMutex };
+                }
+
+                m_loggingCondition.notify_one();
+            }
+        }
+
+        template<class MessageWriter>
+        void add_log_to_thread_buffer(
+            log_file&           logFile,
+            const log_level     logLevel,
+            const source_info   sourceInfo,
+            const log_renderer  renderer,
+            const std::size_t   messageSize,
+            MessageWriter&&     writeMessage,
+            const std::size_t   threadBufferSize)
+        {
+            const auto logTime  { clock_type::now() };
+            const auto threadID { pluto::thread_id() };
+
+            auto& threadBuffer{ *get_thread_buffer(threadBufferSize) };
+
+            const auto tail{ threadBuffer.tail.load(std::memory_order_relaxed) };
+            auto size{ tail - threadBuffer.head.load(std::memory_order_acquire) };
+
+            if (size == threadBufferSize)
+            {
+                switch (overflow_policy())
+                {
+                    case log_overflow::block:
+                    {
+                        if (!wait_for_thread_buffer(threadBuffer, tail, threadBufferSize))
+                        {
+                            ++m_numDiscardedLogs;
+                            return;
+                        }
+
+                        size = tail - threadBuffer.head.load(std::memory_order_acquire);
+                        break;
+                    }
+                    case log_overflow::discard_by_level:
+                    {
+                        // Logs that are kept skip the thread buffer
+                        if (overflow_level() <= logLevel)
+                        {
+                            add_log_to_file_buffer(logFile, logTime, threadID, logLevel, sourceInfo, renderer, messageSize, writeMessage);
+                        }
+                        else
+                        {
+                            ++m_numDiscardedLogs;
+                        }
+
+                        return;
+                    }
+                    case log_overflow::spill:
+                    {
+                        spill_log(logFile, logTime, threadID, logLevel, sourceInfo, renderer, messageSize, writeMessage);
+                        return;
+                    }
+                    default:
+                    {
+                        // Thread buffer is full, discard log. The oldest logs belong to the logging thread.
+                        ++m_numDiscardedLogs;
+                        return;
+                    }
+                }
+            }
+
+            auto& entry{ threadBuffer.entries[tail % threadBufferSize] };
+            entry.time      = logTime;
+            entry.threadID  = threadID;
+            entry.level     = logLevel;
+            entry.source    = sourceInfo;
+            entry.file      = &logFile;
+            entry.renderer  = renderer;
+            entry.message.resize(messageSize);
+            writeMessage(&entry.message[0]);
+
+            threadBuffer.tail.store(tail + 1, std::memory_order_release);
+
+            // Wake the logging thread, even if the flush size is bigger than the thread buffer
+            if (buffer_flush_size() <= (size + 1) || (size + 1) == threadBufferSize || should_start_flush_timer())
+            {
+                wake_logging_thread();
+            }
+        }
+
+        // Requires m_loggingMutex to be locked
+        void drain_thread_buffers()
+        {
+            for (auto it{ m_threadBuffers.begin() }; it != m_threadBuffers.end(); )
+            {
+                auto& threadBuffer  { **it };
+                const auto size     { threadBuffer.entries.size() };
+                const auto head     { threadBuffer.head.load(std::memory_order_relaxed) };
+                const auto tail     { threadBuffer.tail.load(std::memory_order_acquire) };
+                const auto maxSize  { buffer_max_size() };
+
+                // Consecutive logs are usually to the same file, so keep its lock until the file changes
+                std::unique_lock<std::mutex> fileLock{};
+
+                for (auto i{ head }; i != tail; ++i)
+                {
+                    auto& entry{ threadBuffer.entries[i % size] };
+
+                    if (fileLock.mutex() != &entry.file->mutex)
+                    {
+                        fileLock = std::unique_lock<std::mutex>{ entry.file->mutex };
+                    }
+
+                    auto& buffer        { entry.file->buffer };
+                    const auto& message { entry.message };
+                    const auto writeMessage = [&message](char* const dest) { std::memcpy(dest, message.data(), message.size()); };
+
+                    if (maxSize != 0 && maxSize <= buffer.size())
+                    {
+                        // Logs in thread buffers were already accepted, so blocking keeps them
+                        const auto overflowPolicy{ overflow_policy() };
+
+                        if (overflowPolicy == log_overflow::discard_oldest)
+                        {
+                            buffer.pop_front();
+                            ++m_numDiscardedLogs;
+                        }
+                        else if (overflowPolicy == log_overflow::spill)
+                        {
+                            spill_log(*entry.file, entry.time, entry.threadID, entry.level, entry.source, entry.renderer, message.size(), writeMessage);
+                            continue;
+                        }
+                        else if (overflowPolicy == log_overflow::discard ||
+                            (overflowPolicy == log_overflow::discard_by_level && entry.level < overflow_level()))
+                        {
+                            ++m_numDiscardedLogs;
+                            continue;
+                        }
+                    }
+
+                    push_log(*entry.file, entry.time, entry.threadID, entry.level, entry.source, entry.renderer, message.size(), writeMessage);
+                }
+
+                threadBuffer.head.store(tail, std::memory_order_release);
+
+                // Remove thread buffers that have been released by their thread and fully drained
+                if (it->use_count() == 1 && threadBuffer.tail.load(std::memory_order_acquire) == tail)
+                {
+                    it = m_threadBuffers.erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+        }
+
+        template<class... Args>
+        void add_deferred_log_to_buffer(
+            const log_renderer  renderer,
+            log_file&           logFile,
+            const log_level     logLevel,
+            const source_info   sourceInfo,
+            const char* const   scheme,
+            const std::size_t   schemeSize,
+            const bool          isSchemeStatic,
+            const Args&...      args)
+        {
+            // Schemes that might not outlive the log are copied
+            const auto schemeArgSize{ isSchemeStatic ? log_args::static_string_size() : log_args::string_size(schemeSize) };
+
+            add_log_to_buffer(logFile, logLevel, sourceInfo, renderer, (schemeArgSize + log_args::size(args...)),
+                [&](char* dest)
+                {
+                    if (isSchemeStatic)
+                    {
+                        dest = log_args::write_static_string(dest, scheme, schemeSize);
+                    }
+                    else
+                    {
+                        dest = log_args::write(dest, scheme);
+                    }
+
+                    log_args::write(dest, args...);
+                }
+            );
+        }
+
+        // Fields are always stored as args and rendered by the thread that writes them
+        template<class... Values>
+        void add_kv_log(
+            log_file&                       logFile,
+            const log_level                 logLevel,
+            const source_info               sourceInfo,
+            const char* const               message,
+            const log_field<Values>&...     fields)
+        {
+            static_assert(log_args::are_deferrable<log_field<Values>...>::value,
+                "Field values must be bools, characters, numbers, strings or pointers");
+
+            const auto messageSize  { (message ? std::strlen(message) : 0) };
+            const auto renderer     { (field_format() == log_fields::json) ? &log_args::render_json : &log_args::render_logfmt };
+
+            add_log_to_buffer(logFile, logLevel, sourceInfo, renderer, (log_args::string_size(messageSize) + log_args::size(fields...)),
+                [&](char* dest)
+                {
+                    dest = log_args::write_string(dest, message, messageSize);
+                    log_args::write(dest, fields...);
+                }
+            );
+        }
+
+        template<class... Args>
+        void add_printf_log(
+            log_file&           logFile,
+            const log_level     logLevel,
+            const source_info   sourceInfo,
+            const char* const   scheme,
+            const Args&...      args)
+        {
+            if (deferred_formatting() || binary_mode())
+            {
+                // Falls back to formatting now if any arg can't be deferred
+                add_printf_log_to_buffer(log_args::are_deferrable<Args...>{}, logFile, logLevel, sourceInfo, scheme, args...);
+            }
+            else
+            {
+                add_log_to_buffer(logFile, logLevel, sourceInfo, create_message(scheme, args...));
+            }
+        }
+
+        template<class... Args>
+        inline void add_printf_log_to_buffer(
+            std::true_type,
+            log_file&           logFile,
+            const log_level     logLevel,
+            const source_info   sourceInfo,
+            const char* const   scheme,
+            const Args&...      args)
+        {
+            add_printf_args_to_buffer(std::index_sequence_for<Args...>{}, logFile, logLevel, sourceInfo, scheme, args...);
+        }
+
+        template<std::size_t... Indexes, class... Args>
+        void add_printf_args_to_buffer(
+            std::index_sequence<Indexes...>,
+            log_file&           logFile,
+            const log_level     logLevel,
+            const source_info   sourceInfo,
+            const char* const   scheme,
+            const Args&...      args)
+        {
+            log_args::printf_capture captures[sizeof...(Args) + 1]{};
+
+            if (log_args::has_c_string<Args...>::value)
+            {
+                const long long integers[]{ 0, log_args::to_integer(args)... };
+                if (!log_args::capture_printf_strings(scheme, (integers + 1), captures, sizeof...(Args)))
+                {
+                    // A string with no conversion might not be terminated, so the message is formatted now like printf would
+                    add_log_to_buffer(logFile, logLevel, sourceInfo, create_message(scheme, args...));
+                    return;
+                }
+            }
+
+            add_deferred_log_to_buffer(&log_args::render_printf, logFile, logLevel, sourceInfo, scheme, std::strlen(scheme), false,
+                log_args::capture(args, captures[Indexes])...);
+        }
+
+        template<class... Args>
+        inline void add_printf_log_to_buffer(
+            std::false_type,
+            log_file&           logFile,
+            const log_level     logLevel,
+            const source_info   sourceInfo,
+            const char* const   scheme,
+            const Args&...      args)
+        {
+            add_log_to_buffer(logFile, logLevel, sourceInfo, create_message(scheme, args...));
+        }
+
+#if PLUTO_UTILS_HAS_FORMAT
+        template<class... Args>
+        void add_format_log(
+            log_file&               logFile,
+            const log_level         logLevel,
+            const source_info       sourceInfo,
+            const std::string_view  scheme,
+            Args&...                args)
+        {
+            if (deferred_formatting() || binary_mode())
+            {
+                // Falls back to formatting now if any arg can't be deferred
+                add_format_log_to_buffer(log_args::are_deferrable<Args...>{}, logFile, logLevel, sourceInfo, scheme, args...);
+            }
+            else
+            {
+                add_log_to_buffer(logFile, logLevel, sourceInfo, std::vformat(scheme, std::make_format_args(args...)));
+            }
+        }
+
+        template<class... Args>
+        inline void add_format_log_to_buffer(
+            std::true_type,
+            log_file&           logFile,
+            const log_level     logLevel,
+            const source_info   sourceInfo,
+            const std::string_view scheme,
+            Args&...            args)
+        {
+            // Format strings are checked at compile time, so they outlive the log
+            add_deferred_log_to_buffer(&log_args::render_format, logFile, logLevel, sourceInfo, scheme.data(), scheme.size(), true, args...);
+        }
+
+        template<class... Args>
+        inline void add_format_log_to_buffer(
+            std::false_type,
+            log_file&           logFile,
+            const log_level     logLevel,
+            const source_info   sourceInfo,
+            const std::string_view scheme,
+            Args&...            args)
+        {
+            add_log_to_buffer(logFile, logLevel, sourceInfo, std::vformat(scheme, std::make_format_args(args...)));
+        }
+#endif
+
+        inline void add_log_to_buffer(
+            log_file&           logFile,
+            const log_level     logLevel,
+            const source_info   sourceInfo,
+            const std::string&  message)
+        {
+            add_log_to_buffer(logFile, logLevel, sourceInfo, nullptr, message.size(),
+                [&message](char* const dest) { std::memcpy(dest, message.data(), message.size()); });
+        }
+
+        template<class MessageWriter>
+        void add_log_to_buffer(
+            log_file&           logFile,
+            const log_level     logLevel,
+            const source_info   sourceInfo,
+            const log_renderer  renderer,
+            const std::size_t   messageSize,
+            MessageWriter&&     writeMessage)
+        {
+            const auto threadBufferSize{ thread_buffer_size() };
+            if (threadBufferSize != 0)
+            {
+                add_log_to_thread_buffer(logFile, logLevel, sourceInfo, renderer, messageSize, writeMessage, threadBufferSize);
+                return;
+            }
+
+            add_log_to_file_buffer(logFile, clock_type::now(), pluto::thread_id(), logLevel, sourceInfo, renderer, messageSize, writeMessage);
+        }
+
+        template<class MessageWriter>
+        void add_log_to_file_buffer(
+            log_file&                   logFile,
+            const log_entry::time_type  logTime,
+            const std::size_t           threadID,
+            const log_level             logLevel,
+            const source_info           sourceInfo,
+            const log_renderer          renderer,
+            const std::size_t           messageSize,
+            MessageWriter&&             writeMessage)
+        {
+            // Only this file is locked, so logging to other files doesn't contend
+            auto lock{ lock_and_time(logFile.mutex) };
+
+            auto& buffer        { logFile.buffer };
+            auto bufferMaxSize  { buffer_max_size() };
+
+            if (bufferMaxSize != 0 && bufferMaxSize <= buffer.size())
+            {
+                switch (overflow_policy())
+                {
+                    case log_overflow::block:
+                    {
+                        // The logging thread writes full buffers, even if they're smaller than the flush size.
+                        // Other threads can fill the buffer again before this one wakes, so wake the logging thread each time.
+                        // The logging thread locks files while holding its own mutex, so this file is unlocked to wake it.
+                        const auto timeoutTime{ std::chrono::steady_clock::now() + overflow_timeout() };
+                        while (bufferMaxSize <= buffer.size() && is_logging())
+                        {
+                            lock.unlock();
+                            wake_logging_thread();
+                            lock.lock();
+
+                            if (buffer.size() < bufferMaxSize ||
+                                logFile.spaceCondition.wait_until(lock, timeoutTime) == std::cv_status::timeout)
+                            {
+                                break;
+                            }
+                        }
+
+                        if (bufferMaxSize <= buffer.size())
+                        {
+                            ++m_numDiscardedLogs;
+                            return;
+                        }
+
+                        break;
+                    }
+                    case log_overflow::discard_oldest:
+                    {
+                        buffer.pop_front();
+                        ++m_numDiscardedLogs;
+                        break;
+                    }
+                    case log_overflow::discard_by_level:
+                    {
+                        if (logLevel < overflow_level())
+                        {
+                            ++m_numDiscardedLogs;
+                            return;
+                        }
+
+                        break;
+                    }
+                    case log_overflow::spill:
+                    {
+                        lock.unlock();
+                        spill_log(logFile, logTime, threadID, logLevel, sourceInfo, renderer, messageSize, writeMessage);
+                        return;
+                    }
+                    default:
+                    {
+                        // Buffer is full, discard log
+                        ++m_numDiscardedLogs;
+                        return;
+                    }
+                }
+            }
+
+            push_log(logFile, logTime, threadID, logLevel, sourceInfo, renderer, messageSize, writeMessage);
+
+            if (buffer_flush_size() <= buffer.size() || should_start_flush_timer())
+            {
+                // Unlock the mutex and wake the logging thread
+                lock.unlock();
+                wake_logging_thread();
+            }
+        }
+
+        // Waits for the logging thread to make room in a full thread buffer. Returns false if there's still no room.
+        bool wait_for_thread_buffer(thread_buffer& threadBuffer, const std::size_t tail, const std::size_t threadBufferSize)
+        {
+            const auto timeoutTime{ std::chrono::steady_clock::now() + overflow_timeout() };
+            const auto has_room = [&]() { return ((tail - threadBuffer.head.load(std::memory_order_acquire)) < threadBufferSize); };
+
+            wake_logging_thread();
+
+            std::unique_lock<std::mutex> lock{ m_loggingMutex };
+            m_spaceCondition.wait_until(lock, timeoutTime, [&]() { return (has_room() || !is_logging()); });
+
+            return has_room();
+        }
+
+        // Writes a log straight to the overflow file, bypassing the buffers. Called when buffers are full.
+        template<class MessageWriter>
+        void spill_log(
+            log_file&                   logFile,
+            const log_entry::time_type  logTime,
+            const std::size_t           threadID,
+            const log_level             logLevel,
+            const source_info           sourceInfo,
+            const log_renderer          renderer,
+            const std::size_t           messageSize,
+            MessageWriter&&             writeMessage)
+        {
+            thread_local std::string    args    {};
+            thread_local std::string    output  {};
+            thread_local log_entry      entry   { {}, 0, log_level::off, { "", 0, "" }, {} };
+
+            entry.time      = logTime;
+            entry.thread_id = threadID;
+            entry.level     = logLevel;
+            entry.source    = sourceInfo;
+
+            if (renderer)
+            {
+                args.resize(messageSize);
+                writeMessage(&args[0]);
+                entry.message.clear();
+                renderer(entry.message, args.data(), args.size());
+            }
+            else
+            {
+                entry.message.resize(messageSize);
+                writeMessage(&entry.message[0]);
+            }
+
+            output.clear();
+
+            const auto logAppender{ log_appender() };
+            if (logAppender)
+            {
+                logAppender(output, entry);
+            }
+            else
+            {
+                std::ostringstream writerStream{};
+                log_writer()(writerStream, entry);
+                output.append(writerStream.str());
+            }
+
+            output.push_back('\n');
+
+            auto overflowFile{ overflow_file() };
+            if (overflowFile.empty())
+            {
+                overflowFile = logFile.name + ".overflow";
+            }
+
+            const std::unique_lock<std::mutex> lock{ m_spillMutex };
+
+            auto& file{ m_spillFiles[overflowFile] };
+            if (!(file.is_open() || file.open(overflowFile)) || file.write(output.data(), output.size()) != output.size())
+            {
+                ++m_numDiscardedLogs;
+            }
+        }
+
+        void open_file(log_file& logFile, const bool binaryMode) const
+        {
+            if (!logFile.file.open(logFile.filePath, file_mapping_size()))
+            {
+                throw pluto::filesystem::filesystem_error{
+                    "pluto::logger failed to open file", std::make_error_code(std::errc::io_error) };
+            }
+
+            // The size is only asked for once, after that it's tracked as logs are written
+            logFile.fileSize = logFile.file.size();
+            logFile.isBinary = binaryMode;
+            logFile.lastCheck = std::chrono::steady_clock::now();
+
+            const auto fileRotationPeriod{ file_rotation_period() };
+            logFile.rotationPeriod = fileRotationPeriod;
+
+            if (fileRotationPeriod != log_period::none)
+            {
+                const auto now{ std::time(nullptr) };
+                logFile.rotationTime = period_start(now, fileRotationPeriod, 1);
+
+                // A file left over from an earlier period is rotated before it's written to
+                if (logFile.fileSize != 0 && logFile.file.modified_time() < period_start(now, fileRotationPeriod, 0))
+                {
+                    logFile.rotationTime = now;
+                }
+            }
+        }
+
+        void close_file(log_file& logFile) const
+        {
+            if (logFile.file.is_open() && !logFile.isSynced && sync_policy() != log_sync::never)
+            {
+                logFile.file.sync();
+            }
+
+            logFile.file.close();
+            logFile.isSynced = true;
+        }
+
+        // Returns true if the file has logs that haven't been synced, and the sync policy says it's time
+        bool is_sync_due(const log_file& logFile, const bool force) const
+        {
+            if (logFile.isSynced || !logFile.file.is_open())
+            {
+                return false;
+            }
+
+            const auto syncPolicy{ sync_policy() };
+
+            return (syncPolicy != log_sync::never &&
+                (force || syncPolicy != log_sync::interval || logFile.lastSync + sync_interval() <= std::chrono::steady_clock::now()));
+        }
+
+        void sync_file(log_file& logFile, const bool force) const
+        {
+            if (!is_sync_due(logFile, force))
+            {
+                return;
+            }
+
+            logFile.file.sync();
+            logFile.isSynced = true;
+            logFile.lastSync = std::chrono::steady_clock::now();
+        }
+
+        // Returns the start of the period the time is in, or of a later period
+        static std::time_t period_start(const std::time_t time, const log_period period, const int numPeriodsLater)
+        {
+            auto localTime{ pluto::local_time(time) };
+            localTime.tm_sec = 0;
+            localTime.tm_min = 0;
+
+            if (period == log_period::daily)
+            {
+                localTime.tm_hour = 0;
+                localTime.tm_mday += numPeriodsLater;
+            }
+            else
+            {
+                localTime.tm_hour += numPeriodsLater;
+            }
+
+            localTime.tm_isdst = -1; // Worked out by mktime, in case the period crosses a daylight saving change
+            return std::mktime(&localTime);
+        }
+
+        static pluto::filesystem::path numbered_path(const pluto::filesystem::path& filePath, const std::size_t number, const std::string& suffix)
+        {
+            return (filePath.parent_path() / (filePath.stem().string() + "_" + std::to_string(number) + filePath.extension().string() + suffix));
+        }
+
+        // Names the file by the current time, adding a number if a file was already rotated this second
+        static pluto::filesystem::path timestamped_path(const pluto::filesystem::path& filePath)
+        {
+            const auto localTime{ pluto::local_time(std::time(nullptr)) };
+
+            char timestamp[32]{};
+            std::strftime(timestamp, sizeof(timestamp), "%Y%m%d_%H%M%S", &localTime);
+
+            const auto stem         { filePath.stem().string() + "_" + timestamp };
+            const auto extension    { filePath.extension().string() };
+            const auto parentPath   { filePath.parent_path() };
+
+            for (std::size_t i{ 0 }; ; ++i)
+            {
+                const auto thisPath{ parentPath / (stem + ((i == 0) ? "" : ("_" + std::to_string(i))) + extension) };
+
+                auto compressedPath{ thisPath };
+                compressedPath += ".gz";
+
+                if (!pluto::filesystem::exists(thisPath) && !pluto::filesystem::exists(compressedPath))
+                {
+                    return thisPath;
+                }
+            }
+        }
+
+        // Returns false if the file couldn't be read or the compressed file couldn't be written
+        static bool compress_file(const pluto::filesystem::path& filePath, const pluto::filesystem::path& compressedPath)
+        {
+            std::ifstream input{ filePath.c_str(), std::ios::binary };
+
+            gzip_writer writer{};
+            if (!input.is_open() || !writer.open(compressedPath))
+            {
+                return false;
+            }
+
+            std::vector<char> chunk(65536);
+
+            bool written{ true };
+            while (written && input)
+            {
+                input.read(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+                if (0 < input.gcount())
+                {
+                    written = writer.write(chunk.data(), static_cast<std::size_t>(input.gcount()));
+                }
+            }
+
+            return (writer.finish() && written && input.eof());
+        }
+
+        // Compressed to a temporary file first, so a file with the final name is always complete.
+        // The rotated file is kept if it can't be compressed.
+        static void compress_rotated_file(const pluto::filesystem::path& rotatedPath, const pluto::filesystem::path& compressedPath)
+        {
+            auto tempPath{ compressedPath };
+            tempPath += ".tmp";
+
+            std::error_code error{};
+            pluto::filesystem::remove(tempPath, error);
+
+            if (compress_file(rotatedPath, tempPath))
+            {
+                pluto::filesystem::rename(tempPath, compressedPath, error);
+                if (!error)
+                {
+                    pluto::filesystem::remove(rotatedPath, error);
+                    return;
+                }
+            }
+
+            pluto::filesystem::remove(tempPath, error);
+        }
+
+        // Moves numbered files up by one, newest first, removing any that would go past the limit
+        void shift_numbered_files(const pluto::filesystem::path& filePath, const std::string& suffix) const
+        {
+            const auto fileRotationLimit{ file_rotation_limit() };
+
+            std::size_t numFiles{ 0 };
+            for (std::size_t i{ 1 }; ; ++i)
+            {
+                const auto thisPath{ numbered_path(filePath, i, suffix) };
+
+                if (!pluto::filesystem::exists(thisPath))
+                {
+                    break;
+                }
+
+                if (i < fileRotationLimit)
+                {
+                    ++numFiles;
+                    continue;
+                }
+
+                pluto::filesystem::remove(thisPath);
+            }
+
+            for (auto i{ numFiles }; 0 < i; --i)
+            {
+                pluto::filesystem::rename(numbered_path(filePath, i, suffix), numbered_path(filePath, (i + 1), suffix));
+            }
+        }
+
+        // Timestamps sort by name, so the oldest files are removed first
+        void remove_old_timestamped_files(const pluto::filesystem::path& filePath) const
+        {
+            const auto stem         { filePath.stem().string() + "_" };
+            const auto extension    { filePath.extension().string() };
+
+            const auto is_digits = [](const std::string& text, const std::size_t begin, const std::size_t end)
+                {
+                    return (begin < end && end <= text.size() &&
+                        std::all_of((text.begin() + begin), (text.begin() + end), [](const char c) { return std::isdigit(static_cast<unsigned char>(c)) != 0; }));
+                };
+
+            // Sorted by timestamp, then by the number added for files rotated in the same second
+            std::vector<std::tuple<std::string, std::size_t, pluto::filesystem::path>> timestampedFiles{};
+
+            std::error_code error{};
+            for (pluto::filesystem::directory_iterator it{ filePath.parent_path(), error }, end{}; !error && it != end; it.increment(error))
+            {
+                auto name{ it->path().filename().string() };
+                if (3 < name.size() && name.compare(name.size() - 3, 3, ".gz") == 0)
+                {
+                    name.resize(name.size() - 3);
+                }
+
+                if (name.size() < stem.size() + 15 + extension.size() ||
+                    name.compare(0, stem.size(), stem) != 0 ||
+                    name.compare(name.size() - extension.size(), extension.size(), extension) != 0)
+                {
+                    continue;
+                }
+
+                // Date, time and an optional number, like 20240131_235959_1
+                const auto middle{ name.substr(stem.size(), (name.size() - stem.size() - extension.size())) };
+                if (!is_digits(middle, 0, 8) || middle[8] != '_' || !is_digits(middle, 9, 15) ||
+                    (middle.size() != 15 && (middle[15] != '_' || !is_digits(middle, 16, middle.size()))))
+                {
+                    continue;
+                }
+
+                const auto number{ (middle.size() == 15) ? 0 : std::stoull(middle.substr(16)) };
+                timestampedFiles.emplace_back(middle.substr(0, 15), static_cast<std::size_t>(number), it->path());
+            }
+
+            const auto fileRotationLimit{ file_rotation_limit() };
+            if (timestampedFiles.size() <= fileRotationLimit)
+            {
+                return;
+            }
+
+            std::sort(timestampedFiles.begin(), timestampedFiles.end());
+
+            for (std::size_t i{ 0 }; i < timestampedFiles.size() - fileRotationLimit; ++i)
+            {
+                pluto::filesystem::remove(std::get<2>(timestampedFiles[i]), error);
+            }
+        }
+
+        // Rotation tasks run one at a time and in order, so they never work on the same files at once
+        void run_rotation_task(const std::function<void()>& task)
+        {
+            const std::unique_lock<std::mutex> lock{ m_rotationMutex };
+
+            if (!m_rotationPool)
+            {
+                // Rotated files are finished before the pool is destroyed
+                m_rotationPool.reset(new pluto::thread_pool{ 1 });
+                m_rotationPool->on_stop(pluto::thread_pool::action::complete_tasks);
+            }
+
+            m_rotationPool->run_async([task]()
+                {
+                    try
+                    {
+                        task();
+                    }
+                    catch (const pluto::filesystem::filesystem_error&)
+                    {
+                        // Rotated files that can't be moved are left where they are
+                    }
+                });
+        }
+
+        // Only the closed file is renamed here, anything that takes longer is left to the rotation thread
+        void rotate_file(const pluto::filesystem::path& filePath)
+        {
+            const auto fileRotationNaming   { file_rotation_naming() };
+            const auto fileRotationCompress { file_rotation_compress() };
+
+            if (fileRotationNaming == log_naming::index && !fileRotationCompress)
+            {
+                shift_numbered_files(filePath, "");
+
+                if (file_rotation_limit() == 0)
+                {
+                    pluto::filesystem::remove(filePath);
+                }
+                else
+                {
+                    pluto::filesystem::rename(filePath, numbered_path(filePath, 1, ""));
+                }
+
+                return;
+            }
+
+            // Numbered files are compressed under a timestamped name, until the rotation thread gets to them
+            const auto rotatedPath{ timestamped_path(filePath) };
+            pluto::filesystem::rename(filePath, rotatedPath);
+
+            if (fileRotationNaming == log_naming::index)
+            {
+                run_rotation_task([this, filePath, rotatedPath]()
+                    {
+                        shift_numbered_files(filePath, ".gz");
+
+                        if (file_rotation_limit() == 0)
+                        {
+                            pluto::filesystem::remove(rotatedPath);
+                        }
+                        else
+                        {
+                            compress_rotated_file(rotatedPath, numbered_path(filePath, 1, ".gz"));
+                        }
+                    });
+            }
+            else
+            {
+                run_rotation_task([this, filePath, rotatedPath, fileRotationCompress]()
+                    {
+                        if (fileRotationCompress)
+                        {
+                            auto compressedPath{ rotatedPath };
+                            compressedPath += ".gz";
+
+                            compress_rotated_file(rotatedPath, compressedPath);
+                        }
+
+                        remove_old_timestamped_files(filePath);
+                    });
+            }
+        }
+
+        static inline std::size_t binary_file_header_size()
+        {
+            return (8 + sizeof(std::uint32_t) + (2 * sizeof(std::int64_t))); // Magic, version and clock period
+        }
+
+        static inline const char* binary_magic()
+        {
+            return "PLUTOLOG";
+        }
+
+        static constexpr std::uint32_t binary_version()
+        {
+            return 1;
+        }
+
+        static log_entry::time_type binary_time(const std::int64_t ticks, const std::int64_t periodNum, const std::int64_t periodDen)
+        {
+            typedef log_entry::time_type::duration duration;
+
+            if (periodNum == duration::period::num && periodDen == duration::period::den)
+            {
+                return log_entry::time_type{ duration{ static_cast<duration::rep>(ticks) } };
+            }
+
+            // Written by a different clock
+            const std::chrono::duration<long double> seconds{ static_cast<long double>(ticks) * periodNum / periodDen };
+            return log_entry::time_type{ std::chrono::duration_cast<duration>(seconds) };
+        }
+
+        template<class Value>
+        static inline void append_binary(std::string& record, const Value value)
+        {
+            record.append(reinterpret_cast<const char*>(&value), sizeof(value));
+        }
+
+        static inline void append_binary(std::string& record, const char* const string)
+        {
+            const auto length{ static_cast<std::uint32_t>(std::strlen(string)) };
+            append_binary(record, length);
+            record.append(string, length);
+        }
+
+        // Returns the offset of the record, which is needed to end it
+        static inline std::size_t begin_binary_record(std::string& output, const binary_record type)
+        {
+            const auto offset{ output.size() };
+            output.append(sizeof(std::uint32_t), '\0'); // Size is filled in at the end
+            output.push_back(static_cast<char>(type));
+            return offset;
+        }
+
+        static inline void end_binary_record(std::string& output, const std::size_t offset)
+        {
+            const auto recordSize{ static_cast<std::uint32_t>(output.size() - offset - sizeof(std::uint32_t)) };
+            std::memcpy(&output[offset], &recordSize, sizeof(recordSize));
+        }
+
+        static void append_binary_file_header(std::string& output)
+        {
+            typedef log_entry::time_type::duration::period period;
+
+            output.append(binary_magic());
+            append_binary(output, binary_version());
+            append_binary(output, static_cast<std::int64_t>(period::num));
+            append_binary(output, static_cast<std::int64_t>(period::den));
+        }
+
+        // Appends a log as a record, with any source info or scheme it uses appended first if they're new to the file
+        static void append_binary_log(std::string& output, log_file& logFile, const log_buffer::header& thisHeader)
+        {
+            auto& tables{ logFile.binary };
+
+            const auto& source{ thisHeader.source };
+            const binary_tables::source_key sourceKey{ source.file, source.line, source.function };
+
+            auto sourceIt{ tables.sources.find(sourceKey) };
+            if (sourceIt == tables.sources.end())
+            {
+                sourceIt = tables.sources.emplace(sourceKey, static_cast<std::uint32_t>(tables.sources.size() + 1)).first;
+
+                const auto offset{ begin_binary_record(output, binary_record::source) };
+                append_binary(output, sourceIt->second);
+                append_binary(output, static_cast<std::int32_t>(source.line));
+                append_binary(output, source.file);
+                append_binary(output, source.function);
+                end_binary_record(output, offset);
+            }
 
-            auto it{ m_logFiles.find(logFile) };
-            if (it == m_logFiles.end())
+            auto messageType{ binary_message::text };
+            if (thisHeader.renderer == &log_args::render_printf)
+            {
+                messageType = binary_message::printf;
+            }
+            else if (thisHeader.renderer == &log_args::render_format)
             {
-                it = m_logFiles.emplace(logFile, log_file{}).first;
+                messageType = binary_message::format;
             }
 
-            auto& buffer        { it->second.buffer };
-            auto bufferMaxSize  { buffer_max_size() };
+            const char* cursor  { thisHeader.message() };
+            const char* end     { cursor + thisHeader.messageSize };
+            std::uint32_t schemeID{ 0 };
+            log_arg arg{};
 
-            if (bufferMaxSize == 0 || buffer.size() < bufferMaxSize)
+            if (messageType != binary_message::text)
             {
-                buffer.emplace_front(logTime, threadID, logLevel, sourceInfo, message);
+                if (!log_args::read(cursor, end, arg) || !arg.is_string())
+                {
+                    return;
+                }
+
+                tables.scheme.assign(arg.string, arg.string_size);
 
-                if (buffer_flush_size() <= buffer.size())
+                auto schemeIt{ tables.schemes.find(tables.scheme) };
+                if (schemeIt == tables.schemes.end())
                 {
-                    // Unlock the mutex and wake the logging thread
-                    lock.unlock();
-                    m_loggingCondition.notify_one();
+                    schemeIt = tables.schemes.emplace(tables.scheme, static_cast<std::uint32_t>(tables.schemes.size() + 1)).first;
+
+                    const auto offset{ begin_binary_record(output, binary_record::scheme) };
+                    append_binary(output, schemeIt->second);
+                    append_binary(output, static_cast<std::uint32_t>(tables.scheme.size()));
+                    output.append(tables.scheme);
+                    end_binary_record(output, offset);
                 }
+
+                schemeID = schemeIt->second;
+            }
+            else if (thisHeader.renderer)
+            {
+                // Other renderers can't be stored, so their messages are rendered now
+                logFile.entry.message.clear();
+                thisHeader.renderer(logFile.entry.message, cursor, thisHeader.messageSize);
+                cursor  = logFile.entry.message.data();
+                end     = cursor + logFile.entry.message.size();
+            }
+
+            const auto offset{ begin_binary_record(output, binary_record::log) };
+            append_binary(output, static_cast<std::int64_t>(thisHeader.time.time_since_epoch().count()));
+            append_binary(output, static_cast<std::uint64_t>(thisHeader.threadID));
+            append_binary(output, static_cast<std::int8_t>(thisHeader.level));
+            append_binary(output, sourceIt->second);
+            append_binary(output, static_cast<unsigned char>(messageType));
+            append_binary(output, schemeID);
+
+            if (messageType == binary_message::text)
+            {
+                output.append(cursor, end);
             }
             else
             {
-                // Buffer is full, discard log
-                ++m_numDiscardedLogs;
+                append_args_with_strings(output, cursor, end);
+            }
+
+            end_binary_record(output, offset);
+        }
+
+        // Args are appended as they are, except static strings, which point to memory that won't be there when they're read
+        static void append_args_with_strings(std::string& output, const char* cursor, const char* const end)
+        {
+            log_arg arg{};
+            while (cursor != end)
+            {
+                const auto argStart{ cursor };
+                if (!log_args::read(cursor, end, arg))
+                {
+                    break;
+                }
+
+                if (arg.type == log_arg_type::static_string)
+                {
+                    const auto argOffset{ output.size() };
+                    output.resize(argOffset + log_args::string_size(arg.string_size));
+                    log_args::write_string(&output[argOffset], arg.string, arg.string_size);
+                }
+                else
+                {
+                    output.append(argStart, cursor);
+                }
             }
         }
 
-        void open_file_stream(std::ofstream& fileStream, const pluto::filesystem::path& filePath) const
+        // Renderers are stored in staging files by id, since their addresses can change between runs
+        static unsigned char renderer_id(const log_renderer renderer)
         {
-            fileStream.open(filePath, (std::ios_base::ate | std::ios_base::app));
+            if (renderer == &log_args::render_printf)   return 1;
+            if (renderer == &log_args::render_format)   return 2;
+            if (renderer == &log_args::render_logfmt)   return 3;
+            if (renderer == &log_args::render_json)     return 4;
+            return 0;
+        }
 
-            if (!fileStream.is_open() || !fileStream.good())
+        static log_renderer renderer_from_id(const unsigned char id)
+        {
+            switch (id)
             {
-                throw pluto::filesystem::filesystem_error{
-                    "pluto::logger failed to open file", std::make_error_code(std::errc::io_error) };
+                case 1:     return &log_args::render_printf;
+                case 2:     return &log_args::render_format;
+                case 3:     return &log_args::render_logfmt;
+                case 4:     return &log_args::render_json;
+                default:    return nullptr;
             }
         }
 
-        void rotate_file(const pluto::filesystem::path& filePath) const
+        // Requires the file's mutex to be locked. Copies the log to the staging file, if there is one.
+        static void stage_log(log_file& logFile, log_buffer::header& thisHeader)
         {
-            const auto stem             { filePath.stem().string() };
-            const auto extension        { filePath.extension().string() };
-            const auto parentPath       { filePath.parent_path() };
-            const auto fileRotationLimit{ file_rotation_limit() };
+            if (logFile.staging.is_open())
+            {
+                thisHeader.staged = logFile.staging.push_log(thisHeader);
+            }
+        }
 
-            std::size_t numFiles{ 0 };
-            for (std::size_t i{ 0 }; ; ++i)
+        // Requires the file's mutex to be locked. Adds logs that an earlier process staged but never wrote, ahead of new logs.
+        // Their source info is kept by the file, since what it pointed to was in the earlier process.
+        void recover_staged_logs(log_file& logFile, const std::vector<std::string>& bodies)
+        {
+            if (bodies.empty())
             {
-                const auto thisStem{ stem + ((i == 0) ? "" : ("_" + std::to_string(i))) };
-                const auto thisPath{ parentPath / (thisStem + extension) };
+                return;
+            }
 
-                if (!pluto::filesystem::exists(thisPath))
-                {
-                    break;
-                }
+            const auto message{ "Recovered " + std::to_string(bodies.size()) + " logs that weren't written before the last exit" };
+            push_log(logFile, clock_type::now(), pluto::thread_id(), log_level::warning, { "", 0, "" }, nullptr, message.size(),
+                [&message](char* const dest) { std::memcpy(dest, message.data(), message.size()); });
 
-                if (i < fileRotationLimit)
+            for (const auto& body : bodies)
+            {
+                binary_reader reader{ body.data(), (body.data() + body.size()) };
+
+                std::int64_t    time        { 0 };
+                std::uint64_t   threadID    { 0 };
+                std::int8_t     level       { 0 };
+                std::int32_t    line        { 0 };
+                std::string     file        {};
+                std::string     function    {};
+                unsigned char   rendererID  { 0 };
+
+                if (!reader.read(time) || !reader.read(threadID) || !reader.read(level) || !reader.read(line) ||
+                    !reader.read(file) || !reader.read(function) || !reader.read(rendererID))
                 {
-                    ++numFiles;
                     continue;
                 }
 
-                pluto::filesystem::remove(thisPath);
+                const source_info sourceInfo{
+                    logFile.recoveredStrings.insert(file).first->c_str(),
+                    static_cast<int>(line),
+                    logFile.recoveredStrings.insert(function).first->c_str() };
+
+                const auto messageSize{ static_cast<std::size_t>(reader.end - reader.cursor) };
+                push_log(logFile, log_entry::time_type{ log_entry::time_type::duration{ time } }, static_cast<std::size_t>(threadID),
+                    static_cast<log_level>(level), sourceInfo, renderer_from_id(rendererID), messageSize,
+                    [&reader, messageSize](char* const dest) { std::memcpy(dest, reader.cursor, messageSize); });
+            }
+        }
+
+        // Requires the file's mutex to be locked. Opens, reopens or closes the staging file when the staging size changes.
+        void update_staging(log_file& logFile)
+        {
+            const auto stagingSize{ staging_size() };
+            if (logFile.stagingSize == stagingSize)
+            {
+                return;
             }
 
-            for (auto i{ numFiles }; 0 < i; )
+            logFile.stagingSize = stagingSize;
+            logFile.staging.close(true);
+
+            if (stagingSize == 0)
             {
-                const auto newStem{ stem + "_" + std::to_string(i) };
-                const auto newPath{ parentPath / (newStem + extension) };
+                return;
+            }
 
-                --i;
+            std::vector<std::string> uncommitted{};
+
+            try
+            {
+                const pluto::filesystem::path filePath{ logFile.name + ".staging" };
+                if (create_dirs() && filePath.has_parent_path())
+                {
+                    pluto::filesystem::create_directories(filePath.parent_path());
+                }
 
-                const auto oldStem{ stem + ((i == 0) ? "" : ("_" + std::to_string(i))) };
-                const auto oldPath{ parentPath / (oldStem + extension) };
+                logFile.staging.open(filePath, stagingSize, uncommitted);
+            }
+            catch (const pluto::filesystem::filesystem_error&)
+            {
+                // Logs aren't staged until the size changes again
+            }
 
-                pluto::filesystem::rename(oldPath, newPath);
+            // Only recovered once, since logs staged by this process after that are still in its buffers
+            if (!logFile.stagingRecovered)
+            {
+                logFile.stagingRecovered = true;
+                recover_staged_logs(logFile, uncommitted);
             }
         }
 
-        log_buffer::iterator write_buffer_to_file(
-            const log_buffer::iterator  begin,
-            const log_buffer::iterator  end,
-            const std::string&          fileName,
-            pluto::filesystem::path&    filePath,
-            bool&                       dirsCreated) const
+        // Requires the file's mutex to be locked
+        template<class MessageWriter>
+        void push_log(
+            log_file&                   logFile,
+            const log_entry::time_type  logTime,
+            const std::size_t           threadID,
+            const log_level             logLevel,
+            const source_info           sourceInfo,
+            const log_renderer          renderer,
+            const std::size_t           messageSize,
+            MessageWriter&&             writeMessage)
+        {
+            update_staging(logFile);
+            stage_log(logFile, logFile.buffer.push_back(logTime, threadID, logLevel, sourceInfo, renderer, messageSize, writeMessage));
+            count_enqueued_log(logFile);
+        }
+
+        // Writes pending logs that haven't been written yet. Stops early if the file can't be written to.
+        void write_buffer_to_file(const std::string& fileName, log_file& logFile)
         {
-            auto itWritten{ end };
+            auto& output{ logFile.output };
+            auto& outputEnds{ logFile.outputEnds };
+            std::size_t numOutput{ 0 }; // Number of logs in the output that haven't been written to the file yet
+            std::size_t numFailed{ 0 }; // Number of logs that couldn't be written, which are discarded
+            std::uint64_t outputStaged{ 0 };    // Staging sequence of the last log in the output
+            std::uint64_t writtenStaged{ 0 };   // Staging sequence of the last log written
+
+            const auto writeStart       { std::chrono::steady_clock::now() };
+            const auto numAlreadyWritten{ logFile.numWritten };
 
             try
             {
                 // Get file path if empty
-                if (filePath.empty())
+                if (logFile.filePath.empty())
                 {
-                    filePath = pluto::filesystem::absolute(fileName);
+                    logFile.filePath = pluto::filesystem::absolute(fileName);
                 }
 
                 // Create path to file if needed
-                if (create_dirs() && !dirsCreated)
+                if (create_dirs() && !logFile.dirsCreated)
                 {
-                    pluto::filesystem::create_directories(filePath.parent_path());
-                    dirsCreated = true;
+                    pluto::filesystem::create_directories(logFile.filePath.parent_path());
+                    logFile.dirsCreated = true;
                 }
 
                 const auto writeHeader{ write_header() };
+                const auto binaryMode{ binary_mode() };
                 const auto fileRotationSize{ file_rotation_size() };
+                const auto fileRotationPeriod{ file_rotation_period() };
+                const auto now{ std::time(nullptr) };
+                const auto logAppender{ log_appender() };
+                const auto logWriter{ log_writer() };
+
+                // The file stays open between writes, unless it was moved, removed or written to by something else.
+                // That's only checked once per file check interval, so most writes don't ask the file system.
+                if (logFile.file.is_open())
+                {
+                    if (logFile.isBinary != binaryMode || logFile.file.mapping_size() != file_mapping_size())
+                    {
+                        close_file(logFile);
+                    }
+                    else if (logFile.lastCheck + file_check_interval() <= writeStart)
+                    {
+                        logFile.lastCheck = writeStart;
+                        if (!logFile.file.is_same_file(logFile.filePath, (logFile.fileSize + logFile.file.reserved_size())))
+                        {
+                            close_file(logFile);
+                        }
+                    }
+                }
 
-                std::size_t fileSize{ 0 };
-                std::ofstream fileStream{};
-                open_file_stream(fileStream, filePath);
+                if (!logFile.file.is_open())
+                {
+                    open_file(logFile, binaryMode);
+                }
 
-                while (itWritten != begin)
+                // A new period takes effect from now, rather than rotating straight away
+                if (logFile.rotationPeriod != fileRotationPeriod)
                 {
-                    fileSize = static_cast<std::size_t>(fileStream.tellp());
+                    logFile.rotationPeriod = fileRotationPeriod;
+                    logFile.rotationTime = ((fileRotationPeriod == log_period::none) ? 0 : period_start(now, fileRotationPeriod, 1));
+                }
+
+                // Checked once per batch, so logs in the batch all go to the new file
+                auto rotateByTime{ fileRotationPeriod != log_period::none && logFile.rotationTime <= now };
+
+                bool writeFailed{ false };
 
-                    // Rotate file if needed
-                    if (fileRotationSize != 0 && fileRotationSize <= fileSize)
+                std::size_t index{ 0 };
+                output.clear();
+                outputEnds.clear();
+
+                // Logs are written to the file in one call, rather than being streamed one at a time
+                const auto write_output = [&]()
                     {
-                        fileStream.close();
-                        rotate_file(filePath);
-                        open_file_stream(fileStream, filePath);
-                        fileSize = static_cast<std::size_t>(fileStream.tellp());
-                    }
+                        if (!output.empty())
+                        {
+#ifdef _WIN32
+                            // Text files on Windows end lines with a carriage return, like text streams do
+                            if (!logFile.isBinary)
+                            {
+                                std::size_t numLines{ static_cast<std::size_t>(std::count(output.begin(), output.end(), '\n')) };
+
+                                // Each log ends further on by the number of lines before its end
+                                std::size_t numLinesBefore{ 0 };
+                                std::size_t lineStart{ 0 };
+                                for (auto& outputEnd : outputEnds)
+                                {
+                                    numLinesBefore += static_cast<std::size_t>(std::count((output.begin() + lineStart), (output.begin() + outputEnd), '\n'));
+                                    lineStart = outputEnd;
+                                    outputEnd += numLinesBefore;
+                                }
+
+                                output.resize(output.size() + numLines);
+
+                                for (auto i{ output.size() - numLines }; numLines != 0; )
+                                {
+                                    --i;
+                                    output[i + numLines] = output[i];
+
+                                    if (output[i] == '\n')
+                                    {
+                                        --numLines;
+                                        output[i + numLines] = '\r';
+                                    }
+                                }
+                            }
+#endif
+                            auto numBytes{ logFile.file.write(output.data(), output.size()) };
+                            if (numBytes != output.size())
+                            {
+                                // Retried once, in case the failure was brief, like space being freed
+                                numBytes += logFile.file.write((output.data() + numBytes), (output.size() - numBytes));
+                            }
+
+                            write_counters::add(logFile.counters.numBytes, numBytes);
+                            logFile.fileSize += numBytes;
+                            logFile.isSynced = false;
+
+                            if (numBytes != output.size())
+                            {
+                                // Logs that didn't fully make it to the file are discarded, rather than retried
+                                const auto numLogsWritten{ static_cast<std::size_t>(
+                                    std::upper_bound(outputEnds.begin(), outputEnds.end(), numBytes) - outputEnds.begin()) };
+
+                                numFailed += (numOutput - numLogsWritten);
+                                m_numDiscardedLogs.fetch_add((numOutput - numLogsWritten));
+                                writeFailed = true;
+                            }
+                            else
+                            {
+                                writtenStaged = outputStaged;
+                            }
+
+                            output.clear();
+                            outputEnds.clear();
+                        }
+
+                        logFile.numWritten += numOutput;
+                        numOutput = 0;
+                    };
 
-                    // Write header if needed
-                    if (writeHeader && fileSize == 0)
+                logFile.pending.for_each([&](const log_buffer::header& thisHeader)
                     {
-                        header_writer()(fileStream);
-                        fileStream << '\n';
+                        if (index++ < numAlreadyWritten)
+                        {
+                            return;
+                        }
+
+                        // Rotate file if needed, empty files aren't rotated by time
+                        const auto fileSize{ logFile.fileSize + output.size() };
+                        if ((rotateByTime && fileSize != 0) || (fileRotationSize != 0 && fileRotationSize <= fileSize))
+                        {
+                            write_output();
+
+                            const auto rotationStart{ std::chrono::steady_clock::now() };
+                            close_file(logFile);
+                            rotate_file(logFile.filePath);
+                            open_file(logFile, binaryMode);
+
+                            write_counters::add(logFile.counters.numRotations, 1);
+                            logFile.counters.rotationTime.fetch_add(
+                                std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - rotationStart).count(),
+                                std::memory_order_relaxed);
+                        }
+                        else if (rotateByTime)
+                        {
+                            logFile.rotationTime = period_start(now, fileRotationPeriod, 1);
+                        }
+
+                        rotateByTime = false;
+
+                        // Write header if needed
+                        if (logFile.fileSize + output.size() == 0)
+                        {
+                            if (binaryMode)
+                            {
+                                // Binary files always need their header, and can't refer to anything written to another file
+                                append_binary_file_header(output);
+                                logFile.binary.clear();
+                            }
+                            else if (writeHeader)
+                            {
+                                append_header(output);
+                            }
+                        }
+
+                        if (thisHeader.staged != 0)
+                        {
+                            outputStaged = thisHeader.staged;
+                        }
+
+                        if (binaryMode)
+                        {
+                            append_binary_log(output, logFile, thisHeader);
+                            outputEnds.push_back(output.size());
+                            ++numOutput;
+                            return;
+                        }
+
+                        auto& entry{ logFile.entry };
+                        entry.time      = thisHeader.time;
+                        entry.thread_id = thisHeader.threadID;
+                        entry.level     = thisHeader.level;
+                        entry.source    = thisHeader.source;
+                        if (thisHeader.renderer)
+                        {
+                            entry.message.clear();
+                            thisHeader.renderer(entry.message, thisHeader.message(), thisHeader.messageSize);
+                        }
+                        else
+                        {
+                            entry.message.assign(thisHeader.message(), thisHeader.messageSize);
+                        }
+
+                        if (logAppender)
+                        {
+                            logAppender(output, entry);
+                        }
+                        else
+                        {
+                            // Log writers write to a string stream, so the size of each log is known without asking the file
+                            auto& writerStream{ logFile.writerStream };
+                            writerStream.str(std::string{});
+                            logWriter(writerStream, entry);
+                            output.append(writerStream.str());
+                        }
+
+                        output.push_back('\n');
+                        outputEnds.push_back(output.size());
+                        ++numOutput;
                     }
+                );
+
+                write_output();
+
+                if (writeFailed)
+                {
+                    // Reopened next time, in case the file was moved or the disk was full. Anything interned may not have made it.
+                    logFile.binary.clear();
+                    close_file(logFile);
+                }
+                else
+                {
+                    sync_file(logFile, false);
+                }
+            }
+            catch (const pluto::filesystem::filesystem_error&)
+            {
+                // Logs in the output will be retried, and anything interned may not have made it to the file
+                output.clear();
+                logFile.binary.clear();
+                close_file(logFile);
+            }
+
+            if (writtenStaged != 0)
+            {
+                const std::unique_lock<std::mutex> lock{ logFile.mutex };
+                logFile.staging.commit(writtenStaged);
+            }
+
+            // Only counted as a flush if logs were written
+            const auto numRecords{ logFile.numWritten - numAlreadyWritten - numFailed };
+            if (numRecords != 0)
+            {
+                const auto microseconds{ std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - writeStart).count() };
 
-                    --itWritten;
-                    log_writer()(fileStream, *itWritten);
-                    fileStream << '\n';
+                std::size_t bucket{ 0 };
+                while (bucket + 1 < write_counters::num_latency_buckets && (1LL << bucket) <= microseconds)
+                {
+                    ++bucket;
                 }
+
+                write_counters::add(logFile.counters.numRecords, numRecords);
+                write_counters::add(logFile.counters.numFlushes, 1);
+                write_counters::add(logFile.counters.flushLatencies[bucket], 1);
+            }
+        }
+
+        void append_header(std::string& output) const
+        {
+            const auto headerAppender{ header_appender() };
+            if (headerAppender)
+            {
+                headerAppender(output);
+            }
+            else
+            {
+                std::ostringstream headerStream{};
+                header_writer()(headerStream);
+                output.append(headerStream.str());
             }
-            catch (const pluto::filesystem::filesystem_error&) {}
 
-            return itWritten;
+            output.push_back('\n');
         }
 
         void start_logging()
         {
             bool shouldWait{ false };
+            bool hasFlushTime{ false };
+            steady_time flushTime{};
             std::unique_lock<std::mutex> lock{ m_loggingMutex };
 
             while (m_isLogging.load())
             {
                 if (shouldWait)
                 {
-                    m_loggingCondition.wait(lock);
+                    m_isWaiting.store(true);
+
+                    // Thread buffers don't lock to add logs, so check if any were added before waiting
+                    if (!m_hasPendingLogs.exchange(false))
+                    {
+                        // Wake up for whichever comes first, the flush timer or files that haven't been synced
+                        steady_time wakeTime{ flushTime };
+                        bool hasWakeTime{ hasFlushTime };
+
+                        steady_time syncTime{};
+                        if (next_sync_time(syncTime) && (!hasWakeTime || syncTime < wakeTime))
+                        {
+                            wakeTime = syncTime;
+                            hasWakeTime = true;
+                        }
+
+                        if (hasWakeTime)
+                        {
+                            m_loggingCondition.wait_until(lock, wakeTime);
+                        }
+                        else
+                        {
+                            m_loggingCondition.wait(lock);
+                        }
+                    }
+
+                    m_isWaiting.store(false);
                     shouldWait = false;
                 }
                 else
                 {
                     shouldWait = true;
 
+                    const auto now{ std::chrono::steady_clock::now() };
+
+                    // Start timing from when the logging thread first hears of the timer
+                    if (!hasFlushTime && m_hasFlushTimer.load())
+                    {
+                        flushTime = now + flush_interval();
+                        hasFlushTime = true;
+                    }
+
+                    // Logs added after this start a new timer
+                    const bool flushAll{ hasFlushTime && flushTime <= now && m_hasFlushTimer.exchange(false) };
+                    if (flushAll)
+                    {
+                        hasFlushTime = false;
+                    }
+
+                    m_hasPendingLogs.store(false);
+                    drain_thread_buffers();
+                    m_spaceCondition.notify_all();
+
+                    const auto writerPool{ m_writerPool };
+
                     for (auto& logFilePair : m_logFiles)
                     {
-                        auto& buffer{ logFilePair.second.buffer };
+                        auto& logFile{ logFilePair.second };
+
+                        // Files being written by a writer thread are left alone until it's done
+                        if (logFile.isWriting)
+                        {
+                            continue;
+                        }
+
+                        // Pending logs that failed to write are retried before taking more
+                        if (logFile.pending.empty())
+                        {
+                            std::unique_lock<std::mutex> fileLock{ logFile.mutex };
+
+                            const auto bufferSize{ logFile.buffer.size() };
+                            const auto bufferMaxSize{ buffer_max_size() };
 
-                        if (!buffer.empty() && buffer_flush_size() <= buffer.size())
+                            // Full buffers are written even if they're smaller than the flush size
+                            if (bufferSize == 0 ||
+                                (!flushAll && bufferSize < buffer_flush_size() && (bufferMaxSize == 0 || bufferSize < bufferMaxSize)))
+                            {
+                                continue;
+                            }
+
+                            // Take the whole buffer, calling threads continue with the empty one
+                            logFile.pending.swap(logFile.buffer);
+
+                            fileLock.unlock();
+                            logFile.spaceCondition.notify_all();
+                        }
+
+                        if (writerPool)
+                        {
+                            // Each file is given to one writer at a time, so its logs stay in order.
+                            // The writer wakes this thread when it's done.
+                            logFile.isWriting = true;
+                            ++m_numWriting;
+
+                            writerPool->run_async([this, &logFilePair]() { write_pending_logs(logFilePair.first, logFilePair.second); });
+                            continue;
+                        }
+
+                        // Doesn't require synchronization.
+                        // Only the logging thread touches pending logs, and calling threads only touch the buffer.
+                        lock.unlock();
+
+                        // Since other threads can add logs, don't wait when done.
+                        shouldWait = false;
+
+                        write_buffer_to_file(logFilePair.first, logFile);
+
+                        lock.lock();
+
+                        if (logFile.numWritten == logFile.pending.size())
                         {
-                            auto& fileName      { logFilePair.first };
-                            auto& filePath      { logFilePair.second.filePath };
-                            auto& dirsCreated   { logFilePair.second.dirsCreated };
+                            logFile.pending.clear();
+                            logFile.numWritten = 0;
+                        }
+                    }
 
-                            const auto begin{ buffer.begin() };
-                            const auto end  { buffer.end() };
+                    // Sync files that weren't written to, but are due a sync
+                    for (auto& logFilePair : m_logFiles)
+                    {
+                        auto& logFile{ logFilePair.second };
 
-                            // Doesn't require synchronization.
-                            // Since this thread stays within the range gotten when locked
-                            // and other threads only add before begin, unlocking is fine.
-                            //
-                            // Note:
-                            // Other threads add to the front of the log buffer and this
-                            // thread reads logs from back to front. This is done because
-                            // when you add logs to the back, the end node is pushed out,
-                            // which means you can't take an end iterator and unlock.
-                            // This way is cleaner.
+                        // Only unlock when there's a sync to do, logs added while unlocked are checked before waiting
+                        if (!logFile.isWriting && is_sync_due(logFile, false))
+                        {
                             lock.unlock();
 
-                            // Since other threads can add logs, don't wait when done.
                             shouldWait = false;
-
-                            const auto itWritten{ write_buffer_to_file(begin, end, fileName, filePath, dirsCreated) };
+                            sync_file(logFile, false);
 
                             lock.lock();
-
-                            // Erase the logs after re-locking.
-                            buffer.erase(itWritten, end);
                         }
                     }
                 }
             }
+
+            // Wait for writer threads, so what's left can be written when the logger is destroyed
+            m_loggingCondition.wait(lock, [this]() { return (m_numWriting == 0); });
+        }
+
+        // Requires m_loggingMutex to be locked. Returns false if no file is waiting to be synced on an interval.
+        bool next_sync_time(steady_time& syncTime) const
+        {
+            if (sync_policy() != log_sync::interval)
+            {
+                return false;
+            }
+
+            bool hasSyncTime{ false };
+            for (const auto& logFilePair : m_logFiles)
+            {
+                const auto& logFile{ logFilePair.second };
+
+                if (!logFile.isWriting && !logFile.isSynced && logFile.file.is_open() && (!hasSyncTime || logFile.lastSync < syncTime))
+                {
+                    syncTime = logFile.lastSync;
+                    hasSyncTime = true;
+                }
+            }
+
+            syncTime += sync_interval();
+            return hasSyncTime;
+        }
+    };
+
+    inline log_site::log_site(const char* const file, const int line, const char* const function) :
+        m_source{ file, line, function, this },
+        m_text  {},
+        m_size  { 0 }
+    {
+#if !PLUTO_LOGGER_HIDE_SOURCE_INFO
+        std::string text{};
+        logger::append_source(text, m_source);
+
+        // Can't happen with the default widths, but an unrendered site falls back to rendering each log
+        if (text.size() <= sizeof(m_text))
+        {
+            std::memcpy(m_text, text.data(), text.size());
+            m_size = text.size();
+        }
+        else
+        {
+            m_source.site = nullptr;
+        }
+#endif
+    }
+
+    // Decides which logs from one call site are written, and counts the rest. Used by the rate limited logging macros.
+    // Checks are a few relaxed atomic operations, and never lock.
+    class log_limiter
+    {
+        typedef std::chrono::steady_clock clock_type;
+
+        std::atomic_size_t              m_numCalls      { 0 };
+        std::atomic_size_t              m_numSuppressed { 0 };
+        std::atomic<std::int64_t>       m_window        { 0 };  // Current second for per_second(), since the clock's epoch
+        std::atomic_size_t              m_numInWindow   { 0 };
+
+        inline bool allow(const bool isAllowed)
+        {
+            if (!isAllowed)
+            {
+                m_numSuppressed.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            return isAllowed;
+        }
+
+    public:
+        log_limiter() = default;
+
+        log_limiter(const log_limiter&) = delete;
+
+        log_limiter& operator=(const log_limiter&) = delete;
+
+        // Allows up to the limit each second. Calls at the start of a second may briefly go over the limit.
+        bool per_second(const std::size_t limit)
+        {
+            const auto now{ std::chrono::duration_cast<std::chrono::seconds>(clock_type::now().time_since_epoch()).count() };
+
+            auto window{ m_window.load(std::memory_order_relaxed) };
+            if (window != now && m_window.compare_exchange_strong(window, now, std::memory_order_relaxed))
+            {
+                m_numInWindow.store(0, std::memory_order_relaxed);
+            }
+
+            return allow(m_numInWindow.fetch_add(1, std::memory_order_relaxed) < limit);
+        }
+
+        // Allows the first call and every nth call after it. 0 allows nothing.
+        inline bool every_n(const std::size_t n)
+        {
+            const auto count{ m_numCalls.fetch_add(1, std::memory_order_relaxed) };
+            return allow(n != 0 && (count % n) == 0);
+        }
+
+        // Allows the first calls, then every nth call after them, like calls first + n - 1 and first + 2n - 1. An n of 0 allows only the first calls.
+        inline bool first_n(const std::size_t first, const std::size_t n)
+        {
+            const auto count{ m_numCalls.fetch_add(1, std::memory_order_relaxed) };
+            return allow(count < first || (n != 0 && ((count - first + 1) % n) == 0));
+        }
+
+        PLUTO_UTILS_NODISCARD inline std::size_t num_suppressed() const
+        {
+            return m_numSuppressed.load(std::memory_order_relaxed);
+        }
+
+        // Writes how many logs were suppressed since the last one that was allowed, if any were
+        template<class LogFile>
+        void write_suppressed(
+            logger&             thisLogger,
+            const LogFile&      logFile,
+            const log_level     logLevel,
+            const source_info   sourceInfo)
+        {
+            if (m_numSuppressed.load(std::memory_order_relaxed) != 0)
+            {
+                const auto numSuppressed{ m_numSuppressed.exchange(0, std::memory_order_relaxed) };
+                if (numSuppressed != 0)
+                {
+                    thisLogger.write(logFile, logLevel, sourceInfo, ("Suppressed " + std::to_string(numSuppressed) + " logs"));
+                }
+            }
         }
     };
 }
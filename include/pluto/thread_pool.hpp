@@ -9,10 +9,19 @@
 #define PLUTO_UTILS_THREAD_POOL_HPP
 
 #include <map>
+#include <new>
 #include <mutex>
+#include <tuple>
+#include <atomic>
 #include <chrono>
 #include <future>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
 #include <thread>
+#include <utility>
+#include <exception>
+#include <type_traits>
 #include <condition_variable>
 
 #include "compare.hpp"
@@ -50,71 +59,830 @@
 #define PLUTO_THREAD_POOL_CLOCK_TYPE std::chrono::system_clock
 #endif
 
+// Tasks that fit in this many bytes are stored without allocating
+#ifndef PLUTO_THREAD_POOL_TASK_INLINE_SIZE
+#define PLUTO_THREAD_POOL_TASK_INLINE_SIZE 64
+#endif
+
+// Tasks a worker can queue at each priority level when work stealing. Must be a power of 2.
+#ifndef PLUTO_THREAD_POOL_WORK_QUEUE_SIZE
+#define PLUTO_THREAD_POOL_WORK_QUEUE_SIZE 256
+#endif
+
+// Workers past this many queue their tasks with everyone else's when work stealing
+#ifndef PLUTO_THREAD_POOL_MAX_WORK_QUEUES
+#define PLUTO_THREAD_POOL_MAX_WORK_QUEUES 256
+#endif
+
 namespace pluto
 {
+    // A move only task, like a std::function<void()> that can't be copied. Tasks that fit in
+    // PLUTO_THREAD_POOL_TASK_INLINE_SIZE bytes, and can be moved without throwing, are stored inline.
+    class task_function
+    {
+        struct operations
+        {
+            void(*invoke)(void* storage);
+            void(*move)(void* destination, void* source);   // Also destroys the source
+            void(*destroy)(void* storage);
+        };
+
+        template<class Function>
+        struct inline_operations
+        {
+            static Function& get(void* const storage)
+            {
+                return *static_cast<Function*>(storage);
+            }
+
+            static void invoke(void* const storage)
+            {
+                get(storage)();
+            }
+
+            static void move(void* const destination, void* const source)
+            {
+                ::new (destination) Function(std::move(get(source)));
+                get(source).~Function();
+            }
+
+            static void destroy(void* const storage)
+            {
+                get(storage).~Function();
+            }
+
+            static const operations* get_operations()
+            {
+                static const operations functionOperations{ &invoke, &move, &destroy };
+                return &functionOperations;
+            }
+        };
+
+        template<class Function>
+        struct heap_operations
+        {
+            static Function*& get(void* const storage)
+            {
+                return *static_cast<Function**>(storage);
+            }
+
+            static void invoke(void* const storage)
+            {
+                (*get(storage))();
+            }
+
+            static void move(void* const destination, void* const source)
+            {
+                ::new (destination) Function*(get(source));
+            }
+
+            static void destroy(void* const storage)
+            {
+                delete get(storage);
+            }
+
+            static const operations* get_operations()
+            {
+                static const operations functionOperations{ &invoke, &move, &destroy };
+                return &functionOperations;
+            }
+        };
+
+        template<class Function>
+        struct is_inline : std::integral_constant<bool,
+            (sizeof(Function) <= PLUTO_THREAD_POOL_TASK_INLINE_SIZE &&
+            alignof(Function) <= alignof(std::max_align_t) &&
+            std::is_nothrow_move_constructible<Function>::value)> {};
+
+        alignas(std::max_align_t) unsigned char m_storage[PLUTO_THREAD_POOL_TASK_INLINE_SIZE];
+        const operations*                       m_operations;
+
+        template<class Function, class Value>
+        void construct(Value&& value, std::true_type)
+        {
+            ::new (static_cast<void*>(m_storage)) Function(std::forward<Value>(value));
+            m_operations = inline_operations<Function>::get_operations();
+        }
+
+        template<class Function, class Value>
+        void construct(Value&& value, std::false_type)
+        {
+            ::new (static_cast<void*>(m_storage)) Function*(new Function(std::forward<Value>(value)));
+            m_operations = heap_operations<Function>::get_operations();
+        }
+
+    public:
+        task_function() noexcept :
+            m_operations{ nullptr } {}
+
+        template<class Function, class = typename std::enable_if<
+            !std::is_same<typename std::decay<Function>::type, task_function>::value>::type,
+            class = decltype(std::declval<typename std::decay<Function>::type&>()())>
+        task_function(Function&& function) :
+            m_operations{ nullptr }
+        {
+            typedef typename std::decay<Function>::type function_type;
+            construct<function_type>(std::forward<Function>(function), is_inline<function_type>{});
+        }
+
+        task_function(task_function&& other) noexcept :
+            m_operations{ other.m_operations }
+        {
+            if (m_operations != nullptr)
+            {
+                m_operations->move(m_storage, other.m_storage);
+                other.m_operations = nullptr;
+            }
+        }
+
+        task_function(const task_function&) = delete;
+
+        ~task_function()
+        {
+            reset();
+        }
+
+        task_function& operator=(task_function&& other) noexcept
+        {
+            if (this != &other)
+            {
+                reset();
+
+                if (other.m_operations != nullptr)
+                {
+                    other.m_operations->move(m_storage, other.m_storage);
+                    m_operations = other.m_operations;
+                    other.m_operations = nullptr;
+                }
+            }
+
+            return *this;
+        }
+
+        task_function& operator=(const task_function&) = delete;
+
+        inline void operator()()
+        {
+            m_operations->invoke(m_storage);
+        }
+
+        PLUTO_UTILS_NODISCARD explicit inline operator bool() const noexcept
+        {
+            return (m_operations != nullptr);
+        }
+
+        inline void reset() noexcept
+        {
+            if (m_operations != nullptr)
+            {
+                m_operations->destroy(m_storage);
+                m_operations = nullptr;
+            }
+        }
+    };
+
+    class thread_pool;
+
+    // The result of a task given to thread_pool::submit(), like a std::future that doesn't lock a mutex.
+    // Only a thread waiting for the task to complete blocks on a mutex and condition, which are on its stack.
+    template<class Result>
+    class task_future
+    {
+        friend class thread_pool;
+
+        template<class Value, class = void>
+        class shared_value
+        {
+            union
+            {
+                Value m_value;
+            };
+
+            bool m_hasValue{ false };
+
+        public:
+            shared_value() {}
+
+            ~shared_value()
+            {
+                if (m_hasValue)
+                {
+                    m_value.~Value();
+                }
+            }
+
+            template<class Function>
+            void set_from(Function& function)
+            {
+                ::new (static_cast<void*>(&m_value)) Value(function());
+                m_hasValue = true;
+            }
+
+            Value take()
+            {
+                return std::move(m_value);
+            }
+        };
+
+        template<class Value>
+        class shared_value<Value&, void>
+        {
+            Value* m_value{ nullptr };
+
+        public:
+            template<class Function>
+            void set_from(Function& function)
+            {
+                m_value = &function();
+            }
+
+            Value& take()
+            {
+                return *m_value;
+            }
+        };
+
+        template<class Unused>
+        class shared_value<void, Unused>
+        {
+        public:
+            template<class Function>
+            void set_from(Function& function)
+            {
+                function();
+            }
+
+            void take() {}
+        };
+
+        class shared_state
+        {
+            enum : unsigned char
+            {
+                pending,
+                waiting,    // A thread is blocked on m_waiter
+                ready
+            };
+
+            struct waiter
+            {
+                std::mutex              mutex       {};
+                std::condition_variable condition   {};
+                bool                    isNotified  { false };
+            };
+
+            std::atomic<unsigned char>  m_status        { pending };
+            std::atomic<unsigned char>  m_references    { 1 };      // The future, and the task once it's made
+            waiter*                     m_waiter        { nullptr };
+            std::exception_ptr          m_exception     {};
+            shared_value<Result>        m_value         {};
+
+            void set_ready()
+            {
+                if (m_status.exchange(ready, std::memory_order_acq_rel) == waiting)
+                {
+                    // Notified with the mutex locked, so the waiting thread can't return and destroy the condition first
+                    const std::unique_lock<std::mutex> lock{ m_waiter->mutex };
+                    m_waiter->isNotified = true;
+                    m_waiter->condition.notify_one();
+                }
+            }
+
+        public:
+            void add_reference()
+            {
+                m_references.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            // Called by the task
+            template<class Function>
+            void complete(Function&& function)
+            {
+                try
+                {
+                    m_value.set_from(function);
+                }
+                catch (...)
+                {
+                    m_exception = std::current_exception();
+                }
+
+                set_ready();
+            }
+
+            // Called by the task when it's destroyed without running
+            void abandon()
+            {
+                m_exception = std::make_exception_ptr(std::future_error{ std::future_errc::broken_promise });
+                set_ready();
+            }
+
+            void release()
+            {
+                if (m_references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                {
+                    delete this;
+                }
+            }
+
+            inline bool is_ready() const
+            {
+                return (m_status.load(std::memory_order_acquire) == ready);
+            }
+
+            // Waits forever if time is null
+            template<class TimePoint>
+            bool wait_until(const TimePoint* time)
+            {
+                if (is_ready())
+                {
+                    return true;
+                }
+
+                waiter thisWaiter{};
+                m_waiter = &thisWaiter;
+
+                auto status{ static_cast<unsigned char>(pending) };
+                if (!m_status.compare_exchange_strong(status, waiting, std::memory_order_acq_rel))
+                {
+                    return true;
+                }
+
+                std::unique_lock<std::mutex> lock{ thisWaiter.mutex };
+                while (!thisWaiter.isNotified)
+                {
+                    if (time == nullptr)
+                    {
+                        thisWaiter.condition.wait(lock);
+                    }
+                    else if (thisWaiter.condition.wait_until(lock, *time) == std::cv_status::timeout &&
+                        !thisWaiter.isNotified)
+                    {
+                        status = waiting;
+                        if (m_status.compare_exchange_strong(status, pending, std::memory_order_acq_rel))
+                        {
+                            return false;
+                        }
+
+                        // The task completed as this timed out, and is about to notify this waiter
+                        time = nullptr;
+                    }
+                }
+
+                return true;
+            }
+
+            Result get()
+            {
+                if (m_exception)
+                {
+                    std::rethrow_exception(m_exception);
+                }
+
+                return m_value.take();
+            }
+        };
+
+        struct state_releaser
+        {
+            shared_state* state;
+
+            ~state_releaser()
+            {
+                state->release();
+            }
+        };
+
+        shared_state* m_state;
+
+        explicit task_future(shared_state* const state) noexcept :
+            m_state{ state } {}
+
+    public:
+        task_future() noexcept :
+            m_state{ nullptr } {}
+
+        task_future(task_future&& other) noexcept :
+            m_state{ other.m_state }
+        {
+            other.m_state = nullptr;
+        }
+
+        task_future(const task_future&) = delete;
+
+        ~task_future()
+        {
+            if (m_state != nullptr)
+            {
+                m_state->release();
+            }
+        }
+
+        task_future& operator=(task_future&& other) noexcept
+        {
+            if (this != &other)
+            {
+                if (m_state != nullptr)
+                {
+                    m_state->release();
+                }
+
+                m_state = other.m_state;
+                other.m_state = nullptr;
+            }
+
+            return *this;
+        }
+
+        task_future& operator=(const task_future&) = delete;
+
+        PLUTO_UTILS_NODISCARD inline bool valid() const noexcept
+        {
+            return (m_state != nullptr);
+        }
+
+        PLUTO_UTILS_NODISCARD inline bool is_ready() const
+        {
+            return m_state->is_ready();
+        }
+
+        inline void wait() const
+        {
+            m_state->wait_until(static_cast<const std::chrono::steady_clock::time_point*>(nullptr));
+        }
+
+        template<class Rep, class Period>
+        inline std::future_status wait_for(const std::chrono::duration<Rep, Period>& duration) const
+        {
+            return wait_until(std::chrono::steady_clock::now() + duration);
+        }
+
+        template<class Clock, class Duration>
+        inline std::future_status wait_until(const std::chrono::time_point<Clock, Duration>& time) const
+        {
+            return (m_state->wait_until(&time) ? std::future_status::ready : std::future_status::timeout);
+        }
+
+        // Waits for the result and returns it, or throws the task's exception. The future is then invalid.
+        Result get()
+        {
+            wait();
+
+            const state_releaser releaser{ m_state };
+            m_state = nullptr;
+
+            return releaser.state->get();
+        }
+    };
+
     class thread_pool
     {
     public:
         typedef PLUTO_THREAD_POOL_CLOCK_TYPE clock_type;
 
-        enum class action : unsigned char
-        {
-            join_all,
-            complete_tasks
+        enum class action : unsigned char
+        {
+            join_all,
+            complete_tasks
+        };
+
+        enum class priority : signed char
+        {
+            lowest  = PLUTO_THREAD_POOL_PRIORITY_LOWEST,
+            lower   = PLUTO_THREAD_POOL_PRIORITY_LOWER,
+            low     = PLUTO_THREAD_POOL_PRIORITY_LOW,
+            normal  = PLUTO_THREAD_POOL_PRIORITY_NORMAL,
+            high    = PLUTO_THREAD_POOL_PRIORITY_HIGH,
+            higher  = PLUTO_THREAD_POOL_PRIORITY_HIGHER,
+            highest = PLUTO_THREAD_POOL_PRIORITY_HIGHEST
+        };
+
+    private:
+        static constexpr int priority_levels{ 7 };  // Queued tasks are ordered by the named priority they're at or above
+
+        struct task_info
+        {
+            signed char     priority;
+            task_function   task;
+
+            task_info(
+                const signed char   priority,
+                task_function&&     task) :
+                priority{ priority },
+                task    { std::move(task) } {}
+        };
+
+        template<class Function, class... Args>
+        using invoke_result = decltype(std::declval<typename std::decay<Function>::type>()(
+            std::declval<typename std::decay<Args>::type>()...));
+
+        // Results that are rvalue references are kept by value
+        template<class Function, class... Args>
+        using submit_result = typename std::conditional<std::is_rvalue_reference<invoke_result<Function, Args...>>::value,
+            typename std::decay<invoke_result<Function, Args...>>::type, invoke_result<Function, Args...>>::type;
+
+        // A task given to submit(). Completes its future when run, or breaks it if destroyed without running.
+        template<class Result, class Function, class... Args>
+        class submitted_task
+        {
+            typedef typename task_future<Result>::shared_state state_type;
+
+            state_type*         m_state;
+            Function            m_function;
+            std::tuple<Args...> m_args;
+
+            template<std::size_t... Indexes>
+            Result call(std::index_sequence<Indexes...>)
+            {
+                return std::move(m_function)(std::move(std::get<Indexes>(m_args))...);
+            }
+
+        public:
+            template<class FunctionValue, class... ArgValues>
+            submitted_task(
+                state_type* const   state,
+                FunctionValue&&     function,
+                ArgValues&&...      args) :
+                m_state   { state },
+                m_function(std::forward<FunctionValue>(function)),
+                m_args    (std::forward<ArgValues>(args)...)
+            {
+                m_state->add_reference();
+            }
+
+            submitted_task(submitted_task&& other) noexcept(
+                std::is_nothrow_move_constructible<Function>::value &&
+                std::is_nothrow_move_constructible<std::tuple<Args...>>::value) :
+                m_state   { other.m_state },
+                m_function(std::move(other.m_function)),
+                m_args    (std::move(other.m_args))
+            {
+                other.m_state = nullptr;
+            }
+
+            submitted_task(const submitted_task&) = delete;
+
+            ~submitted_task()
+            {
+                if (m_state != nullptr)
+                {
+                    m_state->abandon();
+                    m_state->release();
+                }
+            }
+
+            submitted_task& operator=(const submitted_task&) = delete;
+
+            void operator()()
+            {
+                const auto state{ m_state };
+                m_state = nullptr;
+
+                state->complete([this]() -> Result { return call(std::index_sequence_for<Args...>{}); });
+                state->release();
+            }
+        };
+
+        // Keeps the nodes of erased waiting tasks, so adding a task doesn't allocate. Only used with the mutex locked.
+        class node_pool
+        {
+            struct free_node
+            {
+                free_node* next;
+            };
+
+            free_node*  m_freeNodes { nullptr };
+            std::size_t m_nodeSize  { 0 };      // The size of the first allocation, which is the map's node size
+
+        public:
+            node_pool() = default;
+
+            node_pool(const node_pool&) = delete;
+
+            node_pool& operator=(const node_pool&) = delete;
+
+            ~node_pool()
+            {
+                while (m_freeNodes != nullptr)
+                {
+                    const auto next{ m_freeNodes->next };
+                    ::operator delete(m_freeNodes);
+                    m_freeNodes = next;
+                }
+            }
+
+            void* allocate(const std::size_t size)
+            {
+                if (m_nodeSize == 0 && sizeof(free_node) <= size)
+                {
+                    m_nodeSize = size;
+                }
+
+                if (size == m_nodeSize && m_freeNodes != nullptr)
+                {
+                    const auto node{ m_freeNodes };
+                    m_freeNodes = node->next;
+                    return node;
+                }
+
+                return ::operator new(size);
+            }
+
+            void deallocate(void* const node, const std::size_t size) noexcept
+            {
+                if (size != m_nodeSize)
+                {
+                    ::operator delete(node);
+                    return;
+                }
+
+                m_freeNodes = ::new (node) free_node{ m_freeNodes };
+            }
+        };
+
+        template<class Value>
+        struct node_allocator
+        {
+            typedef Value value_type;
+
+            node_pool* pool;
+
+            explicit node_allocator(node_pool& pool) noexcept :
+                pool{ &pool } {}
+
+            template<class Other>
+            node_allocator(const node_allocator<Other>& other) noexcept :
+                pool{ other.pool } {}
+
+            Value* allocate(const std::size_t size)
+            {
+                return static_cast<Value*>(pool->allocate(size * sizeof(Value)));
+            }
+
+            void deallocate(Value* const value, const std::size_t size) noexcept
+            {
+                pool->deallocate(value, (size * sizeof(Value)));
+            }
+
+            template<class Other>
+            bool operator==(const node_allocator<Other>& other) const noexcept
+            {
+                return (pool == other.pool);
+            }
+
+            template<class Other>
+            bool operator!=(const node_allocator<Other>& other) const noexcept
+            {
+                return (pool != other.pool);
+            }
         };
 
-        enum class priority : signed char
+        // Tasks of one priority level queued by one worker. The worker pushes and pops at the bottom, without locking,
+        // and other workers steal from the top (a Chase-Lev deque).
+        class work_queue
         {
-            lowest  = PLUTO_THREAD_POOL_PRIORITY_LOWEST,
-            lower   = PLUTO_THREAD_POOL_PRIORITY_LOWER,
-            low     = PLUTO_THREAD_POOL_PRIORITY_LOW,
-            normal  = PLUTO_THREAD_POOL_PRIORITY_NORMAL,
-            high    = PLUTO_THREAD_POOL_PRIORITY_HIGH,
-            higher  = PLUTO_THREAD_POOL_PRIORITY_HIGHER,
-            highest = PLUTO_THREAD_POOL_PRIORITY_HIGHEST
+            static_assert((PLUTO_THREAD_POOL_WORK_QUEUE_SIZE & (PLUTO_THREAD_POOL_WORK_QUEUE_SIZE - 1)) == 0,
+                "PLUTO_THREAD_POOL_WORK_QUEUE_SIZE must be a power of 2");
+
+            std::atomic<std::int64_t>   m_top       { 0 };
+            char                        m_padding[64];      // Keeps thieves and the owner off the same cache line
+            std::atomic<std::int64_t>   m_bottom    { 0 };
+            std::atomic<task_info*>     m_tasks[PLUTO_THREAD_POOL_WORK_QUEUE_SIZE];
+
+            std::atomic<task_info*>& at(const std::int64_t index)
+            {
+                return m_tasks[static_cast<std::size_t>(index) & (PLUTO_THREAD_POOL_WORK_QUEUE_SIZE - 1)];
+            }
+
+        public:
+            work_queue()
+            {
+                for (auto& task : m_tasks)
+                {
+                    task.store(nullptr, std::memory_order_relaxed);
+                }
+            }
+
+            // Owner only. Fails if the queue is full.
+            bool push(task_info* const task)
+            {
+                const auto bottom{ m_bottom.load(std::memory_order_relaxed) };
+                if (PLUTO_THREAD_POOL_WORK_QUEUE_SIZE <= (bottom - m_top.load(std::memory_order_acquire)))
+                {
+                    return false;
+                }
+
+                at(bottom).store(task, std::memory_order_relaxed);
+                m_bottom.store(bottom + 1, std::memory_order_release);
+                return true;
+            }
+
+            // Owner only. Takes the newest task.
+            task_info* pop()
+            {
+                const auto bottom{ m_bottom.load(std::memory_order_relaxed) - 1 };
+                m_bottom.store(bottom);
+
+                auto top{ m_top.load() };
+                if (bottom < top)
+                {
+                    m_bottom.store(bottom + 1, std::memory_order_release);
+                    return nullptr;
+                }
+
+                auto task{ at(bottom).load(std::memory_order_relaxed) };
+                if (top == bottom)
+                {
+                    // Last task, so race any thieves for it
+                    if (!m_top.compare_exchange_strong(top, top + 1))
+                    {
+                        task = nullptr;
+                    }
+
+                    m_bottom.store(bottom + 1, std::memory_order_release);
+                }
+
+                return task;
+            }
+
+            // Any thread. Takes the oldest task, or fails if the queue is empty or another thread got there first.
+            task_info* steal()
+            {
+                auto top{ m_top.load() };
+                if (m_bottom.load() <= top)
+                {
+                    return nullptr;
+                }
+
+                const auto task{ at(top).load(std::memory_order_relaxed) };
+                return (m_top.compare_exchange_strong(top, top + 1) ? task : nullptr);
+            }
         };
 
-    private:
-        struct task_info
+        struct work_queues
         {
-            signed char             priority;
-            std::function<void()>   task;
+            bool        isOwned { false };
+            work_queue  levels[priority_levels];
+        };
 
-            task_info(
-                const signed char               priority,
-                const std::function<void()>&    task) :
-                priority{ priority },
-                task    { task } {}
+        struct worker_info
+        {
+            const thread_pool*      pool        { nullptr };
+            work_queues*            queues      { nullptr };
+            bool                    canQueue    { true };   // False once there were no work queues left to take
+            std::vector<task_info*> freeTasks   {};         // Taken tasks, kept to be queued again
         };
 
         typedef std::map<std::thread::id, std::thread> worker_map;
 
-        typedef std::multimap<signed char, std::function<void()>, pluto::is_greater> waiting_task_map;
+        typedef std::pair<const signed char, task_function> waiting_task;
+
+        typedef std::multimap<signed char, task_function, pluto::is_greater, node_allocator<waiting_task>> waiting_task_map;
 
         typedef std::multimap<clock_type::time_point, task_info> scheduled_task_map;
 
         mutable std::mutex      m_mutex                 {};
         worker_map              m_workers               {};
         std::thread             m_scheduler             {};
-        waiting_task_map        m_waitingTasks          {};
+        node_pool               m_waitingNodes          {};     // Declared first, so it outlives the waiting tasks
+        waiting_task_map        m_waitingTasks          { waiting_task_map::allocator_type{ m_waitingNodes } };
         scheduled_task_map      m_scheduledTasks        {};
         std::condition_variable m_workersCondition      {};
         std::condition_variable m_schedulerCondition    {};
         std::condition_variable m_tasksWorkingCondition {};
         std::condition_variable m_tasksCompleteCondition{};
 
-        action      m_onStop;
-        bool        m_isStopping;
-        std::size_t m_targetWorkersSize;
-        std::size_t m_activeWorkersSize;
+        action              m_onStop;
+        std::atomic_bool    m_isStopping;
+        std::atomic_bool    m_isWorkStealing;
+        std::size_t         m_targetWorkersSize;
+        std::size_t         m_activeWorkersSize;
+
+        // Work stealing. The work queues are kept until the thread pool is destroyed, so thieves never need to lock.
+        std::atomic<work_queues*>   m_workQueues[PLUTO_THREAD_POOL_MAX_WORK_QUEUES];
+        std::atomic_size_t          m_workQueuesSize            { 0 };
+        std::atomic_size_t          m_queuedTasksSizes[priority_levels];
+        std::atomic<int>            m_waitingLevel              { -1 };     // Priority level of the next waiting task, or -1
+        std::atomic_size_t          m_sleepingWorkersSize       { 0 };
 
     public:
         explicit thread_pool(const std::size_t targetWorkersSize = std::thread::hardware_concurrency()) :
             m_onStop            { action::join_all },
             m_isStopping        { false },
+            m_isWorkStealing    { false },
             m_targetWorkersSize { targetWorkersSize },
             m_activeWorkersSize { 0 }
         {
+            for (auto& workQueues : m_workQueues)
+            {
+                workQueues.store(nullptr, std::memory_order_relaxed);
+            }
+
+            for (auto& queuedTasksSize : m_queuedTasksSizes)
+            {
+                queuedTasksSize.store(0, std::memory_order_relaxed);
+            }
+
             const std::unique_lock<std::mutex> lock{ m_mutex };
 
             while (m_workers.size() < m_targetWorkersSize)
@@ -146,6 +914,12 @@ namespace pluto
             {
                 m_scheduler.join();
             }
+
+            // Workers give their queued tasks back when they exit, so the work queues are empty
+            for (std::size_t i{ 0 }; i < m_workQueuesSize.load(); ++i)
+            {
+                delete m_workQueues[i].load();
+            }
         }
 
         thread_pool(const thread_pool&) = delete;
@@ -189,7 +963,7 @@ namespace pluto
         PLUTO_UTILS_NODISCARD inline std::size_t tasks_size() const
         {
             const std::unique_lock<std::mutex> lock{ m_mutex };
-            return (m_waitingTasks.size() + m_activeWorkersSize);
+            return (m_waitingTasks.size() + queued_tasks_size() + m_activeWorkersSize);
         }
 
         PLUTO_UTILS_NODISCARD inline std::size_t active_tasks_size() const
@@ -201,7 +975,7 @@ namespace pluto
         PLUTO_UTILS_NODISCARD inline std::size_t waiting_tasks_size() const
         {
             const std::unique_lock<std::mutex> lock{ m_mutex };
-            return m_waitingTasks.size();
+            return (m_waitingTasks.size() + queued_tasks_size());
         }
 
         PLUTO_UTILS_NODISCARD inline std::size_t scheduled_tasks_size() const
@@ -216,6 +990,11 @@ namespace pluto
             return m_onStop;
         }
 
+        PLUTO_UTILS_NODISCARD inline bool work_stealing() const
+        {
+            return m_isWorkStealing.load();
+        }
+
         thread_pool& target_workers_size(const std::size_t targetWorkersSize)
         {
             std::unique_lock<std::mutex> lock{ m_mutex };
@@ -248,13 +1027,26 @@ namespace pluto
             return *this;
         }
 
+        // Tasks that are already queued by workers are still run when this is turned off
+        inline thread_pool& work_stealing(const bool isWorkStealing)
+        {
+            m_isWorkStealing.store(isWorkStealing);
+            return *this;
+        }
+
         void run_async(
-            const std::function<void()>&    task,
-            const signed char               priority = PLUTO_THREAD_POOL_PRIORITY_NORMAL)
+            task_function       task,
+            const signed char   priority = PLUTO_THREAD_POOL_PRIORITY_NORMAL)
         {
+            if (queue_task(task, priority))
+            {
+                return;
+            }
+
             {
                 const std::unique_lock<std::mutex> lock{ m_mutex };
-                m_waitingTasks.emplace(priority, task);
+                m_waitingTasks.emplace(priority, std::move(task));
+                update_waiting_level();
             }
 
             // Wake a worker thread
@@ -262,44 +1054,58 @@ namespace pluto
         }
 
         inline void run_async(
-            const std::function<void()>&    task,
-            const priority                  priority)
+            task_function   task,
+            const priority  priority)
         {
-            run_async(task, static_cast<const signed char>(priority));
+            run_async(std::move(task), static_cast<const signed char>(priority));
         }
 
+        template<class Function>
         void run_sync(
-            const std::function<void()>&    task,
-            const signed char               priority = PLUTO_THREAD_POOL_PRIORITY_HIGH)
+            Function&&          task,
+            const signed char   priority = PLUTO_THREAD_POOL_PRIORITY_HIGH)
         {
-            std::promise<void> promise{};
-            run_async([task, &promise]
+            std::mutex              mutex       {};
+            std::condition_variable condition   {};
+            bool                    isComplete  { false };
+
+            // The task is only referred to, since this waits for it
+            run_async([&task, &mutex, &condition, &isComplete]()
                 {
                     task();
-                    promise.set_value();
+
+                    // Notified with the mutex locked, so the waiting thread can't return and destroy the condition first
+                    const std::unique_lock<std::mutex> lock{ mutex };
+                    isComplete = true;
+                    condition.notify_one();
                 },
                 priority
             );
 
             // Wait for task completion
-            promise.get_future().wait();
+            std::unique_lock<std::mutex> lock{ mutex };
+            while (!isComplete)
+            {
+                condition.wait(lock);
+            }
         }
 
+        template<class Function>
         inline void run_sync(
-            const std::function<void()>&    task,
-            const priority                  priority)
+            Function&&      task,
+            const priority  priority)
         {
-            run_sync(task, static_cast<const signed char>(priority));
+            run_sync(std::forward<Function>(task), static_cast<const signed char>(priority));
         }
 
         void run_at(
             const clock_type::time_point&   time,
-            const std::function<void()>&    task,
+            task_function                   task,
             const signed char               priority = PLUTO_THREAD_POOL_PRIORITY_NORMAL)
         {
             std::unique_lock<std::mutex> lock{ m_mutex };
 
-            m_scheduledTasks.emplace(time, task_info{ priority, task });
+            m_scheduledTasks.emplace(time, task_info{ priority, std::move(task) });
 
             if (!m_scheduler.joinable())
             {
@@ -316,33 +1122,71 @@ namespace pluto
 
         inline void run_at(
             const clock_type::time_point&   time,
-            const std::function<void()>&    task,
+            task_function                   task,
             const priority                  priority)
         {
-            run_at(time, task, static_cast<const signed char>(priority));
+            run_at(time, std::move(task), static_cast<const signed char>(priority));
         }
 
         inline void run_after(
             const clock_type::duration&     duration,
-            const std::function<void()>&    task,
+            task_function                   task,
             const signed char               priority = PLUTO_THREAD_POOL_PRIORITY_NORMAL)
         {
-            run_at((clock_type::now() + duration), task, priority);
+            run_at((clock_type::now() + duration), std::move(task), priority);
         }
 
         inline void run_after(
             const clock_type::duration&     duration,
-            const std::function<void()>&    task,
+            task_function                   task,
             const priority                  priority)
         {
-            run_after(duration, task, static_cast<const signed char>(priority));
+            run_after(duration, std::move(task), static_cast<const signed char>(priority));
+        }
+
+        // Runs the function with these arguments, which are moved or copied into the task. The result, or the
+        // exception the function throws, is given to the future. Use std::ref() to pass an argument by reference.
+        template<class Function, class... Args>
+        inline auto submit(Function&& function, Args&&... args) -> task_future<submit_result<Function, Args...>>
+        {
+            return submit(static_cast<signed char>(PLUTO_THREAD_POOL_PRIORITY_NORMAL),
+                std::forward<Function>(function), std::forward<Args>(args)...);
+        }
+
+        template<class Function, class... Args>
+        auto submit(
+            const signed char   priority,
+            Function&&          function,
+            Args&&...           args) -> task_future<submit_result<Function, Args...>>
+        {
+            typedef submit_result<Function, Args...> result_type;
+
+            task_future<result_type> future{ new typename task_future<result_type>::shared_state{} };
+
+            run_async(
+                submitted_task<result_type, typename std::decay<Function>::type, typename std::decay<Args>::type...>{
+                    future.m_state, std::forward<Function>(function), std::forward<Args>(args)... },
+                priority
+            );
+
+            return future;
+        }
+
+        template<class Function, class... Args>
+        inline auto submit(
+            const priority  priority,
+            Function&&      function,
+            Args&&...       args) -> task_future<submit_result<Function, Args...>>
+        {
+            return submit(static_cast<signed char>(priority), std::forward<Function>(function),
+                std::forward<Args>(args)...);
         }
 
         inline void wait_until_no_tasks_waiting()
         {
             std::unique_lock<std::mutex> lock{ m_mutex };
 
-            while (!m_waitingTasks.empty())
+            while (!m_waitingTasks.empty() || queued_tasks_size() != 0)
             {
                 m_tasksWorkingCondition.wait(lock);
             }
@@ -352,7 +1196,7 @@ namespace pluto
         {
             std::unique_lock<std::mutex> lock{ m_mutex };
 
-            while (!m_waitingTasks.empty() || m_activeWorkersSize != 0)
+            while (!m_waitingTasks.empty() || queued_tasks_size() != 0 || m_activeWorkersSize != 0)
             {
                 m_tasksCompleteCondition.wait(lock);
             }
@@ -368,8 +1212,9 @@ namespace pluto
                 const auto begin{ m_scheduledTasks.begin() };
                 if (m_schedulerCondition.wait_until(lock, begin->first) == std::cv_status::timeout)
                 {
-                    m_waitingTasks.emplace(begin->second.priority, begin->second.task);
+                    m_waitingTasks.emplace(begin->second.priority, std::move(begin->second.task));
                     m_scheduledTasks.erase(begin);
+                    update_waiting_level();
 
                     // New task from schedule, wake one of the workers
                     m_workersCondition.notify_one();
@@ -384,39 +1229,78 @@ namespace pluto
 
         void start_working()
         {
+            auto& thisWorker{ this_worker() };
+            thisWorker = { this, nullptr, true };
+
             std::unique_lock<std::mutex> lock{ m_mutex };
 
             while (m_workers.size() <= m_targetWorkersSize &&
-                (!m_isStopping || (m_onStop == action::complete_tasks && !m_waitingTasks.empty())))
+                (!m_isStopping || (m_onStop == action::complete_tasks && (!m_waitingTasks.empty() || queued_tasks_size() != 0))))
             {
-                if (m_waitingTasks.empty())
+                task_function task{};
+                if (take_task(thisWorker, task))
                 {
-                    if (m_activeWorkersSize == 0)
+                    ++m_activeWorkersSize;
+                    lock.unlock();
+
+                    task();
+
+                    // Queued tasks are taken without locking, until a waiting task has the same or a higher priority
+                    while (!m_isStopping && take_queued_task(thisWorker, m_waitingLevel.load(), task))
                     {
-                        m_tasksCompleteCondition.notify_all();
+                        if (m_waitingLevel.load() == -1 && queued_tasks_size() == 0)
+                        {
+                            lock.lock();
+                            notify_if_no_tasks_waiting();
+                            lock.unlock();
+                        }
+
+                        task();
                     }
 
-                    m_workersCondition.wait(lock);
+                    lock.lock();
+                    --m_activeWorkersSize;
+                }
+                else if (queued_tasks_size() != 0)
+                {
+                    // A task is still being queued, or another worker just took it
+                    lock.unlock();
+                    std::this_thread::yield();
+                    lock.lock();
                 }
                 else
                 {
-                    const auto begin{ m_waitingTasks.begin() };
-                    const auto task { std::move(begin->second) };
-                    m_waitingTasks.erase(begin);
+                    if (m_activeWorkersSize == 0)
+                    {
+                        m_tasksCompleteCondition.notify_all();
+                    }
 
-                    if (m_waitingTasks.empty())
+                    // Workers queueing tasks only lock to wake this worker if it's counted as sleeping
+                    ++m_sleepingWorkersSize;
+                    if (queued_tasks_size() == 0)
                     {
-                        m_tasksWorkingCondition.notify_all();
+                        m_workersCondition.wait(lock);
                     }
-                    
-                    ++m_activeWorkersSize;
-                    lock.unlock();
+                    --m_sleepingWorkersSize;
+                }
+            }
 
-                    task();
+            if (thisWorker.queues != nullptr)
+            {
+                release_work_queues(*thisWorker.queues);
+            }
 
-                    lock.lock();
-                    --m_activeWorkersSize;
-                }
+            for (const auto freeTask : thisWorker.freeTasks)
+            {
+                delete freeTask;
+            }
+
+            thisWorker = {};
+
+            // This worker may have completed the last task, and waiters are only told by workers that are going to sleep
+            if (m_activeWorkersSize == 0 && m_waitingTasks.empty() && queued_tasks_size() == 0)
+            {
+                m_tasksCompleteCondition.notify_all();
             }
 
             if (!m_isStopping)
@@ -429,6 +1313,261 @@ namespace pluto
                 }
             }
         }
+
+        static worker_info& this_worker()
+        {
+            thread_local worker_info thisWorker{};
+            return thisWorker;
+        }
+
+        static int priority_level(const signed char priority)
+        {
+            return
+                (priority >= PLUTO_THREAD_POOL_PRIORITY_HIGHEST)    ? 6 :
+                (priority >= PLUTO_THREAD_POOL_PRIORITY_HIGHER)     ? 5 :
+                (priority >= PLUTO_THREAD_POOL_PRIORITY_HIGH)       ? 4 :
+                (priority >= PLUTO_THREAD_POOL_PRIORITY_NORMAL)     ? 3 :
+                (priority >= PLUTO_THREAD_POOL_PRIORITY_LOW)        ? 2 :
+                (priority >= PLUTO_THREAD_POOL_PRIORITY_LOWER)      ? 1 : 0;
+        }
+
+        std::size_t queued_tasks_size() const
+        {
+            std::size_t queuedTasksSize{ 0 };
+            for (const auto& levelSize : m_queuedTasksSizes)
+            {
+                queuedTasksSize += levelSize.load();
+            }
+
+            return queuedTasksSize;
+        }
+
+        // Must be called with the mutex locked, whenever waiting tasks are added or removed
+        void update_waiting_level()
+        {
+            m_waitingLevel.store(m_waitingTasks.empty() ? -1 : priority_level(m_waitingTasks.begin()->first));
+        }
+
+        // Queues the task on this worker's work queue, if this is one of our workers and work stealing is on
+        // Only moves the task if it was queued.
+        bool queue_task(task_function& task, const signed char priority)
+        {
+            auto& thisWorker{ this_worker() };
+            if (thisWorker.pool != this || !m_isWorkStealing.load(std::memory_order_relaxed))
+            {
+                return false;
+            }
+
+            if (thisWorker.queues == nullptr)
+            {
+                if (!thisWorker.canQueue)
+                {
+                    return false;
+                }
+
+                const std::unique_lock<std::mutex> lock{ m_mutex };
+                thisWorker.queues = take_work_queues();
+                thisWorker.canQueue = (thisWorker.queues != nullptr);
+
+                if (thisWorker.queues == nullptr)
+                {
+                    return false;
+                }
+            }
+
+            const auto level{ priority_level(priority) };
+            const auto queuedTask{ new_task_info(thisWorker, priority, std::move(task)) };
+
+            // Counted first, so workers never sleep while a task is being queued
+            ++m_queuedTasksSizes[level];
+            if (!thisWorker.queues->levels[level].push(queuedTask))
+            {
+                --m_queuedTasksSizes[level];
+                task = std::move(queuedTask->task);
+                free_task_info(thisWorker, queuedTask);
+                return false;
+            }
+
+            if (m_sleepingWorkersSize.load() != 0)
+            {
+                // Locking orders this with a worker that's about to sleep, so it can't miss the notification
+                {
+                    const std::unique_lock<std::mutex> lock{ m_mutex };
+                }
+
+                m_workersCondition.notify_one();
+            }
+
+            return true;
+        }
+
+        // Reuses a task taken by this worker if there is one, since workers queue and take tasks without locking
+        static task_info* new_task_info(worker_info& thisWorker, const signed char priority, task_function&& task)
+        {
+            if (thisWorker.freeTasks.empty())
+            {
+                return new task_info{ priority, std::move(task) };
+            }
+
+            const auto taskInfo{ thisWorker.freeTasks.back() };
+            thisWorker.freeTasks.pop_back();
+
+            taskInfo->priority = priority;
+            taskInfo->task = std::move(task);
+            return taskInfo;
+        }
+
+        static void free_task_info(worker_info& thisWorker, task_info* const taskInfo)
+        {
+            if (thisWorker.freeTasks.size() == PLUTO_THREAD_POOL_WORK_QUEUE_SIZE)
+            {
+                delete taskInfo;
+                return;
+            }
+
+            taskInfo->task.reset();
+            thisWorker.freeTasks.push_back(taskInfo);
+        }
+
+        // Must be called with the mutex locked
+        work_queues* take_work_queues()
+        {
+            const auto workQueuesSize{ m_workQueuesSize.load() };
+            for (std::size_t i{ 0 }; i < workQueuesSize; ++i)
+            {
+                const auto workQueues{ m_workQueues[i].load() };
+                if (!workQueues->isOwned)
+                {
+                    workQueues->isOwned = true;
+                    return workQueues;
+                }
+            }
+
+            if (workQueuesSize == PLUTO_THREAD_POOL_MAX_WORK_QUEUES)
+            {
+                return nullptr;
+            }
+
+            const auto workQueues{ new work_queues{} };
+            workQueues->isOwned = true;
+
+            m_workQueues[workQueuesSize].store(workQueues);
+            m_workQueuesSize.store(workQueuesSize + 1);
+            return workQueues;
+        }
+
+        // Must be called with the mutex locked. Moves anything still queued to the waiting tasks.
+        void release_work_queues(work_queues& workQueues)
+        {
+            bool hasMovedTasks{ false };
+            for (int level{ 0 }; level < priority_levels; ++level)
+            {
+                while (const auto queuedTask{ workQueues.levels[level].pop() })
+                {
+                    m_waitingTasks.emplace(queuedTask->priority, std::move(queuedTask->task));
+                    --m_queuedTasksSizes[level];
+                    delete queuedTask;
+                    hasMovedTasks = true;
+                }
+            }
+
+            workQueues.isOwned = false;
+
+            if (hasMovedTasks)
+            {
+                update_waiting_level();
+                m_workersCondition.notify_all();
+            }
+        }
+
+        // Takes the highest priority task above the minimum level, from this worker's work queues or another's
+        bool take_queued_task(worker_info& thisWorker, const int minLevel, task_function& task)
+        {
+            const auto workQueues{ thisWorker.queues };
+
+            for (int level{ priority_levels - 1 }; level > minLevel; --level)
+            {
+                if (m_queuedTasksSizes[level].load() == 0)
+                {
+                    continue;
+                }
+
+                auto queuedTask{ (workQueues != nullptr) ? workQueues->levels[level].pop() : nullptr };
+                if (queuedTask == nullptr)
+                {
+                    queuedTask = steal_task(workQueues, level);
+                }
+
+                if (queuedTask != nullptr)
+                {
+                    --m_queuedTasksSizes[level];
+                    task = std::move(queuedTask->task);
+                    free_task_info(thisWorker, queuedTask);
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        // Tries every other worker's work queue for this level, starting from a random one
+        task_info* steal_task(const work_queues* const workQueues, const int level)
+        {
+            thread_local std::uint32_t random{ static_cast<std::uint32_t>(std::hash<std::thread::id>{}(std::this_thread::get_id())) | 1 };
+
+            // Xorshift
+            random ^= (random << 13);
+            random ^= (random >> 17);
+            random ^= (random << 5);
+
+            const auto workQueuesSize{ m_workQueuesSize.load() };
+            for (std::size_t i{ 0 }; i < workQueuesSize; ++i)
+            {
+                const auto victim{ m_workQueues[(random + i) % workQueuesSize].load() };
+                if (victim != workQueues)
+                {
+                    const auto queuedTask{ victim->levels[level].steal() };
+                    if (queuedTask != nullptr)
+                    {
+                        return queuedTask;
+                    }
+                }
+            }
+
+            return nullptr;
+        }
+
+        // Must be called with the mutex locked. Takes the highest priority task, queued or waiting.
+        bool take_task(worker_info& thisWorker, task_function& task)
+        {
+            if (take_queued_task(thisWorker, m_waitingLevel.load(), task))
+            {
+                notify_if_no_tasks_waiting();
+                return true;
+            }
+
+            if (!m_waitingTasks.empty())
+            {
+                const auto begin{ m_waitingTasks.begin() };
+                task = std::move(begin->second);
+                m_waitingTasks.erase(begin);
+                update_waiting_level();
+
+                notify_if_no_tasks_waiting();
+                return true;
+            }
+
+            return false;
+        }
+
+        // Must be called with the mutex locked
+        void notify_if_no_tasks_waiting()
+        {
+            if (m_waitingTasks.empty() && queued_tasks_size() == 0)
+            {
+                m_tasksWorkingCondition.notify_all();
+            }
+        }
     };
 }
 
@@ -69,6 +69,17 @@
 #endif
 #endif
 
+#ifndef PLUTO_UTILS_HAS_TO_CHARS
+#if PLUTO_UTILS_HAS_CXX_17 && __has_include(<charconv>)
+#include <charconv>
+#endif
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+#define PLUTO_UTILS_HAS_TO_CHARS 1
+#else
+#define PLUTO_UTILS_HAS_TO_CHARS 0
+#endif
+#endif
+
 #ifndef PLUTO_UTILS_HAS_SOURCE_LOCATION
 #if PLUTO_UTILS_HAS_CXX_20 && __has_include(<source_location>)
 #define PLUTO_UTILS_HAS_SOURCE_LOCATION 1
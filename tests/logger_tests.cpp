@@ -24,6 +24,12 @@
 class logger_tests : public testing::Test
 {
 protected:
+    void SetUp() override
+    {
+        // Each test removes the log file, and the instance has to notice before its next write
+        pluto::logger::instance().file_check_interval(std::chrono::milliseconds(0));
+    }
+
     void TearDown() override
     {
         if (pluto::filesystem::exists(LOG_FILE))
@@ -211,6 +217,63 @@ TEST_F(logger_tests, test_format_does_formatting)
 }
 #endif
 
+TEST_F(logger_tests, test_stream_does_formatting)
+{
+    const std::string text{ "Test" };
+    const char* const nullText{ nullptr };
+
+    std::ostringstream expected{};
+    expected << "Log message: " << 1 << ' ' << -42L << ' ' << (std::numeric_limits<long long>::min)() << ' '
+        << (std::numeric_limits<unsigned long long>::max)() << ' ' << 3.14159265 << ' ' << 1e-7 << ' ' << 2.5f << ' '
+        << 100000000.0 << ' ' << 0.0 << ' ' << 1.5L << ' ' << true << ' ' << 'c' << ' ' << text << ' ' << static_cast<short>(-7);
+
+    LOG_STREAM(info, "Log message: " << 1 << ' ' << -42L << ' ' << (std::numeric_limits<long long>::min)() << ' '
+        << (std::numeric_limits<unsigned long long>::max)() << ' ' << 3.14159265 << ' ' << 1e-7 << ' ' << 2.5f << ' '
+        << 100000000.0 << ' ' << 0.0 << ' ' << 1.5L << ' ' << true << ' ' << 'c' << ' ' << text << nullText << ' ' << static_cast<short>(-7));
+    ASSERT_EQ(expected.str(), last_log_message());
+
+    // Manipulators apply to the values after them
+    expected.str(std::string{});
+    expected << 255 << ' ' << std::hex << 255 << ' ' << std::setw(6) << std::setfill('0') << 42 << ' ' << std::boolalpha << true;
+
+    LOG_STREAM(info, 255 << ' ' << std::hex << 255 << ' ' << std::setw(6) << std::setfill('0') << 42 << ' ' << std::boolalpha << true);
+    ASSERT_EQ(expected.str(), last_log_message());
+
+    // Messages longer than the inline buffer
+    const std::string longText(PLUTO_LOGGER_STREAMER_INLINE_SIZE, 'x');
+
+    LOG_STREAM(info, longText << 12345 << longText << 0.5);
+    ASSERT_EQ(longText + "12345" + longText + "0.5", last_log_message());
+}
+
+TEST_F(logger_tests, test_write_kv_does_formatting)
+{
+    const std::string name{ "Jane Doe" };
+    const auto missing{ std::numeric_limits<double>::infinity() };
+
+    PLUTO_LOG_WRITE_KV(LOG_FILE, info, "Request done", pluto::kv("user", 42), pluto::kv("name", name),
+        pluto::kv("ok", true), pluto::kv("latency", 1.5), pluto::kv("path", "/a=b"), pluto::kv("grade", 'A'));
+    ASSERT_EQ("msg=\"Request done\" user=42 name=\"Jane Doe\" ok=true latency=1.5 path=\"/a=b\" grade=A", last_log_message());
+
+    PLUTO_LOG_WRITE_KV(LOG_FILE, info, "Done");
+    ASSERT_EQ("msg=Done", last_log_message());
+
+    pluto::logger::instance().field_format(pluto::log_fields::json);
+
+    PLUTO_LOG_WRITE_KV(LOG_FILE, info, "Request \"done\"", pluto::kv("user", -42L), pluto::kv("name", name),
+        pluto::kv("ok", false), pluto::kv("latency", 1.5f), pluto::kv("missing", missing), pluto::kv("path", "C:\\logs\n"));
+    ASSERT_EQ("{\"msg\":\"Request \\\"done\\\"\",\"user\":-42,\"name\":\"Jane Doe\",\"ok\":false,\"latency\":1.5,"
+        "\"missing\":null,\"path\":\"C:\\\\logs\\n\"}", last_log_message());
+
+    // Fields are captured the same way in thread buffers
+    pluto::logger::instance().field_format(pluto::log_fields::logfmt).thread_buffer_size(16);
+
+    PLUTO_LOG_WRITE_KV(LOG_FILE, info, "", pluto::kv("empty", ""), pluto::kv("size", std::size_t{ 7 }));
+    ASSERT_EQ("msg=\"\" empty=\"\" size=7", last_log_message());
+
+    pluto::logger::instance().thread_buffer_size(PLUTO_LOGGER_INITIAL_THREAD_BUFFER_SIZE);
+}
+
 TEST_F(logger_tests, test_write_writes_all_logs)
 {
     std::size_t numLogs{ 100 };
@@ -288,3 +351,1524 @@ TEST_F(logger_tests, test_stream_writes_all_logs)
 
     ASSERT_EQ(count_logs(), 902); // +2 for header
 }
+
+// Counts the logs with a message that starts with the prefix
+std::size_t count_messages(const std::string& prefix)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    std::size_t messageCount{ 0 };
+    std::ifstream logFile{ LOG_FILE };
+
+    for (std::string log{}; std::getline(logFile, log); )
+    {
+        messageCount += ((log.compare(log.rfind('|') + 1, prefix.size(), prefix) == 0) ? 1 : 0);
+    }
+
+    return messageCount;
+}
+
+TEST_F(logger_tests, test_rate_limited_writes)
+{
+    pluto::log_limiter everyLimiter{};
+    pluto::log_limiter firstLimiter{};
+
+    std::vector<std::size_t> everyAllowed{};
+    std::vector<std::size_t> firstAllowed{};
+    for (std::size_t i{ 0 }; i < 10; ++i)
+    {
+        if (everyLimiter.every_n(3))
+        {
+            everyAllowed.push_back(i);
+        }
+
+        if (firstLimiter.first_n(2, 4))
+        {
+            firstAllowed.push_back(i);
+        }
+    }
+
+    ASSERT_EQ(everyAllowed, (std::vector<std::size_t>{ 0, 3, 6, 9 }));
+    ASSERT_EQ(everyLimiter.num_suppressed(), 6);
+    ASSERT_EQ(firstAllowed, (std::vector<std::size_t>{ 0, 1, 5, 9 }));
+    ASSERT_EQ(firstLimiter.num_suppressed(), 6);
+
+    // The summary is written once, and the count starts again
+    {
+        pluto::logger logger{};
+        everyLimiter.write_suppressed(logger, LOG_FILE, pluto::log_level::info, pluto::source_info{ __FILE__, __LINE__, "" });
+        everyLimiter.write_suppressed(logger, LOG_FILE, pluto::log_level::info, pluto::source_info{ __FILE__, __LINE__, "" });
+    }
+
+    ASSERT_EQ(everyLimiter.num_suppressed(), 0);
+    ASSERT_EQ(count_logs(), 3); // +2 for header
+    ASSERT_EQ(last_log_message(), "Suppressed 6 logs");
+
+    // The macros keep a limiter for each call site, which carries on from any earlier run of this test.
+    // Whatever the count was, 9 calls allow every third one, with 2 suppressed between each.
+    const auto numEvery         { count_messages("Every n") };
+    const auto numSuppressed    { count_messages("Suppressed 2 logs") };
+    for (std::size_t i{ 0 }; i < 9; ++i)
+    {
+        PLUTO_LOG_WRITE_EVERY_N(LOG_FILE, info, 3, "Every n");
+    }
+
+    ASSERT_EQ(count_messages("Every n"), numEvery + 3);
+    ASSERT_GE(count_messages("Suppressed 2 logs"), numSuppressed + 2);
+
+    // 12 calls allow every fourth one, and the first 2 as well if this is the first run
+    const auto numFirst{ count_messages("First n ") };
+    for (std::size_t i{ 0 }; i < 12; ++i)
+    {
+        PLUTO_LOG_WRITEF_FIRST_N(LOG_FILE, info, 2, 4, "First n %zu", i);
+    }
+
+    ASSERT_LE(numFirst + 3, count_messages("First n "));
+    ASSERT_GE(numFirst + 4, count_messages("First n "));
+
+    // The window can move on once during the loop
+    pluto::log_limiter limiter{};
+
+    std::size_t numAllowed{ 0 };
+    for (std::size_t i{ 0 }; i < 100; ++i)
+    {
+        numAllowed += (limiter.per_second(5) ? 1 : 0);
+    }
+
+    ASSERT_LE(5u, numAllowed);
+    ASSERT_GE(10u, numAllowed);
+    ASSERT_EQ(limiter.num_suppressed(), (100 - numAllowed));
+}
+
+TEST_F(logger_tests, test_thread_buffers_write_all_logs)
+{
+    std::size_t numThreads{ 4 };
+    std::size_t numLogs{ 100 };
+
+    {
+        pluto::logger logger{};
+        logger.thread_buffer_size(numLogs);
+
+        std::vector<std::thread> threads{};
+        for (std::size_t i{ 0 }; i < numThreads; ++i)
+        {
+            threads.emplace_back([&logger, numLogs]()
+                {
+                    for (std::size_t j{ 0 }; j < numLogs; ++j)
+                    {
+                        PLUTO_LOG_WRITE_WITH(logger, LOG_FILE, info, "Log message");
+                    }
+                }
+            );
+        }
+
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        ASSERT_EQ(logger.num_discarded_logs(), 0);
+    }
+
+    ASSERT_EQ(count_logs(), 402); // +2 for header
+}
+
+TEST_F(logger_tests, test_write_message_bigger_than_buffer_block)
+{
+    const std::string message(PLUTO_LOGGER_BUFFER_BLOCK_SIZE, 'x');
+
+    LOG_WRITE(info, "Log message");
+    LOG_WRITE(info, message);
+    LOG_WRITE(info, "Log message");
+
+    ASSERT_EQ(count_logs(), 5); // +2 for header
+    ASSERT_EQ(last_log_message(), "Log message");
+}
+
+template<class... Args>
+std::string render_printf(const char* const scheme, const Args&... args)
+{
+    std::string buffer(pluto::log_args::size(scheme, args...), '\0');
+    pluto::log_args::write(&buffer[0], scheme, args...);
+
+    std::string message{};
+    pluto::log_args::render_printf(message, buffer.data(), buffer.size());
+    return message;
+}
+
+template<class... Args>
+std::string render_format(const char* const scheme, const Args&... args)
+{
+    std::string buffer(pluto::log_args::size(scheme, args...), '\0');
+    pluto::log_args::write(&buffer[0], scheme, args...);
+
+    std::string message{};
+    pluto::log_args::render_format(message, buffer.data(), buffer.size());
+    return message;
+}
+
+template<class... Args>
+std::string snprintf_message(const char* const scheme, const Args&... args)
+{
+    char message[256];
+    std::snprintf(message, sizeof(message), scheme, args...);
+    return message;
+}
+
+TEST_F(logger_tests, test_log_args_render_printf)
+{
+    const std::string text{ "text" };
+
+    ASSERT_EQ(render_printf("No args"), "No args");
+    ASSERT_EQ(render_printf("%d %i %5d %-5d| %05d", -5, 6, 7, 8, 9), snprintf_message("%d %i %5d %-5d| %05d", -5, 6, 7, 8, 9));
+    ASSERT_EQ(render_printf("%u %x %X %o %#x", 1u, 255u, 255u, 8u, 255u), snprintf_message("%u %x %X %o %#x", 1u, 255u, 255u, 8u, 255u));
+    ASSERT_EQ(render_printf("%x %hhd %hu", -1, 300, 70000), snprintf_message("%x %hhd %hu", -1, 300, 70000));
+    ASSERT_EQ(render_printf("%lld %llu %zu", -1234567890123LL, 1234567890123ULL, std::size_t{ 42 }), "-1234567890123 1234567890123 42");
+    ASSERT_EQ(render_printf("%f %.2f %10.3e %g %Lf", 3.14159, 2.5f, 1234.5, 0.0001, 1.5L), snprintf_message("%f %.2f %10.3e %g %Lf", 3.14159, 2.5f, 1234.5, 0.0001, 1.5L));
+    ASSERT_EQ(render_printf("%s|%10s|%-10s|%.2s", "abc", "abc", text.c_str(), "abc"), "abc|       abc|text      |ab");
+    ASSERT_EQ(render_printf("%s and %s", text, std::string{ "more" }), "text and more");
+    ASSERT_EQ(render_printf("%c%c %% %*d %.*f", 'o', 'k', 4, 5, 1, 2.25), snprintf_message("%c%c %% %*d %.*f", 'o', 'k', 4, 5, 1, 2.25));
+    ASSERT_EQ(render_printf("%d %d", 1), "1 %d");
+}
+
+TEST_F(logger_tests, test_log_args_render_format)
+{
+    ASSERT_EQ(render_format("No args"), "No args");
+    ASSERT_EQ(render_format("{} {} {} {}", 1, "two", 3.5, true), "1 two 3.5 true");
+    ASSERT_EQ(render_format("{1} {0} {{}}", 1, 2), "2 1 {}");
+    ASSERT_EQ(render_format("{} {}", 1), "1 {}");
+
+#if PLUTO_UTILS_HAS_FORMAT
+    ASSERT_EQ(render_format("{:>5}|{:<5}|{:^5}", 1, 2, 3), "    1|2    |  3  ");
+    ASSERT_EQ(render_format("{:x} {:#06b} {:.2f} {:8.3e}", 255, 5, 3.14159, 1234.5), "ff 0b0101 3.14 1.234e+03");
+    ASSERT_EQ(render_format("{:{}}|{:.{}f}", 7, 3, 2.5, 2), "  7|2.50");
+    ASSERT_EQ(render_format("{} {}", 0.1f, 0.1), "0.1 0.1");
+#endif
+}
+
+TEST_F(logger_tests, test_deferred_formatting_writes_all_logs)
+{
+    std::size_t numLogs{ 100 };
+
+    {
+        pluto::logger logger{};
+        logger.deferred_formatting(true);
+
+        for (std::size_t i{ 0 }; i < numLogs; ++i)
+        {
+            PLUTO_LOG_WRITEF_WITH(logger, LOG_FILE, info, "Log writef %zu of %zu", i, numLogs);
+#if PLUTO_UTILS_HAS_FORMAT
+            PLUTO_LOG_FORMAT_WITH(logger, LOG_FILE, info, "Log format {} of {}", i, numLogs);
+#endif
+        }
+
+        PLUTO_LOG_WRITEF_WITH(logger, LOG_FILE, info, "Log message: %d, %s", 1, "Test");
+    }
+
+    ASSERT_EQ(last_log_message(), "Log message: 1, Test");
+#if PLUTO_UTILS_HAS_FORMAT
+    ASSERT_EQ(count_logs(), (numLogs * 2) + 3); // +2 for header
+#else
+    ASSERT_EQ(count_logs(), numLogs + 3); // +2 for header
+#endif
+}
+
+TEST_F(logger_tests, test_deferred_formatting_bounds_strings)
+{
+    // Not terminated, so it can only be read as far as the precision
+    const char buffer[]{ 'a', 'b', 'c', 'd' };
+    char* const pointer{ nullptr };
+
+    {
+        pluto::logger logger{};
+        logger.deferred_formatting(true);
+
+        PLUTO_LOG_WRITEF_WITH(logger, LOG_FILE, info, "%.*s %.3s %p %s", 4, buffer, buffer, pointer, "end");
+    }
+
+    char expected[64];
+    std::snprintf(expected, sizeof(expected), "abcd abc %p end", static_cast<void*>(pointer));
+    ASSERT_EQ(last_log_message(), expected);
+}
+
+TEST_F(logger_tests, test_deferred_formatting_wide_strings)
+{
+    const wchar_t* const wide{ L"world" };
+    const int values[]{ 1, 2 };
+
+    char expected[64];
+    std::snprintf(expected, sizeof(expected), "wide=hello world %p", static_cast<const void*>(values));
+
+    // Wide strings are formatted straight away, so deferring doesn't change the message
+    for (const auto deferredFormatting : { false, true })
+    {
+        {
+            pluto::logger logger{};
+            logger.deferred_formatting(deferredFormatting);
+
+            PLUTO_LOG_WRITEF_WITH(logger, LOG_FILE, info, "wide=%ls %ls %p", L"hello", wide, values);
+        }
+
+        ASSERT_EQ(last_log_message(), expected);
+        pluto::filesystem::remove(LOG_FILE);
+    }
+
+    {
+        pluto::logger logger{};
+        logger.binary_mode(true);
+
+        PLUTO_LOG_WRITEF_WITH(logger, LOG_FILE, info, "wide=%ls %ls %p", L"hello", wide, values);
+    }
+
+    std::vector<std::string> messages{};
+    std::ifstream fileStream{ LOG_FILE, std::ios_base::binary };
+
+    ASSERT_TRUE(pluto::logger::read_binary_log(fileStream, [&messages](const pluto::log_entry& log) { messages.push_back(log.message); }));
+    ASSERT_EQ(messages, std::vector<std::string>{ expected });
+}
+
+TEST_F(logger_tests, test_binary_mode_round_trip)
+{
+    std::size_t numLogs{ 100 };
+    int writefLine{ 0 };
+
+    {
+        pluto::logger logger{};
+        logger.binary_mode(true);
+
+        for (std::size_t i{ 0 }; i < numLogs; ++i)
+        {
+            PLUTO_LOG_WRITEF_WITH(logger, LOG_FILE, info, "Log writef %zu of %zu", i, numLogs); writefLine = __LINE__;
+#if PLUTO_UTILS_HAS_FORMAT
+            PLUTO_LOG_FORMAT_WITH(logger, LOG_FILE, warning, "Log format {} of {}", i, numLogs);
+#endif
+        }
+
+        PLUTO_LOG_WRITE_WITH(logger, LOG_FILE, error, "Log write");
+        PLUTO_LOG_STREAM_WITH(logger, LOG_FILE, debug, "Log stream " << 1.5);
+    }
+
+    std::vector<pluto::log_entry> logs{};
+    std::vector<std::string> sourceFiles{};
+    std::ifstream fileStream{ LOG_FILE, std::ios_base::binary };
+
+    // Source info is only valid during the call
+    ASSERT_TRUE(pluto::logger::read_binary_log(fileStream, [&](const pluto::log_entry& log)
+        {
+            logs.push_back(log);
+            sourceFiles.push_back(log.source.file);
+        }
+    ));
+
+#if PLUTO_UTILS_HAS_FORMAT
+    ASSERT_EQ(logs.size(), (numLogs * 2) + 2);
+    ASSERT_EQ(logs[1].level, pluto::log_level::warning);
+    ASSERT_EQ(logs[1].message, "Log format 0 of 100");
+    ASSERT_EQ(logs[(numLogs * 2) - 1].message, "Log format 99 of 100");
+#else
+    ASSERT_EQ(logs.size(), numLogs + 2);
+#endif
+
+    ASSERT_EQ(logs[0].level, pluto::log_level::info);
+    ASSERT_EQ(logs[0].message, "Log writef 0 of 100");
+    ASSERT_EQ(logs[0].thread_id, pluto::thread_id());
+    ASSERT_EQ(logs[logs.size() - 2].level, pluto::log_level::error);
+    ASSERT_EQ(logs[logs.size() - 2].message, "Log write");
+    ASSERT_EQ(logs[logs.size() - 1].message, "Log stream 1.5");
+
+#if !PLUTO_LOGGER_HIDE_SOURCE_INFO
+    ASSERT_EQ(sourceFiles[0], __FILE__);
+    ASSERT_EQ(logs[0].source.line, writefLine);
+#endif
+
+    const auto now{ pluto::logger::clock_type::now() };
+    ASSERT_LE(logs[0].time, now);
+    ASSERT_LT(now - logs[0].time, std::chrono::minutes(1));
+}
+
+TEST_F(logger_tests, test_binary_mode_rejects_text_and_truncated_files)
+{
+    {
+        pluto::logger logger{};
+        PLUTO_LOG_WRITE_WITH(logger, LOG_FILE, info, "Log write");
+    }
+
+    std::ifstream textStream{ LOG_FILE, std::ios_base::binary };
+    ASSERT_FALSE(pluto::logger::read_binary_log(textStream, [](const pluto::log_entry&) {}));
+    textStream.close();
+    pluto::filesystem::remove(LOG_FILE);
+
+    {
+        pluto::logger logger{};
+        logger.binary_mode(true);
+        PLUTO_LOG_WRITEF_WITH(logger, LOG_FILE, info, "Log writef %d", 1);
+        PLUTO_LOG_WRITEF_WITH(logger, LOG_FILE, info, "Log writef %d", 2);
+    }
+
+    std::ifstream binaryStream{ LOG_FILE, std::ios_base::binary };
+    std::string contents{ std::istreambuf_iterator<char>{ binaryStream }, std::istreambuf_iterator<char>{} };
+
+    std::size_t numLogs{ 0 };
+    std::istringstream truncatedStream{ contents.substr(0, contents.size() - 1) };
+    ASSERT_FALSE(pluto::logger::read_binary_log(truncatedStream, [&numLogs](const pluto::log_entry&) { ++numLogs; }));
+    ASSERT_EQ(numLogs, 1);
+}
+
+TEST_F(logger_tests, test_default_log_writer_layout)
+{
+    const auto write_log = [](const pluto::log_entry& log)
+        {
+            std::ostringstream stream{};
+            pluto::logger::default_log_writer(stream, log);
+            return stream.str();
+        };
+
+    const auto expected_log = [](const pluto::log_entry& log)
+        {
+            const auto localTime{ pluto::local_time(pluto::logger::clock_type::to_time_t(log.time)) };
+            const auto microseconds{ std::chrono::duration_cast<std::chrono::microseconds>(log.time.time_since_epoch()).count() % 1'000'000 };
+
+            std::ostringstream stream{};
+            stream << std::right << std::setfill('0')
+                << std::put_time(&localTime, "%Y-%m-%d %H:%M:%S.")
+                << std::setw(6) << microseconds << '|'
+                << std::setfill(' ')
+                << std::setw(7) << log.thread_id << '|'
+                << std::left
+                << std::setw(8) << pluto::log_level_to_title(log.level) << '|'
+#if !PLUTO_LOGGER_HIDE_SOURCE_INFO
+                << std::setw(20) << std::string(pluto::file_name(log.source.file), 0, 20) << '|'
+                << std::right
+                << std::setw(5) << log.source.line << '|'
+                << std::left
+                << std::setw(20) << std::string(log.source.function, 0, 20) << '|'
+#endif
+                << log.message;
+
+            return stream.str();
+        };
+
+    const auto now{ std::chrono::time_point_cast<std::chrono::seconds>(pluto::logger::clock_type::now()) };
+
+    const pluto::log_entry logs[]
+    {
+        { now, 1, pluto::log_level::fatal, { "a/b/file.cpp", 1, "main" }, "Message" },
+        { now + std::chrono::microseconds(7), 1234567, pluto::log_level::verbose, { "file_name_longer_than_twenty.cpp", 12345, "function_longer_than_twenty" }, "" },
+        { now + std::chrono::microseconds(999999), 123456789, pluto::log_level::info, { "", 0, "" }, "Same second" },
+        { now + std::chrono::seconds(1), 42, pluto::log_level::warning, { "C:\\dir\\file.cpp", 123456, "f" }, "Next second" },
+        { now + std::chrono::hours(25) + std::chrono::microseconds(10), 0, pluto::log_level::error, { "file.cpp", -1, "f" }, "Next day" },
+        { now, 1, pluto::log_level::fatal, { "file.cpp", 1, "main" }, "Previous second" }
+    };
+
+    for (const auto& log : logs)
+    {
+        ASSERT_EQ(write_log(log), expected_log(log));
+    }
+}
+
+TEST_F(logger_tests, test_default_log_writer_uses_log_site)
+{
+    const auto now{ pluto::logger::clock_type::now() };
+
+    const auto write_log = [&now](const pluto::source_info& source)
+        {
+            const pluto::log_entry log{ now, 1, pluto::log_level::info, source, "Message" };
+
+            std::string output{};
+            pluto::logger::default_log_appender(output, log);
+            return output;
+        };
+
+    const pluto::log_site shortSite{ "a/b/file.cpp", 1, "main" };
+    const pluto::log_site longSite{ "file_name_longer_than_twenty.cpp", 1234567890, "function_longer_than_twenty" };
+
+    ASSERT_EQ(shortSite.source().site, &shortSite);
+    ASSERT_EQ(write_log(shortSite.source()), write_log({ "a/b/file.cpp", 1, "main" }));
+    ASSERT_EQ(write_log(longSite.source()), write_log({ "file_name_longer_than_twenty.cpp", 1234567890, "function_longer_than_twenty" }));
+
+    {
+        pluto::logger logger{};
+        logger
+            .write_header(false)
+            .log_appender([](std::string& output, const pluto::log_entry& log)
+                {
+                    output.append((log.source.site != nullptr) ? "Site|" : "No site|");
+                    output.append(log.message);
+                }
+            );
+
+        for (int i{ 0 }; i < 2; ++i)
+        {
+            PLUTO_LOG_WRITE_WITH(logger, LOG_FILE, info, "Log message");
+        }
+
+        logger.write(LOG_FILE, pluto::log_level::info, { "file.cpp", 1, "f" }, "Direct message");
+    }
+
+    std::ifstream fileStream{ LOG_FILE };
+    std::string contents{ std::istreambuf_iterator<char>{ fileStream }, std::istreambuf_iterator<char>{} };
+
+    ASSERT_EQ(contents, "Site|Log message\nSite|Log message\nNo site|Direct message\n");
+}
+
+TEST_F(logger_tests, test_default_header_writer_layout)
+{
+    std::ostringstream expected{};
+    expected << std::left << std::setfill(' ')
+        << std::setw(26) << "Timestamp" << '|'
+        << std::right
+        << std::setw(7) << "TID" << '|'
+        << std::left
+        << std::setw(8) << pluto::log_level_to_title(pluto::log_level::header) << '|'
+#if !PLUTO_LOGGER_HIDE_SOURCE_INFO
+        << std::setw(20) << "File Name" << '|'
+        << std::right
+        << std::setw(5) << "Line" << '|'
+        << std::left
+        << std::setw(20) << "Function" << '|'
+#endif
+        << "Message" << '\n'
+        << std::setfill('-')
+        << std::setw(26) << "" << '+'
+        << std::setw(7) << "" << '+'
+        << std::setw(8) << "" << '+'
+#if !PLUTO_LOGGER_HIDE_SOURCE_INFO
+        << std::setw(20) << "" << '+'
+        << std::setw(5) << "" << '+'
+        << std::setw(20) << "" << '+'
+#endif
+        << std::setw(7) << "";
+
+    std::ostringstream written{};
+    pluto::logger::default_header_writer(written);
+
+    ASSERT_EQ(written.str(), expected.str());
+}
+
+TEST_F(logger_tests, test_log_appender)
+{
+    {
+        pluto::logger logger{};
+        logger
+            .header_appender([](std::string& output) { output.append("Header"); })
+            .log_appender([](std::string& output, const pluto::log_entry& log)
+                {
+                    output.push_back(pluto::log_level_to_char(log.level));
+                    output.push_back('|');
+                    output.append(log.message);
+                }
+            );
+
+        PLUTO_LOG_WRITEF_WITH(logger, LOG_FILE, info, "Log message: %d, %s", 1, "Test");
+        PLUTO_LOG_WRITE_WITH(logger, LOG_FILE, error, "Last message");
+    }
+
+    std::ifstream fileStream{ LOG_FILE };
+    std::string contents{ std::istreambuf_iterator<char>{ fileStream }, std::istreambuf_iterator<char>{} };
+
+    ASSERT_EQ(contents, "Header\nI|Log message: 1, Test\nE|Last message\n");
+}
+
+TEST_F(logger_tests, test_log_writer_replaces_log_appender)
+{
+    {
+        pluto::logger logger{};
+        logger
+            .write_header(false)
+            .log_writer([](std::ostream& stream, const pluto::log_entry& log) { stream << "Writer|" << log.message; });
+
+        ASSERT_FALSE(logger.log_appender());
+
+        PLUTO_LOG_WRITE_WITH(logger, LOG_FILE, info, "Log message");
+    }
+
+    ASSERT_EQ(last_log(), "Writer|Log message");
+}
+
+TEST_F(logger_tests, test_file_rotation)
+{
+    const std::size_t fileRotationSize{ 2000 };
+
+    {
+        pluto::logger logger{};
+        logger
+            .file_rotation_size(fileRotationSize)
+            .file_rotation_limit(2);
+
+        for (std::size_t i{ 0 }; i < 100; ++i)
+        {
+            PLUTO_LOG_WRITEF_WITH(logger, LOG_FILE, info, "Log writef %zu", i);
+        }
+    }
+
+    ASSERT_TRUE(pluto::filesystem::exists("test_1.log"));
+    ASSERT_TRUE(pluto::filesystem::exists("test_2.log"));
+    ASSERT_FALSE(pluto::filesystem::exists("test_3.log"));
+
+    // Files are rotated once they reach the size, so they only go over by one log
+    for (const auto filePath : { "test_1.log", "test_2.log" })
+    {
+        const auto fileSize{ pluto::filesystem::file_size(filePath) };
+        ASSERT_GE(fileSize, fileRotationSize);
+        ASSERT_LT(fileSize, fileRotationSize + 200);
+
+        pluto::filesystem::remove(filePath);
+    }
+
+    ASSERT_EQ(last_log_message(), "Log writef 99");
+}
+
+TEST_F(logger_tests, test_file_rotation_compressed)
+{
+    const std::size_t fileRotationSize{ 2000 };
+
+    {
+        pluto::logger logger{};
+        logger
+            .file_rotation_size(fileRotationSize)
+            .file_rotation_limit(2)
+            .file_rotation_compress(true);
+
+        for (std::size_t i{ 0 }; i < 100; ++i)
+        {
+            PLUTO_LOG_WRITEF_WITH(logger, LOG_FILE, info, "Log writef %zu", i);
+        }
+    }
+
+    // Rotated files are compressed before the logger is destroyed
+    ASSERT_TRUE(pluto::filesystem::exists("test_1.log.gz"));
+    ASSERT_TRUE(pluto::filesystem::exists("test_2.log.gz"));
+    ASSERT_FALSE(pluto::filesystem::exists("test_3.log.gz"));
+    ASSERT_FALSE(pluto::filesystem::exists("test_1.log"));
+
+    std::map<std::string, std::uint32_t> fileSizes{};
+    for (const auto filePath : { "test_1.log.gz", "test_2.log.gz" })
+    {
+        std::ifstream file{ filePath, std::ios::binary };
+        const std::string data{ std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{} };
+        file.close();
+
+        // Gzip magic, then the uncompressed size in the last 4 bytes
+        ASSERT_GT(data.size(), 18);
+        ASSERT_EQ(data.substr(0, 3), std::string("\x1f\x8b\x08", 3));
+
+        std::uint32_t fileSize{ 0 };
+        for (std::size_t i{ 0 }; i < 4; ++i)
+        {
+            fileSize |= (static_cast<std::uint32_t>(static_cast<unsigned char>(data[data.size() - 4 + i])) << (8 * i));
+        }
+
+        ASSERT_GE(fileSize, fileRotationSize);
+        ASSERT_LT(fileSize, fileRotationSize + 200);
+        ASSERT_LT(data.size(), fileSize);
+        fileSizes[filePath] = fileSize;
+    }
+
+#ifndef _WIN32
+    // Decompressed by gzip, the oldest file first, then followed by the current file, the logs are the newest in order
+    std::string logs{};
+    for (const auto filePath : { "test_2.log.gz", "test_1.log.gz" })
+    {
+        const auto pipe{ ::popen((std::string{ "gzip -dc " } + filePath).c_str(), "r") };
+        ASSERT_NE(pipe, nullptr);
+
+        std::string fileLogs{};
+        char buffer[4096];
+        for (std::size_t size{ 0 }; (size = std::fread(buffer, 1, sizeof(buffer), pipe)) != 0; )
+        {
+            fileLogs.append(buffer, size);
+        }
+
+        ASSERT_EQ(::pclose(pipe), 0);
+        ASSERT_EQ(fileLogs.size(), fileSizes[filePath]);
+        logs.append(fileLogs);
+    }
+
+    std::ifstream file{ LOG_FILE };
+    logs.append(std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{});
+
+    std::vector<std::string> messages{};
+    std::istringstream logStream{ logs };
+    for (std::string log{}; std::getline(logStream, log); )
+    {
+        // Each file starts with a header
+        if (log.find("Log writef ") != std::string::npos)
+        {
+            messages.push_back(log.substr(log.rfind('|') + 1));
+        }
+    }
+
+    ASSERT_GT(messages.size(), 2);
+    const auto firstIndex{ 100 - messages.size() };
+    for (std::size_t i{ 0 }; i < messages.size(); ++i)
+    {
+        ASSERT_EQ(messages[i], "Log writef " + std::to_string(firstIndex + i));
+    }
+#endif
+
+    pluto::filesystem::remove("test_1.log.gz");
+    pluto::filesystem::remove("test_2.log.gz");
+
+    ASSERT_EQ(last_log_message(), "Log writef 99");
+}
+
+TEST_F(logger_tests, test_file_rotation_timestamped)
+{
+    for (const auto compress : { false, true })
+    {
+        {
+            pluto::logger logger{};
+            logger
+                .file_rotation_size(2000)
+                .file_rotation_limit(3)
+                .file_rotation_naming(pluto::log_naming::timestamp)
+                .file_rotation_compress(compress);
+
+            for (std::size_t i{ 0 }; i < 200; ++i)
+            {
+                PLUTO_LOG_WRITEF_WITH(logger, LOG_FILE, info, "Log writef %zu", i);
+            }
+        }
+
+        // Files rotated in the same second are numbered, and only the newest are kept
+        std::size_t numRotated{ 0 };
+        for (const auto& entry : pluto::filesystem::directory_iterator{ "." })
+        {
+            const auto name{ entry.path().filename().string() };
+            if (name.compare(0, 5, "test_") == 0 && name.find(".log") != std::string::npos)
+            {
+                ASSERT_EQ(name.compare(name.size() - 3, 3, ".gz") == 0, compress);
+                pluto::filesystem::remove(entry.path());
+                ++numRotated;
+            }
+        }
+
+        ASSERT_EQ(numRotated, 3);
+        ASSERT_EQ(last_log_message(), "Log writef 199");
+        pluto::filesystem::remove(LOG_FILE);
+    }
+}
+
+TEST_F(logger_tests, test_file_rotation_period)
+{
+    {
+        std::ofstream file{ LOG_FILE };
+        file << "Log from an earlier day" << std::endl;
+    }
+
+    // The file looks like it was last written to two days ago
+    pluto::filesystem::last_write_time(LOG_FILE, (pluto::filesystem::last_write_time(LOG_FILE) - std::chrono::hours(48)));
+
+    {
+        pluto::logger logger{};
+        logger
+            .file_rotation_period(pluto::log_period::daily)
+            .file_rotation_limit(1);
+
+        PLUTO_LOG_WRITE_WITH(logger, LOG_FILE, info, "Log from today");
+    }
+
+    ASSERT_TRUE(pluto::filesystem::exists("test_1.log"));
+
+    {
+        std::ifstream file{ "test_1.log" };
+        std::string rotatedLog{};
+        std::getline(file, rotatedLog);
+        ASSERT_EQ(rotatedLog, "Log from an earlier day");
+    }
+
+    pluto::filesystem::remove("test_1.log");
+    ASSERT_EQ(last_log_message(), "Log from today");
+}
+
+TEST_F(logger_tests, test_file_mapping)
+{
+    const std::size_t numLogs{ 1000 };
+
+    {
+        pluto::logger logger{};
+        logger.file_mapping_size(4096);
+
+        for (std::size_t i{ 0 }; i < numLogs; ++i)
+        {
+            PLUTO_LOG_WRITEF_WITH(logger, LOG_FILE, info, "Log writef %zu", i);
+        }
+    }
+
+    // The mapped region that wasn't written to is cut off when the file is closed
+    std::ifstream file{ LOG_FILE, std::ios::binary };
+    const std::string contents{ std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{} };
+    file.close();
+
+    ASSERT_EQ(contents.find('\0'), std::string::npos);
+    ASSERT_EQ(count_logs(), numLogs + 2); // +2 for header
+    ASSERT_EQ(last_log_message(), "Log writef 999");
+}
+
+#if GTEST_HAS_DEATH_TEST
+std::string file_contents(const char* const fileName)
+{
+    std::ifstream file{ fileName, std::ios::binary };
+    return std::string{ std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{} };
+}
+
+// Dies while the log file is mapped, once the log has been copied into the mapping
+void crash_with_mapped_log(const bool binaryMode)
+{
+    auto& logger{ *new pluto::logger{} };
+    logger
+        .file_mapping_size(65536)
+        .buffer_flush_size(1)
+        .binary_mode(binaryMode);
+
+    PLUTO_LOG_WRITE_WITH(logger, LOG_FILE, info, "Before crash");
+
+    while (file_contents(LOG_FILE).find("Before crash") == std::string::npos)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    std::_Exit(0);
+}
+
+// Death tests run in a new process rather than a fork, which isn't safe with the logging threads running
+void crash_and_reopen_mapped_file(const bool binaryMode)
+{
+    testing::GTEST_FLAG(death_test_style) = "threadsafe";
+
+    EXPECT_EXIT(crash_with_mapped_log(binaryMode), testing::ExitedWithCode(0), "");
+    ASSERT_EQ(file_contents(LOG_FILE).back(), '\0');
+
+    {
+        pluto::logger logger{};
+        logger
+            .file_mapping_size(65536)
+            .binary_mode(binaryMode);
+
+        PLUTO_LOG_WRITE_WITH(logger, LOG_FILE, info, "After restart");
+    }
+}
+
+TEST_F(logger_tests, test_file_mapping_reopened_after_crash)
+{
+    crash_and_reopen_mapped_file(false);
+
+    // The zeros left after the crash are cut off, so the new logs follow on
+    const auto contents{ file_contents(LOG_FILE) };
+    ASSERT_EQ(contents.find('\0'), std::string::npos);
+    ASSERT_LT(contents.find("Before crash"), contents.find("After restart"));
+    ASSERT_EQ(last_log_message(), "After restart");
+}
+
+TEST_F(logger_tests, test_binary_file_mapping_reopened_after_crash)
+{
+    crash_and_reopen_mapped_file(true);
+
+    std::vector<std::string> messages{};
+    std::ifstream fileStream{ LOG_FILE, std::ios_base::binary };
+
+    ASSERT_TRUE(pluto::logger::read_binary_log(fileStream, [&messages](const pluto::log_entry& log) { messages.push_back(log.message); }));
+    ASSERT_EQ(messages, (std::vector<std::string>{ "Before crash", "After restart" }));
+}
+#endif
+
+TEST_F(logger_tests, test_file_mapping_with_rotation)
+{
+    const std::size_t fileRotationSize{ 2000 };
+
+    {
+        pluto::logger logger{};
+        logger
+            .file_mapping_size(1000)
+            .file_rotation_size(fileRotationSize)
+            .file_rotation_limit(2);
+
+        for (std::size_t i{ 0 }; i < 100; ++i)
+        {
+            PLUTO_LOG_WRITEF_WITH(logger, LOG_FILE, info, "Log writef %zu", i);
+        }
+    }
+
+    for (const auto filePath : { "test_1.log", "test_2.log" })
+    {
+        const auto fileSize{ pluto::filesystem::file_size(filePath) };
+        ASSERT_GE(fileSize, fileRotationSize);
+        ASSERT_LT(fileSize, fileRotationSize + 200);
+
+        pluto::filesystem::remove(filePath);
+    }
+
+    ASSERT_EQ(last_log_message(), "Log writef 99");
+}
+
+#if GTEST_HAS_DEATH_TEST
+void write_staged_logs(pluto::logger& logger, const int value)
+{
+    PLUTO_LOG_WRITEF_WITH(logger, LOG_FILE, error, "Value %d %s", value, "text");
+    PLUTO_LOG_WRITE_KV_WITH(logger, LOG_FILE, error, "Fields", pluto::kv("id", value));
+}
+
+// Dies without destroying the logger, so its last logs don't reach the file
+void crash_with_staged_logs(const std::size_t stagingSize)
+{
+    const std::size_t numWritten{ 100 };
+
+    auto& logger{ *new pluto::logger{} };
+    logger
+        .staging_size(stagingSize)
+        .buffer_flush_size(1)
+        .deferred_formatting(true);
+
+    // These go around the ring, so the last logs point to source info and strings that were staged long before
+    for (std::size_t i{ 0 }; i < numWritten / 2; ++i)
+    {
+        write_staged_logs(logger, -1);
+    }
+
+    while (logger.stats().total.records_written < numWritten)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    logger.buffer_flush_size(1000);
+
+    PLUTO_LOG_WRITE_WITH(logger, LOG_FILE, error, "Before crash");
+    write_staged_logs(logger, 42);
+    std::_Exit(0);
+}
+
+TEST_F(logger_tests, test_staged_logs_recovered_after_crash)
+{
+    const std::size_t stagingSize{ 4096 };
+
+    testing::GTEST_FLAG(death_test_style) = "threadsafe";
+
+    EXPECT_EXIT(crash_with_staged_logs(stagingSize), testing::ExitedWithCode(0), "");
+    ASSERT_TRUE(pluto::filesystem::exists(LOG_FILE ".staging"));
+    ASSERT_EQ(count_logs(), 102); // +2 for header
+
+    {
+        pluto::logger logger{};
+        logger.staging_size(stagingSize);
+
+        PLUTO_LOG_WRITE_WITH(logger, LOG_FILE, info, "After restart");
+    }
+
+    std::ifstream logFile{ LOG_FILE };
+    const std::string contents{ std::istreambuf_iterator<char>{ logFile }, std::istreambuf_iterator<char>{} };
+    ASSERT_NE(contents.find("Recovered 3 logs"), std::string::npos);
+    ASSERT_LT(contents.find("Before crash"), contents.find("Value 42 text"));
+    ASSERT_LT(contents.find("Value 42 text"), contents.find("msg=Fields id=42"));
+    ASSERT_LT(contents.find("msg=Fields id=42"), contents.find("After restart"));
+#if !PLUTO_LOGGER_HIDE_SOURCE_INFO
+    const auto lineStart{ contents.rfind('\n', contents.find("msg=Fields id=42")) };
+    ASSERT_NE(contents.find("logger_tests.cpp", lineStart), std::string::npos);
+    ASSERT_LT(contents.find("logger_tests.cpp", lineStart), contents.find("msg=Fields id=42"));
+#endif
+
+    // Nothing is left to recover after a clean exit
+    ASSERT_FALSE(pluto::filesystem::exists(LOG_FILE ".staging"));
+}
+#endif
+
+TEST_F(logger_tests, test_stats)
+{
+    const std::size_t numLogs{ 100 };
+
+    {
+        pluto::logger logger{};
+        logger
+            .file_rotation_size(2000)
+            .file_rotation_limit(1);
+
+        for (std::size_t i{ 0 }; i < numLogs; ++i)
+        {
+            PLUTO_LOG_WRITEF_WITH(logger, LOG_FILE, info, "Log writef %zu", i);
+        }
+
+        // Logs are written by the logging thread, so wait for it to catch up
+        auto stats{ logger.stats() };
+        for (std::size_t i{ 0 }; i < 500 && stats.total.records_written < numLogs; ++i)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            stats = logger.stats();
+        }
+
+        ASSERT_EQ(stats.files.size(), 1);
+
+        const auto& fileStats{ stats.files.at(LOG_FILE) };
+        ASSERT_EQ(fileStats.records_enqueued, numLogs);
+        ASSERT_EQ(fileStats.records_written, numLogs);
+        ASSERT_GT(fileStats.bytes_written, numLogs * 10);
+        ASSERT_GE(fileStats.max_buffer_depth, 1);
+        ASSERT_GE(fileStats.rotations, 1);
+        ASSERT_GE(fileStats.flushes, 1);
+
+        std::size_t numFlushes{ 0 };
+        for (const auto flushLatency : fileStats.flush_latencies)
+        {
+            numFlushes += flushLatency;
+        }
+
+        ASSERT_EQ(numFlushes, fileStats.flushes);
+        ASSERT_EQ(stats.total.records_written, numLogs);
+        ASSERT_EQ(stats.discarded, 0);
+
+        logger.reset_stats();
+        stats = logger.stats();
+
+        ASSERT_EQ(stats.total.records_enqueued, 0);
+        ASSERT_EQ(stats.total.records_written, 0);
+        ASSERT_EQ(stats.total.flushes, 0);
+        ASSERT_EQ(stats.total.rotations, 0);
+    }
+
+    pluto::filesystem::remove("test_1.log");
+}
+
+TEST_F(logger_tests, test_lock_wait_stats)
+{
+    const std::size_t numThreads{ 8 };
+    const std::size_t numLogs   { 1000 };
+
+    pluto::logger logger{};
+
+    std::vector<std::thread> threads{};
+    for (std::size_t i{ 0 }; i < numThreads; ++i)
+    {
+        threads.emplace_back([&logger]()
+            {
+                for (std::size_t j{ 0 }; j < numLogs; ++j)
+                {
+                    PLUTO_LOG_WRITEF_WITH(logger, LOG_FILE, info, "Log writef %zu", j);
+                }
+            });
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    // Each thread counted its own waits, and they're kept after it exits
+    const auto stats{ logger.stats() };
+    const auto statsAgain{ logger.stats() };
+    ASSERT_EQ(stats.lock_waits, statsAgain.lock_waits);
+    ASSERT_EQ(stats.lock_wait_time, statsAgain.lock_wait_time);
+    ASSERT_LE(stats.lock_waits, numThreads * numLogs * 2);
+    ASSERT_EQ(stats.lock_waits == 0, stats.lock_wait_time.count() == 0);
+
+    logger.reset_stats();
+    ASSERT_EQ(logger.stats().lock_waits, 0);
+    ASSERT_EQ(logger.stats().lock_wait_time.count(), 0);
+}
+
+#ifdef __linux__
+TEST_F(logger_tests, test_failed_writes_are_discarded)
+{
+    const std::size_t numLogs{ 10 };
+
+    pluto::logger logger{};
+
+    // Every write to this fails, as if the disk was full
+    for (std::size_t i{ 0 }; i < numLogs; ++i)
+    {
+        PLUTO_LOG_WRITEF_WITH(logger, "/dev/full", info, "Log writef %zu", i);
+    }
+
+    for (std::size_t i{ 0 }; i < 500 && logger.num_discarded_logs() < numLogs; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    const auto stats{ logger.stats() };
+    ASSERT_EQ(stats.discarded, numLogs);
+    ASSERT_EQ(stats.total.records_written, 0);
+    ASSERT_EQ(stats.total.bytes_written, 0);
+}
+#endif
+
+TEST_F(logger_tests, test_file_reopened_after_removal)
+{
+    pluto::logger logger{};
+    logger.file_check_interval(std::chrono::milliseconds(0));
+
+    PLUTO_LOG_WRITE_WITH(logger, LOG_FILE, info, "First message");
+    ASSERT_EQ(count_logs(), 3); // +2 for header
+
+    pluto::filesystem::remove(LOG_FILE);
+
+    PLUTO_LOG_WRITE_WITH(logger, LOG_FILE, info, "Second message");
+    ASSERT_EQ(count_logs(), 3); // +2 for header
+    ASSERT_EQ(last_log_message(), "Second message");
+}
+
+TEST_F(logger_tests, test_file_checked_once_per_interval)
+{
+    pluto::logger logger{};
+    logger.file_check_interval(std::chrono::milliseconds(500));
+
+    PLUTO_LOG_WRITE_WITH(logger, LOG_FILE, info, "First message");
+    ASSERT_EQ(count_logs(), 3); // +2 for header
+
+    // Not checked yet, so this goes to the removed file
+    pluto::filesystem::remove(LOG_FILE);
+    PLUTO_LOG_WRITE_WITH(logger, LOG_FILE, info, "Second message");
+    ASSERT_EQ(count_logs(), 0);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+    PLUTO_LOG_WRITE_WITH(logger, LOG_FILE, info, "Third message");
+    ASSERT_EQ(count_logs(), 3); // +2 for header
+    ASSERT_EQ(last_log_message(), "Third message");
+}
+
+TEST_F(logger_tests, test_sync_policies_write_all_logs)
+{
+    std::size_t numLogs{ 100 };
+
+    for (const auto syncPolicy : { pluto::log_sync::per_batch, pluto::log_sync::interval })
+    {
+        {
+            pluto::logger logger{};
+            logger
+                .sync_policy(syncPolicy)
+                .sync_interval(std::chrono::milliseconds(10));
+
+            for (std::size_t i{ 0 }; i < numLogs; ++i)
+            {
+                PLUTO_LOG_WRITEF_WITH(logger, LOG_FILE, info, "Log writef %zu of %zu", i, numLogs);
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        }
+
+        ASSERT_EQ(count_logs(), numLogs + 2); // +2 for header
+        pluto::filesystem::remove(LOG_FILE);
+    }
+}
+
+TEST_F(logger_tests, test_flush_interval_writes_logs_below_flush_size)
+{
+    for (const std::size_t threadBufferSize : { 0, 64 })
+    {
+        pluto::logger logger{};
+        logger
+            .buffer_flush_size(1000)
+            .thread_buffer_size(threadBufferSize)
+            .flush_interval(std::chrono::milliseconds(20));
+
+        for (std::size_t i{ 0 }; i < 5; ++i)
+        {
+            PLUTO_LOG_WRITEF_WITH(logger, LOG_FILE, info, "Log writef %zu", i);
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        ASSERT_EQ(count_logs(), 7); // +2 for header
+
+        // The timer starts again for the next logs
+        PLUTO_LOG_WRITE_WITH(logger, LOG_FILE, info, "Last message");
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        ASSERT_EQ(count_logs(), 8); // +2 for header
+        ASSERT_EQ(last_log_message(), "Last message");
+
+        pluto::filesystem::remove(LOG_FILE);
+    }
+}
+
+// Holds up the logging thread in its log appender after it takes one log, so a test can fill the buffer while
+// nothing is taken from it. Releases the logging thread when destroyed, so declare it after the logger.
+class logging_thread_hold
+{
+    struct hold_state
+    {
+        std::atomic_bool isHeld     { false };
+        std::atomic_bool isReleased { false };
+    };
+
+    std::shared_ptr<hold_state> m_state{ std::make_shared<hold_state>() };
+
+public:
+    explicit logging_thread_hold(pluto::logger& logger)
+    {
+        const auto state{ m_state };
+
+        logger
+            .buffer_flush_size(1)
+            .log_appender([state](std::string& output, const pluto::log_entry& log)
+                {
+                    // Only the first log holds, since spilled logs are appended by the thread that adds them
+                    if (!state->isHeld.exchange(true))
+                    {
+                        while (!state->isReleased)
+                        {
+                            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                        }
+                    }
+
+                    pluto::logger::default_log_appender(output, log);
+                }
+            );
+
+        PLUTO_LOG_WRITE_WITH(logger, LOG_FILE, info, "Hold message");
+        while (!m_state->isHeld)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        logger.buffer_flush_size(1000);
+    }
+
+    logging_thread_hold(const logging_thread_hold&) = delete;
+
+    logging_thread_hold& operator=(const logging_thread_hold&) = delete;
+
+    ~logging_thread_hold()
+    {
+        release();
+    }
+
+    void release()
+    {
+        m_state->isReleased = true;
+    }
+};
+
+// Returns the message of every log in a file, skipping the header
+std::vector<std::string> log_messages(const std::string& fileName, const std::size_t headerSize)
+{
+    std::string log{};
+    std::vector<std::string> messages{};
+    std::ifstream logFile{ fileName };
+
+    while (logFile >> std::ws && std::getline(logFile, log))
+    {
+        messages.push_back(log.substr(log.rfind('|') + 1));
+    }
+
+    messages.erase(messages.begin(), (messages.begin() + (std::min)(headerSize, messages.size())));
+    return messages;
+}
+
+TEST_F(logger_tests, test_overflow_discard_oldest_keeps_newest_logs)
+{
+    {
+        pluto::logger logger{};
+        logger
+            .buffer_max_size(10)
+            .overflow_policy(pluto::log_overflow::discard_oldest);
+
+        logging_thread_hold hold{ logger };
+
+        for (std::size_t i{ 0 }; i < 100; ++i)
+        {
+            PLUTO_LOG_WRITEF_WITH(logger, LOG_FILE, info, "Log writef %zu", i);
+        }
+
+        ASSERT_EQ(logger.num_discarded_logs(), 90);
+    }
+
+    const auto messages{ log_messages(LOG_FILE, 2) };
+    ASSERT_EQ(messages.size(), 11);
+    ASSERT_EQ(messages[0], "Hold message");
+
+    // The newest logs are kept, in order
+    for (std::size_t i{ 0 }; i < 10; ++i)
+    {
+        ASSERT_EQ(messages[i + 1], "Log writef " + std::to_string(90 + i));
+    }
+}
+
+TEST_F(logger_tests, test_overflow_discard_by_level_keeps_important_logs)
+{
+    {
+        pluto::logger logger{};
+        logger
+            .buffer_max_size(10)
+            .overflow_policy(pluto::log_overflow::discard_by_level)
+            .overflow_level(pluto::log_level::error);
+
+        logging_thread_hold hold{ logger };
+
+        for (std::size_t i{ 0 }; i < 20; ++i)
+        {
+            PLUTO_LOG_WRITEF_WITH(logger, LOG_FILE, info, "Info message %zu", i);
+        }
+
+        for (std::size_t i{ 0 }; i < 5; ++i)
+        {
+            PLUTO_LOG_WRITEF_WITH(logger, LOG_FILE, error, "Error message %zu", i);
+        }
+
+        ASSERT_EQ(logger.num_discarded_logs(), 10);
+    }
+
+    const auto messages{ log_messages(LOG_FILE, 2) };
+    ASSERT_EQ(messages.size(), 16);
+    ASSERT_EQ(messages[0], "Hold message");
+
+    // Info logs that fit in the buffer are kept, then every error log is kept even though the buffer is full
+    for (std::size_t i{ 0 }; i < 10; ++i)
+    {
+        ASSERT_EQ(messages[i + 1], "Info message " + std::to_string(i));
+    }
+
+    for (std::size_t i{ 0 }; i < 5; ++i)
+    {
+        ASSERT_EQ(messages[i + 11], "Error message " + std::to_string(i));
+    }
+}
+
+TEST_F(logger_tests, test_overflow_spill_writes_to_overflow_file)
+{
+    const std::string overflowFile{ "test.overflow" };
+
+    {
+        pluto::logger logger{};
+        logger
+            .buffer_max_size(10)
+            .overflow_policy(pluto::log_overflow::spill)
+            .overflow_file(overflowFile);
+
+        logging_thread_hold hold{ logger };
+
+        for (std::size_t i{ 0 }; i < 25; ++i)
+        {
+            PLUTO_LOG_WRITEF_WITH(logger, LOG_FILE, info, "Log writef %zu", i);
+        }
+
+        ASSERT_EQ(logger.num_discarded_logs(), 0);
+    }
+
+    const auto messages{ log_messages(LOG_FILE, 2) };
+    ASSERT_EQ(messages.size(), 11);
+    ASSERT_EQ(messages[0], "Hold message");
+
+    for (std::size_t i{ 0 }; i < 10; ++i)
+    {
+        ASSERT_EQ(messages[i + 1], "Log writef " + std::to_string(i));
+    }
+
+    // Spilled logs have no header
+    const auto spilledMessages{ log_messages(overflowFile, 0) };
+    pluto::filesystem::remove(overflowFile);
+
+    ASSERT_EQ(spilledMessages.size(), 15);
+    for (std::size_t i{ 0 }; i < 15; ++i)
+    {
+        ASSERT_EQ(spilledMessages[i], "Log writef " + std::to_string(10 + i));
+    }
+}
+
+TEST_F(logger_tests, test_overflow_block_writes_all_logs)
+{
+    std::size_t numThreads{ 4 };
+    std::size_t numLogs{ 100 };
+
+    for (const std::size_t threadBufferSize : { 0, 8 })
+    {
+        {
+            pluto::logger logger{};
+            logger
+                .buffer_flush_size(1000)
+                .buffer_max_size(10)
+                .thread_buffer_size(threadBufferSize)
+                .overflow_policy(pluto::log_overflow::block)
+                .overflow_timeout(std::chrono::milliseconds(10000));
+
+            std::vector<std::thread> threads{};
+            for (std::size_t i{ 0 }; i < numThreads; ++i)
+            {
+                threads.emplace_back([&logger, numLogs]()
+                    {
+                        for (std::size_t j{ 0 }; j < numLogs; ++j)
+                        {
+                            PLUTO_LOG_WRITE_WITH(logger, LOG_FILE, info, "Log message");
+                        }
+                    }
+                );
+            }
+
+            for (auto& thread : threads)
+            {
+                thread.join();
+            }
+
+            ASSERT_EQ(logger.num_discarded_logs(), 0);
+        }
+
+        ASSERT_EQ(count_logs(), (numThreads * numLogs) + 2); // +2 for header
+        pluto::filesystem::remove(LOG_FILE);
+    }
+}
+
+TEST_F(logger_tests, test_file_handle)
+{
+    pluto::logger logger{};
+
+    pluto::logger::file_handle unopened{};
+    ASSERT_FALSE(unopened.is_open());
+    PLUTO_LOG_WRITE_WITH(logger, unopened, info, "Not written");
+
+    const auto logFile{ logger.open(LOG_FILE) };
+    ASSERT_TRUE(logFile.is_open());
+
+    PLUTO_LOG_WRITE_WITH(logger, logFile, info, "Handle write");
+    ASSERT_EQ(last_log_message(), "Handle write");
+
+    PLUTO_LOG_WRITEF_WITH(logger, logFile, info, "Handle writef %d", 1);
+    ASSERT_EQ(last_log_message(), "Handle writef 1");
+
+#if PLUTO_UTILS_HAS_FORMAT
+    PLUTO_LOG_FORMAT_WITH(logger, logFile, info, "Handle format {}", 2);
+    ASSERT_EQ(last_log_message(), "Handle format 2");
+#endif
+
+    PLUTO_LOG_STREAM_WITH(logger, logFile, info, "Handle stream " << 3);
+    ASSERT_EQ(last_log_message(), "Handle stream 3");
+
+    // Handles and names refer to the same file
+    PLUTO_LOG_WRITE_WITH(logger, LOG_FILE, info, "Name write");
+    ASSERT_EQ(last_log_message(), "Name write");
+}
+
+TEST_F(logger_tests, test_file_handles_write_all_logs)
+{
+    std::size_t numLogs{ 1000 };
+    const std::vector<std::string> fileNames{ "test_a.log", "test_b.log", "test_c.log", "test_d.log" };
+
+    for (const std::size_t threadBufferSize : { std::size_t{ 0 }, numLogs })
+    {
+        {
+            pluto::logger logger{};
+            logger.thread_buffer_size(threadBufferSize);
+
+            std::vector<std::thread> threads{};
+            for (const auto& fileName : fileNames)
+            {
+                threads.emplace_back([&logger, numLogs, logFile = logger.open(fileName)]()
+                    {
+                        for (std::size_t i{ 0 }; i < numLogs; ++i)
+                        {
+                            PLUTO_LOG_WRITEF_WITH(logger, logFile, info, "Log writef %zu", i);
+                        }
+                    }
+                );
+            }
+
+            for (auto& thread : threads)
+            {
+                thread.join();
+            }
+
+            ASSERT_EQ(logger.num_discarded_logs(), 0);
+        }
+
+        for (const auto& fileName : fileNames)
+        {
+            std::string line{};
+            std::size_t logCount{ 0 };
+            std::ifstream file{ fileName };
+
+            while (file >> std::ws && std::getline(file, line))
+            {
+                ++logCount;
+            }
+
+            file.close();
+            pluto::filesystem::remove(fileName);
+
+            ASSERT_EQ(logCount, numLogs + 2); // +2 for header
+        }
+    }
+}
+
+void write_logs_in_parallel(pluto::logger& logger, const std::vector<std::string>& fileNames, const std::size_t numLogs)
+{
+    std::vector<std::thread> threads{};
+    for (const auto& fileName : fileNames)
+    {
+        threads.emplace_back([&logger, numLogs, logFile = logger.open(fileName)]()
+            {
+                for (std::size_t i{ 0 }; i < numLogs; ++i)
+                {
+                    PLUTO_LOG_WRITEF_WITH(logger, logFile, info, "%zu", i);
+                }
+            }
+        );
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+void check_logs_in_order(const std::vector<std::string>& fileNames, const std::size_t numLogs)
+{
+    for (const auto& fileName : fileNames)
+    {
+        std::string line{};
+        std::size_t logCount{ 0 };
+        std::ifstream file{ fileName };
+
+        // Skip header
+        std::getline(file, line);
+        std::getline(file, line);
+
+        while (std::getline(file, line))
+        {
+            ASSERT_EQ(line.substr(line.rfind('|') + 1), std::to_string(logCount));
+            ++logCount;
+        }
+
+        file.close();
+        pluto::filesystem::remove(fileName);
+
+        ASSERT_EQ(logCount, numLogs);
+    }
+}
+
+TEST_F(logger_tests, test_writer_threads_keep_file_order)
+{
+    std::size_t numLogs{ 1000 };
+    const std::vector<std::string> fileNames{
+        "test_a.log", "test_b.log", "test_c.log", "test_d.log", "test_e.log", "test_f.log", "test_g.log", "test_h.log" };
+
+    {
+        pluto::logger logger{};
+        logger.writer_threads(4);
+
+        ASSERT_EQ(logger.writer_threads(), 4);
+        ASSERT_NE(logger.writer_pool(), nullptr);
+
+        write_logs_in_parallel(logger, fileNames, numLogs);
+        ASSERT_EQ(logger.num_discarded_logs(), 0);
+    }
+
+    check_logs_in_order(fileNames, numLogs);
+}
+
+TEST_F(logger_tests, test_writer_pool_keeps_file_order)
+{
+    std::size_t numLogs{ 1000 };
+    const std::vector<std::string> fileNames{ "test_a.log", "test_b.log", "test_c.log", "test_d.log" };
+
+    pluto::thread_pool writerPool{ 2 };
+
+    {
+        pluto::logger logger{};
+        logger
+            .writer_threads(2)
+            .writer_pool(&writerPool);
+
+        ASSERT_EQ(logger.writer_threads(), 0);
+        ASSERT_EQ(logger.writer_pool(), &writerPool);
+
+        write_logs_in_parallel(logger, fileNames, numLogs);
+        ASSERT_EQ(logger.num_discarded_logs(), 0);
+    }
+
+    check_logs_in_order(fileNames, numLogs);
+}
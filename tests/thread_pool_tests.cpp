@@ -5,7 +5,13 @@
 * Official repository: https://github.com/Stephen-ODriscoll/PlutoUtils
 */
 
+#include <set>
+#include <array>
+#include <mutex>
 #include <atomic>
+#include <memory>
+#include <vector>
+#include <stdexcept>
 
 #include <gtest/gtest.h>
 
@@ -46,6 +52,135 @@ TEST_F(thread_pool_tests, test_sanity)
     ASSERT_TRUE(done);
 }
 
+TEST_F(thread_pool_tests, test_task_function)
+{
+    pluto::task_function empty{};
+    ASSERT_FALSE(empty);
+
+    // Small tasks are stored inline, and big ones on the heap. Both are destroyed with the task.
+    const auto counter{ std::make_shared<int>(0) };
+    std::array<char, 2 * PLUTO_THREAD_POOL_TASK_INLINE_SIZE> big{};
+
+    {
+        pluto::task_function small{ [counter]() { ++*counter; } };
+        pluto::task_function large{ [counter, big]() { *counter += 10 + big[0]; } };
+        ASSERT_TRUE(small);
+        ASSERT_TRUE(large);
+        ASSERT_EQ(counter.use_count(), 3);
+
+        small();
+        large();
+        ASSERT_EQ(*counter, 11);
+
+        pluto::task_function moved{ std::move(small) };
+        ASSERT_FALSE(small);
+        moved();
+        ASSERT_EQ(*counter, 12);
+
+        moved = std::move(large);
+        ASSERT_FALSE(large);
+        ASSERT_EQ(counter.use_count(), 2);
+        moved();
+        ASSERT_EQ(*counter, 22);
+    }
+
+    ASSERT_EQ(counter.use_count(), 1);
+}
+
+TEST_F(thread_pool_tests, test_run_async_move_only_task)
+{
+    pluto::thread_pool threadPool{ 1 };
+
+    std::unique_ptr<int> value{ new int{ 42 } };
+    std::atomic_int result{ 0 };
+
+    // Copying the task isn't needed, so it can own things that can't be copied
+    threadPool.run_async([value = std::move(value), &result]() { result = *value; });
+    threadPool.wait_until_all_tasks_complete();
+    ASSERT_EQ(result, 42);
+}
+
+TEST_F(thread_pool_tests, test_submit)
+{
+    pluto::thread_pool threadPool{ 2 };
+
+    auto sum{ threadPool.submit([](const int first, const int second) { return first + second; }, 40, 2) };
+    ASSERT_TRUE(sum.valid());
+    ASSERT_EQ(sum.get(), 42);
+    ASSERT_FALSE(sum.valid());
+
+    int value{ 0 };
+    auto assign{ threadPool.submit(pluto::thread_pool::priority::high, [](int& value) { value = 42; }, std::ref(value)) };
+    assign.wait();
+    ASSERT_TRUE(assign.is_ready());
+    assign.get();
+    ASSERT_EQ(value, 42);
+
+    auto reference{ threadPool.submit([&value]() -> int& { return value; }) };
+    ASSERT_EQ(&reference.get(), &value);
+
+    std::vector<pluto::task_future<std::size_t>> futures{};
+    for (std::size_t i{ 0 }; i < 128; ++i)
+    {
+        futures.push_back(threadPool.submit([](const std::size_t i) { return (i * 2); }, i));
+    }
+
+    for (std::size_t i{ 0 }; i < futures.size(); ++i)
+    {
+        ASSERT_EQ(futures[i].get(), (i * 2));
+    }
+}
+
+TEST_F(thread_pool_tests, test_submit_move_only)
+{
+    pluto::thread_pool threadPool{ 1 };
+
+    std::unique_ptr<int> value{ new int{ 40 } };
+    std::unique_ptr<int> argument{ new int{ 2 } };
+
+    auto future{ threadPool.submit(
+        [value = std::move(value)](std::unique_ptr<int> argument) { return std::unique_ptr<int>{ new int{ *value + *argument } }; },
+        std::move(argument)) };
+
+    const auto result{ future.get() };
+    ASSERT_EQ(*result, 42);
+}
+
+TEST_F(thread_pool_tests, test_submit_exception)
+{
+    pluto::thread_pool threadPool{ 1 };
+
+    auto future{ threadPool.submit([]() -> int { throw std::runtime_error{ "failed" }; }) };
+    ASSERT_THROW(future.get(), std::runtime_error);
+}
+
+TEST_F(thread_pool_tests, test_submit_wait_for)
+{
+    pluto::thread_pool threadPool{ 0 };
+
+    auto future{ threadPool.submit([]() { return 42; }) };
+    ASSERT_EQ(future.wait_for(std::chrono::milliseconds(10)), std::future_status::timeout);
+    ASSERT_FALSE(future.is_ready());
+
+    threadPool.target_workers_size(1);
+    ASSERT_EQ(future.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+    ASSERT_EQ(future.get(), 42);
+}
+
+TEST_F(thread_pool_tests, test_submit_broken_future)
+{
+    pluto::task_future<int> future{};
+    ASSERT_FALSE(future.valid());
+
+    {
+        pluto::thread_pool threadPool{ 0 };
+        future = threadPool.submit([]() { return 42; });
+    }
+
+    // The task was destroyed without running
+    ASSERT_THROW(future.get(), std::future_error);
+}
+
 TEST_F(thread_pool_tests, test_on_stop_join_all)
 {
     std::size_t numTasks{ 128 };
@@ -332,3 +467,115 @@ TEST_F(thread_pool_tests, test_wait_until_all_tasks_complete)
     ASSERT_EQ(threadPool.waiting_tasks_size(), 0);
     ASSERT_EQ(counter, numTasks);
 }
+
+TEST_F(thread_pool_tests, test_work_stealing_runs_queued_tasks)
+{
+    std::size_t numTasks{ 512 };    // More than a work queue holds, so some are shared
+
+    pluto::thread_pool threadPool{ 4 };
+    threadPool.work_stealing(true);
+    ASSERT_TRUE(threadPool.work_stealing());
+
+    std::mutex mutex{};
+    std::set<std::thread::id> threadIDs{};
+    std::atomic_size_t counter{ 0 };
+
+    threadPool.run_async(
+        [&]()
+        {
+            for (std::size_t i{ 0 }; i < numTasks; ++i)
+            {
+                threadPool.run_async(
+                    [&]()
+                    {
+                        std::this_thread::sleep_for(std::chrono::microseconds(100));
+
+                        {
+                            const std::lock_guard<std::mutex> lock{ mutex };
+                            threadIDs.insert(std::this_thread::get_id());
+                        }
+
+                        ++counter;
+                    }
+                );
+            }
+        }
+    );
+
+    threadPool.wait_until_all_tasks_complete();
+    ASSERT_EQ(threadPool.active_workers_size(), 0);
+    ASSERT_EQ(threadPool.waiting_tasks_size(), 0);
+    ASSERT_EQ(counter, numTasks);
+
+    // Tasks queued by one worker were stolen by the others
+    ASSERT_TRUE(1 < threadIDs.size());
+}
+
+TEST_F(thread_pool_tests, test_work_stealing_has_priority)
+{
+    pluto::thread_pool threadPool{ 1 };
+    threadPool.work_stealing(true);
+
+    std::mutex mutex{};
+    std::vector<int> order{};
+
+    const auto add_task = [&](const pluto::thread_pool::priority priority, const int id)
+        {
+            threadPool.run_async(
+                [&mutex, &order, id]()
+                {
+                    const std::lock_guard<std::mutex> lock{ mutex };
+                    order.push_back(id);
+                },
+                priority
+            );
+        };
+
+    threadPool.run_async(
+        [&]()
+        {
+            add_task(pluto::thread_pool::priority::low, 3);
+            add_task(pluto::thread_pool::priority::normal, 2);
+            add_task(pluto::thread_pool::priority::highest, 0);
+            add_task(pluto::thread_pool::priority::high, 1);
+        }
+    );
+
+    threadPool.wait_until_all_tasks_complete();
+    ASSERT_EQ(order, (std::vector<int>{ 0, 1, 2, 3 }));
+}
+
+TEST_F(thread_pool_tests, test_work_stealing_gives_back_tasks_when_workers_exit)
+{
+    std::size_t numTasks{ 64 };
+
+    std::atomic_size_t counter{ 0 };
+
+    {
+        pluto::thread_pool threadPool{ 2 };
+        threadPool.work_stealing(true).on_stop(pluto::thread_pool::action::complete_tasks);
+
+        threadPool.run_async(
+            [&]()
+            {
+                for (std::size_t i{ 0 }; i < numTasks; ++i)
+                {
+                    threadPool.run_async(
+                        [&counter]()
+                        {
+                            std::this_thread::sleep_for(std::chrono::microseconds(100));
+                            ++counter;
+                        }
+                    );
+                }
+
+                threadPool.target_workers_size(1);
+            }
+        );
+
+        threadPool.wait_until_no_tasks_waiting();
+        ASSERT_EQ(threadPool.waiting_tasks_size(), 0);
+    }
+
+    ASSERT_EQ(counter, numTasks);
+}